@@ -0,0 +1,369 @@
+// IPC benchmark: connects an IPCServer and an IPCClient in the same process
+// and measures, for each transport and message size, the round trip latency
+// percentiles (ping-pong of a message of that size) and the streaming
+// throughput (client to server, until the server received everything).
+//
+// Usage: nv_ipc_bench [--transports=pipe,shm,channel]
+//                     [--sizes=64,1K,16K,256K,4M,64M]
+//                     [--iterations=1000] [--volume=256M]
+//
+// Transports:
+//   pipe:    default channel over the named pipe / Unix socket.
+//   shm:     default channel over the shared memory rings (Linux only).
+//   channel: prioritized channel 1 over the pipe / socket, with a second
+//            channel streaming in the background during the latency test.
+//
+// The number of iterations and streamed messages is reduced for large
+// messages so that about --volume bytes are transferred per measure.
+
+#include <nvk_common.h>
+
+#include <nvk/network/IPCHandler.h>
+
+using namespace nv;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    String transport;
+    Vector<U64> sizes;
+    U32 iterations{1000};
+    U64 volume{256ULL * 1024 * 1024};
+};
+
+struct BenchResult {
+    // Round trip latency percentiles (in us):
+    F64 p50{0.0};
+    F64 p90{0.0};
+    F64 p99{0.0};
+    F64 max{0.0};
+    F64 mbPerSec{0.0};
+    F64 msgsPerSec{0.0};
+};
+
+// Parse a size with an optional K, M or G suffix:
+auto parse_size(const String& str) -> U64 {
+    size_t pos = 0;
+    U64 value = std::stoull(str, &pos);
+    if (pos < str.size()) {
+        switch (std::toupper(str[pos])) {
+        case 'K':
+            return value << 10;
+        case 'M':
+            return value << 20;
+        case 'G':
+            return value << 30;
+        default:
+            THROW_MSG("Invalid size: {}", str);
+        }
+    }
+    return value;
+}
+
+auto split_sizes(const String& str) -> Vector<U64> {
+    Vector<U64> res;
+    std::stringstream ss(str);
+    String item;
+    while (std::getline(ss, item, ',')) {
+        res.push_back(parse_size(item));
+    }
+    return res;
+}
+
+auto split_names(const String& str) -> Vector<String> {
+    Vector<String> res;
+    std::stringstream ss(str);
+    String item;
+    while (std::getline(ss, item, ',')) {
+        res.push_back(item);
+    }
+    return res;
+}
+
+auto format_size(U64 size) -> String {
+    if (size >= (1ULL << 20) && size % (1ULL << 20) == 0) {
+        return fmt::format("{}M", size >> 20);
+    }
+    if (size >= (1ULL << 10) && size % (1ULL << 10) == 0) {
+        return fmt::format("{}K", size >> 10);
+    }
+    return fmt::format("{}", size);
+}
+
+auto percentile(const Vector<F64>& sorted, F64 ratio) -> F64 {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto idx = (size_t)(ratio * (F64)(sorted.size() - 1));
+    return sorted[idx];
+}
+
+// Client and server connected with one transport. The server echoes the
+// messages in ping mode, and only counts them in stream mode (replying
+// once the expected number of messages is received).
+class LoopbackPair {
+  public:
+    static constexpr U16 kBenchChannel = 1;
+    static constexpr U16 kLoadChannel = 2;
+
+    LoopbackPair(const String& transport, U64 maxSize) {
+        String name = "nv_ipc_bench_" + transport;
+        _server = nv::create_ref_object<IPCServer>(name);
+        _client = nv::create_ref_object<IPCClient>(name);
+        _channel = transport == "channel";
+
+        Vector<IPCBase*> peers{_server.get(), _client.get()};
+        for (auto* peer : peers) {
+            peer->set_timeout(60000);
+            if (transport == "shm") {
+                // The largest record must fit in the ring:
+                peer->set_shared_memory(2 * maxSize);
+            } else if (_channel) {
+                peer->add_channel(kBenchChannel, 10);
+                peer->add_channel(kLoadChannel, 0);
+            }
+        }
+
+        get_buffer_signal(*_server).connect(
+            [this](std::span<const U8> buf) { on_server_message(buf); });
+        get_buffer_signal(*_client).connect(
+            [this](std::span<const U8> /*buf*/) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    ++_replies;
+                }
+                _condition.notify_all();
+            });
+
+        _server->start();
+        _client->start();
+
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while (!_server->is_connected() || !_client->is_connected()) {
+            NVCHK(Clock::now() < deadline, "IPC bench: cannot connect ({}).",
+                  transport);
+            sleep_ms(1);
+        }
+    }
+
+    ~LoopbackPair() {
+        _client->stop();
+        _server->stop();
+    }
+
+    NV_DECLARE_NO_COPY(LoopbackPair)
+    NV_DECLARE_NO_MOVE(LoopbackPair)
+
+    auto ping(const U8Vector& data) -> F64 {
+        _streaming = false;
+        U64 expected = get_replies() + 1;
+        auto t0 = Clock::now();
+        send(*_client, data);
+        wait_replies(expected);
+        return std::chrono::duration<F64, std::micro>(Clock::now() - t0)
+            .count();
+    }
+
+    // Returns the time (in seconds) until the server received count
+    // messages:
+    auto stream(const U8Vector& data, U64 count) -> F64 {
+        _received = 0;
+        _expected = count;
+        _streaming = true;
+        U64 expected = get_replies() + 1;
+        auto t0 = Clock::now();
+        for (U64 i = 0; i < count; ++i) {
+            send(*_client, data);
+        }
+        wait_replies(expected);
+        return std::chrono::duration<F64>(Clock::now() - t0).count();
+    }
+
+    // Keep the low priority channel busy during the latency measures:
+    void start_load(U64 size) {
+        if (!_channel) {
+            return;
+        }
+        _loading = true;
+        _loadThread = std::thread([this, size] {
+            auto* channel = _client->get_channel(kLoadChannel);
+            U8Vector data(size, 0xAB);
+            while (_loading) {
+                channel->send_in_place((U32)data.size(),
+                                       [&data](std::span<U8> buf) {
+                                           memcpy(buf.data(), data.data(),
+                                                  buf.size());
+                                       });
+            }
+        });
+    }
+
+    void stop_load() {
+        if (_loadThread.joinable()) {
+            _loading = false;
+            _loadThread.join();
+            // Don't let the queued load slow down the next measures:
+            _client->flush();
+        }
+    }
+
+  private:
+    auto get_buffer_signal(IPCBase& peer) -> Signal<std::span<const U8>>& {
+        return _channel ? peer.get_channel(kBenchChannel)->bufferReceived
+                        : peer.bufferReceived;
+    }
+
+    void send(IPCBase& peer, std::span<const U8> data) {
+        auto writer = [data](std::span<U8> buf) {
+            memcpy(buf.data(), data.data(), buf.size());
+        };
+        bool sent =
+            _channel ? peer.get_channel(kBenchChannel)
+                           ->send_in_place((U32)data.size(), writer)
+                     : peer.send_in_place((U32)data.size(), writer);
+        NVCHK(sent, "IPC bench: send failed.");
+    }
+
+    void on_server_message(std::span<const U8> buf) {
+        if (!_streaming) {
+            send(*_server, buf);
+        } else if (++_received == _expected) {
+            U8 ack = 0;
+            send(*_server, {&ack, 1});
+        }
+    }
+
+    auto get_replies() -> U64 {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _replies;
+    }
+
+    void wait_replies(U64 expected) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        bool ok = _condition.wait_for(lock, std::chrono::seconds(60),
+                                      [&] { return _replies >= expected; });
+        NVCHK(ok, "IPC bench: no reply from the server.");
+    }
+
+    RefPtr<IPCServer> _server;
+    RefPtr<IPCClient> _client;
+    bool _channel{false};
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    U64 _replies{0};
+
+    std::atomic<bool> _streaming{false};
+    U64 _received{0};
+    U64 _expected{0};
+
+    std::atomic<bool> _loading{false};
+    std::thread _loadThread;
+};
+
+auto run_bench(LoopbackPair& pair, const BenchConfig& cfg, U64 size)
+    -> BenchResult {
+    U8Vector data(size);
+    for (U64 i = 0; i < size; ++i) {
+        data[i] = (U8)i;
+    }
+
+    BenchResult res;
+
+    // Latency:
+    U64 numPings = std::clamp<U64>(cfg.volume / (2 * size), 5,
+                                   maximum<U64>(cfg.iterations, 5));
+    Vector<F64> latencies;
+    latencies.reserve(numPings);
+    pair.start_load(64 * 1024);
+    for (U64 i = 0; i < numPings; ++i) {
+        latencies.push_back(pair.ping(data));
+    }
+    pair.stop_load();
+
+    std::sort(latencies.begin(), latencies.end());
+    res.p50 = percentile(latencies, 0.5);
+    res.p90 = percentile(latencies, 0.9);
+    res.p99 = percentile(latencies, 0.99);
+    res.max = latencies.back();
+
+    // Throughput:
+    U64 numMessages = std::clamp<U64>(cfg.volume / size, 16, 1000000);
+    F64 elapsed = pair.stream(data, numMessages);
+    res.mbPerSec = (F64)(numMessages * size) / elapsed / (1024.0 * 1024.0);
+    res.msgsPerSec = (F64)numMessages / elapsed;
+    return res;
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    String transportsArg = "pipe,shm,channel";
+    String sizesArg = "64,1K,16K,256K,4M,64M";
+    BenchConfig cfg;
+
+    for (int i = 1; i < argc; ++i) {
+        String arg(argv[i]);
+        auto pos = arg.find('=');
+        String key = arg.substr(0, pos);
+        String value = pos == String::npos ? "" : arg.substr(pos + 1);
+        if (key == "--transports") {
+            transportsArg = value;
+        } else if (key == "--sizes") {
+            sizesArg = value;
+        } else if (key == "--iterations") {
+            cfg.iterations = (U32)std::stoul(value);
+        } else if (key == "--volume") {
+            cfg.volume = parse_size(value);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--transports=pipe,shm,channel]"
+                         " [--sizes=64,1K,16K,256K,4M,64M]"
+                         " [--iterations=1000] [--volume=256M]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    cfg.sizes = split_sizes(sizesArg);
+    U64 maxSize = 0;
+    for (auto size : cfg.sizes) {
+        NVCHK(size > 0 && size <= IPCBase::MAX_MESSAGE_SIZE,
+              "Invalid message size: {}", size);
+        maxSize = maximum(maxSize, size);
+    }
+
+    auto& lman = LogManager::instance();
+    lman.set_notify_level(LogManager::L_WARN);
+
+    std::cout << fmt::format("{:<9}{:>6}{:>11}{:>11}{:>11}{:>11}{:>11}"
+                             "{:>12}\n",
+                             "transport", "size", "p50(us)", "p90", "p99",
+                             "max", "MB/s", "msgs/s");
+
+    for (const auto& transport : split_names(transportsArg)) {
+#ifndef __linux__
+        if (transport == "shm") {
+            std::cout << "shm: not supported on this platform.\n";
+            continue;
+        }
+#endif
+        cfg.transport = transport;
+        LoopbackPair pair(transport, maxSize);
+
+        for (auto size : cfg.sizes) {
+            auto res = run_bench(pair, cfg, size);
+            std::cout << fmt::format(
+                "{:<9}{:>6}{:>11.1f}{:>11.1f}{:>11.1f}{:>11.1f}{:>11.1f}"
+                "{:>12.0f}\n",
+                transport, format_size(size), res.p50, res.p90, res.p99,
+                res.max, res.mbPerSec, res.msgsPerSec);
+            std::cout.flush();
+        }
+    }
+
+    LogManager::destroy();
+    return 0;
+}
@@ -0,0 +1,260 @@
+// Logging throughput benchmark: measures the producer side latency of the
+// log calls and the total throughput (until all the messages reached the
+// sinks) for a matrix of sink types, thread counts and message sizes.
+//
+// Usage: nv_log_bench [--threads=1,2,4,8] [--sizes=16,128,1024]
+//                     [--sinks=null,std,file,buffered] [--messages=100000]
+//
+// The "thread" column reports the NV_USE_LOG_THREAD mode the library was
+// built with: configure one build directory with -DNV_USE_LOG_THREAD=0 and
+// one with -DNV_USE_LOG_THREAD=1 to compare both modes.
+
+#include <nvk_common.h>
+
+#include <nvk/log/BufferedFileLogger.h>
+#include <nvk/log/FileLogger.h>
+#include <nvk/log/StdLogger.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace nv;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class NullSink : public LogSink {
+  public:
+    void output(int /*level*/, const char* /*prefix*/, const char* /*msg*/,
+                size_t size) override {
+        _numBytes += size;
+    }
+
+  private:
+    U64 _numBytes{0};
+};
+
+struct BenchConfig {
+    String sink;
+    U32 numThreads{1};
+    U32 msgSize{0};
+    U32 numMessages{0};
+    // Use messages below the notify level:
+    bool filtered{false};
+};
+
+struct BenchResult {
+    F64 msgsPerSec{0.0};
+    // Latency percentiles of a single log call (in ns):
+    U64 p50{0};
+    U64 p90{0};
+    U64 p99{0};
+    U64 p999{0};
+    U64 max{0};
+};
+
+auto split_values(const String& str) -> Vector<U32> {
+    Vector<U32> res;
+    std::stringstream ss(str);
+    String item;
+    while (std::getline(ss, item, ',')) {
+        res.push_back((U32)std::stoul(item));
+    }
+    return res;
+}
+
+auto split_names(const String& str) -> Vector<String> {
+    Vector<String> res;
+    std::stringstream ss(str);
+    String item;
+    while (std::getline(ss, item, ',')) {
+        res.push_back(item);
+    }
+    return res;
+}
+
+auto get_temp_file(const char* name) -> String {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+auto create_sink(const String& name) -> RefPtr<LogSink> {
+    if (name == "null") {
+        return new NullSink();
+    }
+    if (name == "std") {
+        return new StdLogger();
+    }
+    if (name == "file") {
+        return new FileLogger(get_temp_file("nv_log_bench.log").c_str());
+    }
+    if (name == "buffered") {
+        return new BufferedFileLogger(
+            get_temp_file("nv_log_bench_buffered.log").c_str());
+    }
+    THROW_MSG("Unknown sink type: {}", name);
+    return nullptr;
+}
+
+// Redirect stdout to the null device while benchmarking the std sink, so
+// that the result table stays readable.
+class StdoutSilencer {
+  public:
+    explicit StdoutSilencer(bool enabled) {
+#ifndef _WIN32
+        if (enabled) {
+            std::cout.flush();
+            _savedFd = dup(1);
+            int nullFd = open("/dev/null", O_WRONLY);
+            dup2(nullFd, 1);
+            close(nullFd);
+        }
+#endif
+    }
+
+    ~StdoutSilencer() {
+#ifndef _WIN32
+        if (_savedFd >= 0) {
+            std::cout.flush();
+            dup2(_savedFd, 1);
+            close(_savedFd);
+        }
+#endif
+    }
+
+  private:
+    int _savedFd{-1};
+};
+
+auto percentile(const Vector<U64>& sorted, F64 ratio) -> U64 {
+    if (sorted.empty()) {
+        return 0;
+    }
+    auto idx = (size_t)(ratio * (F64)(sorted.size() - 1));
+    return sorted[idx];
+}
+
+auto run_bench(const BenchConfig& cfg) -> BenchResult {
+    auto& lman = LogManager::instance();
+    auto sink = create_sink(cfg.sink);
+
+    StdoutSilencer silencer(cfg.sink == "std");
+    lman.add_sink(sink.get());
+
+    String payload(cfg.msgSize, 'x');
+    std::string_view payloadView(payload);
+
+    Vector<Vector<U64>> latencies(cfg.numThreads);
+    Vector<std::thread> threads;
+
+    auto start = Clock::now();
+    for (U32 t = 0; t < cfg.numThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            auto& lat = latencies[t];
+            lat.resize(cfg.numMessages);
+            for (U32 i = 0; i < cfg.numMessages; ++i) {
+                auto t0 = Clock::now();
+                if (cfg.filtered) {
+                    logDEBUG("bench {} {} {}", t, i, payloadView);
+                } else {
+                    logINFO("bench {} {} {}", t, i, payloadView);
+                }
+                lat[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             Clock::now() - t0)
+                             .count();
+            }
+        });
+    }
+
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    // Wait until all the messages reached the sink:
+    lman.flush();
+    auto elapsed = std::chrono::duration<F64>(Clock::now() - start).count();
+
+    lman.remove_sink(sink.get());
+
+    Vector<U64> all;
+    all.reserve((size_t)cfg.numThreads * cfg.numMessages);
+    for (const auto& lat : latencies) {
+        all.insert(all.end(), lat.begin(), lat.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    BenchResult res;
+    res.msgsPerSec = (F64)all.size() / elapsed;
+    res.p50 = percentile(all, 0.5);
+    res.p90 = percentile(all, 0.9);
+    res.p99 = percentile(all, 0.99);
+    res.p999 = percentile(all, 0.999);
+    res.max = all.empty() ? 0 : all.back();
+    return res;
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int {
+    String threadsArg = "1,2,4,8";
+    String sizesArg = "16,128,1024";
+    String sinksArg = "null,std,file,buffered";
+    U32 numMessages = 100000;
+
+    for (int i = 1; i < argc; ++i) {
+        String arg(argv[i]);
+        auto pos = arg.find('=');
+        String key = arg.substr(0, pos);
+        String value = pos == String::npos ? "" : arg.substr(pos + 1);
+        if (key == "--threads") {
+            threadsArg = value;
+        } else if (key == "--sizes") {
+            sizesArg = value;
+        } else if (key == "--sinks") {
+            sinksArg = value;
+        } else if (key == "--messages") {
+            numMessages = (U32)std::stoul(value);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--threads=1,2,4,8] [--sizes=16,128,1024]"
+                         " [--sinks=null,std,file,buffered]"
+                         " [--messages=100000]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    auto& lman = LogManager::instance();
+    lman.set_notify_level(LogManager::L_INFO);
+
+    std::cout << fmt::format("{:<9}{:>7}{:>8}{:>6}{:>10}{:>14}{:>9}{:>9}{:>9}"
+                             "{:>10}{:>11}\n",
+                             "sink", "thread", "threads", "size", "mode",
+                             "msgs/s", "p50(ns)", "p90", "p99", "p99.9",
+                             "max");
+
+    for (const auto& sinkName : split_names(sinksArg)) {
+        for (auto numThreads : split_values(threadsArg)) {
+            for (auto msgSize : split_values(sizesArg)) {
+                for (bool filtered : {false, true}) {
+                    BenchConfig cfg{sinkName, numThreads, msgSize,
+                                    numMessages, filtered};
+                    auto res = run_bench(cfg);
+                    std::cout << fmt::format(
+                        "{:<9}{:>7}{:>8}{:>6}{:>10}{:>14.0f}{:>9}{:>9}{:>9}"
+                        "{:>10}{:>11}\n",
+                        sinkName, NV_USE_LOG_THREAD ? "on" : "off", numThreads,
+                        msgSize, filtered ? "filtered" : "emitted",
+                        res.msgsPerSec, res.p50, res.p90, res.p99, res.p999,
+                        res.max);
+                    std::cout.flush();
+                }
+            }
+        }
+    }
+
+    LogManager::destroy();
+    return 0;
+}
@@ -0,0 +1,171 @@
+// file: sources/nvk/base/MappedFile.cpp
+
+#include <nvk/base/MappedFile.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NV_HAS_MMAP 1
+#endif
+
+namespace nv {
+
+MappedFile::MappedFile(const char* fname, Traits traits) {
+    if (map(fname)) {
+        if (traits.access != MAPPED_ACCESS_NORMAL) {
+            advise(traits.access);
+        }
+        return;
+    }
+
+    NVCHK(traits.allowFallback, "Cannot map file {}", fname);
+    _buffer = read_system_file(fname);
+    _data = (const U8*)_buffer.data();
+    _size = _buffer.size();
+}
+
+MappedFile::~MappedFile() { unmap(); }
+
+auto MappedFile::from_buffer(String buffer) -> RefPtr<MappedFile> {
+    auto file = nv::create<MappedFile>();
+    file->_buffer = std::move(buffer);
+    file->_data = (const U8*)file->_buffer.data();
+    file->_size = file->_buffer.size();
+    return file;
+}
+
+#if defined(_WIN32)
+
+auto MappedFile::map(const char* fname) -> bool {
+    HANDLE file =
+        CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    NVCHK(file != INVALID_HANDLE_VALUE, "File {} doesn't exist.", fname);
+    _file = file;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) == 0 || size.QuadPart == 0) {
+        // Empty files cannot be mapped:
+        unmap();
+        return false;
+    }
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping == nullptr) {
+        unmap();
+        return false;
+    }
+
+    _data = (const U8*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (_data == nullptr) {
+        unmap();
+        return false;
+    }
+
+    _size = (U64)size.QuadPart;
+    _mapped = true;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (_mapped) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr) {
+        CloseHandle(_file);
+    }
+    _mapping = nullptr;
+    _file = nullptr;
+    _mapped = false;
+}
+
+void MappedFile::advise(MappedFileAccess access, U64 offset, U64 size) const {
+    if (!_mapped || access != MAPPED_ACCESS_WILLNEED) {
+        return;
+    }
+    // Only the prefetch hint has an equivalent on Windows:
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (PVOID)(_data + offset);
+    range.NumberOfBytes = size == 0 ? _size - offset : size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#elif defined(NV_HAS_MMAP)
+
+auto MappedFile::map(const char* fname) -> bool {
+    int fd = ::open(fname, O_RDONLY | O_CLOEXEC);
+    NVCHK(fd >= 0, "File {} doesn't exist.", fname);
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        // Empty files cannot be mapped:
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the descriptor:
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+
+    _data = (const U8*)ptr;
+    _size = (U64)st.st_size;
+    _mapped = true;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (_mapped) {
+        munmap((void*)_data, _size);
+        _mapped = false;
+    }
+}
+
+void MappedFile::advise(MappedFileAccess access, U64 offset, U64 size) const {
+    if (!_mapped || offset >= _size) {
+        return;
+    }
+
+    int advice = MADV_NORMAL;
+    switch (access) {
+    case MAPPED_ACCESS_SEQUENTIAL:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case MAPPED_ACCESS_RANDOM:
+        advice = MADV_RANDOM;
+        break;
+    case MAPPED_ACCESS_WILLNEED:
+        advice = MADV_WILLNEED;
+        break;
+    default:
+        break;
+    }
+
+    // madvise() requires a page aligned address:
+    static const U64 pageSize = (U64)sysconf(_SC_PAGESIZE);
+    U64 start = offset & ~(pageSize - 1);
+    U64 end = size == 0 ? _size : minimum(offset + size, _size);
+    madvise((void*)(_data + start), end - start, advice);
+}
+
+#else
+
+auto MappedFile::map(const char* /*fname*/) -> bool { return false; }
+
+void MappedFile::unmap() {}
+
+void MappedFile::advise(MappedFileAccess /*access*/, U64 /*offset*/,
+                        U64 /*size*/) const {}
+
+#endif
+
+} // namespace nv
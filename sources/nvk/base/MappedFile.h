@@ -0,0 +1,91 @@
+// file: sources/nvk/base/MappedFile.h
+
+#ifndef NV_MAPPEDFILE_H_
+#define NV_MAPPEDFILE_H_
+
+#include <nvk_common.h>
+
+#include <span>
+
+namespace nv {
+
+/** Expected access pattern of a mapped file, forwarded to the kernel as a
+ * madvise() hint. */
+enum MappedFileAccess : U8 {
+    MAPPED_ACCESS_NORMAL,
+    MAPPED_ACCESS_SEQUENTIAL,
+    MAPPED_ACCESS_RANDOM,
+    MAPPED_ACCESS_WILLNEED,
+};
+
+struct MappedFileTraits {
+    MappedFileAccess access{MAPPED_ACCESS_NORMAL};
+    // Read the file into memory if it cannot be mapped (else throw):
+    bool allowFallback{true};
+};
+
+/** Read-only view of a whole file, memory mapped when possible.
+
+    The file content is accessed with data()/size() (or span()/view())
+    without any copy, and the pages are loaded lazily by the OS. When mmap
+    is not available (eg. emscripten) or fails, the file is read into an
+    internal buffer instead, so the callers don't have to care.
+
+    A MappedFile can also wrap an in-memory buffer (for resources read from
+    a pack file), and being a RefObject it can be shared by the objects
+    pointing into its content. */
+class MappedFile : public RefObject {
+    NV_DECLARE_NO_COPY(MappedFile)
+    NV_DECLARE_NO_MOVE(MappedFile)
+
+  public:
+    using Traits = MappedFileTraits;
+
+    /** Empty content. */
+    MappedFile() = default;
+
+    explicit MappedFile(const char* fname, Traits traits = {});
+    explicit MappedFile(const String& fname, Traits traits = {})
+        : MappedFile(fname.c_str(), traits) {}
+
+    ~MappedFile() override;
+
+    /** Wrap an in-memory buffer (eg. a file read from a resource pack). */
+    static auto from_buffer(String buffer) -> RefPtr<MappedFile>;
+
+    [[nodiscard]] auto data() const -> const U8* { return _data; }
+    [[nodiscard]] auto size() const -> U64 { return _size; }
+    [[nodiscard]] auto empty() const -> bool { return _size == 0; }
+
+    [[nodiscard]] auto span() const -> std::span<const U8> {
+        return {_data, (size_t)_size};
+    }
+    [[nodiscard]] auto view() const -> std::string_view {
+        return {(const char*)_data, (size_t)_size};
+    }
+
+    /** True if the content is mapped (false for the read fallback). */
+    [[nodiscard]] auto is_mapped() const -> bool { return _mapped; }
+
+    /** Give an access hint for a range of the file (the whole file if size
+     * is 0). No-op if the content is not mapped. */
+    void advise(MappedFileAccess access, U64 offset = 0, U64 size = 0) const;
+
+  private:
+    auto map(const char* fname) -> bool;
+    void unmap();
+
+    const U8* _data{nullptr};
+    U64 _size{0};
+    bool _mapped{false};
+    String _buffer;
+
+#ifdef _WIN32
+    void* _file{nullptr};
+    void* _mapping{nullptr};
+#endif
+};
+
+} // namespace nv
+
+#endif
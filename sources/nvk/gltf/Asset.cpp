@@ -1,5 +1,7 @@
 #include <nvk_gltf.h>
 
+#include <nvk/base/MappedFile.h>
+
 namespace nv {
 
 namespace gltf {
@@ -364,6 +366,11 @@ void GLTFAsset::load_gltf(const char* path, bool load_buffers,
 }
 
 void GLTFAsset::load_glb_from_memory(const String& content) {
+    load_glb_from_memory(
+        std::span<const U8>((const U8*)content.data(), content.size()));
+}
+
+void GLTFAsset::load_glb_from_memory(std::span<const U8> content) {
     clear();
     NVCHK(content.size() >= sizeof(GLBHeader),
           "File too small to be valid GLB");
@@ -427,8 +434,10 @@ void GLTFAsset::load_glb_from_memory(const String& content) {
 }
 
 void GLTFAsset::load_glb(const char* path, bool forceAllowSystem) {
-    String content = nv::read_virtual_file(path, forceAllowSystem);
-    load_glb_from_memory(content);
+    // The JSON and BIN chunks are parsed/copied straight from the mapping:
+    auto file = nv::map_virtual_file(path, forceAllowSystem);
+    file->advise(MAPPED_ACCESS_SEQUENTIAL);
+    load_glb_from_memory(file->span());
 }
 
 void GLTFAsset::update_all_position_bounds() const {
@@ -52,6 +52,7 @@ class GLTFAsset : public RefObject {
     void load_glb(const char* path, bool forceAllowSystem = false);
     void load_from_json(const Json& data, U8Vector* glb_bin_chunk = nullptr);
     void load_glb_from_memory(const String& content);
+    void load_glb_from_memory(std::span<const U8> content);
 
     auto write_json() const -> Json;
     void save(const char* path) const;
@@ -0,0 +1,640 @@
+// file: sources/nvk/io/AsyncFileIO.cpp
+
+#include <nvk/io/AsyncFileIO.h>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if NV_USE_IO_URING
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace nv {
+
+// Max size of a single read call (the syscalls use 32 bit sizes):
+static constexpr U64 kMaxReadChunk = 1ULL << 30;
+
+enum AsyncResultKind : U8 {
+    ASYNC_RESULT_BYTES,
+    ASYNC_RESULT_STRING,
+    ASYNC_RESULT_COUNT,
+};
+
+struct AsyncFileIO::Request {
+    String filename;
+    U64 offset{0};
+    U64 size{0};
+    // The size is not known yet, read up to the end of the file:
+    bool toEnd{false};
+    AsyncResultKind kind{ASYNC_RESULT_BYTES};
+
+    U8Vector bytes;
+    String text;
+    // Write position (in bytes/text, or the caller buffer):
+    U8* dest{nullptr};
+    U64 done{0};
+    int fd{-1};
+    RefPtr<PromiseBase> promise;
+
+#if NV_USE_IO_URING
+    struct iovec iov {};
+#endif
+};
+
+using RequestPtr = std::unique_ptr<AsyncFileIO::Request>;
+
+namespace {
+
+auto make_request(const String& fname, U64 offset, U64 size,
+                  AsyncResultKind kind) -> RequestPtr {
+    auto req = std::make_unique<AsyncFileIO::Request>();
+    req->filename = fname;
+    req->offset = offset;
+    req->size = size;
+    req->toEnd = size == 0;
+    req->kind = kind;
+    req->promise = create_ref_object<PromiseBase>();
+    return req;
+}
+
+// Open the file and allocate the destination buffer.
+void open_request(AsyncFileIO::Request& req) {
+#ifdef _WIN32
+    req.fd = _open(req.filename.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    req.fd = ::open(req.filename.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    NVCHK(req.fd >= 0, "File {} doesn't exist.", req.filename);
+
+    if (req.toEnd) {
+#ifdef _WIN32
+        struct _stat64 st {};
+        NVCHK(_fstat64(req.fd, &st) == 0, "Cannot stat file {}", req.filename);
+#else
+        struct stat st {};
+        NVCHK(fstat(req.fd, &st) == 0, "Cannot stat file {}", req.filename);
+#endif
+        U64 fileSize = st.st_size;
+        req.size = fileSize > req.offset ? fileSize - req.offset : 0;
+    }
+
+    if (req.dest == nullptr) {
+        if (req.kind == ASYNC_RESULT_STRING) {
+            req.text.resize(req.size);
+            req.dest = (U8*)req.text.data();
+        } else {
+            req.bytes.resize(req.size);
+            req.dest = req.bytes.data();
+        }
+    }
+}
+
+void close_request(AsyncFileIO::Request& req) {
+    if (req.fd >= 0) {
+#ifdef _WIN32
+        _close(req.fd);
+#else
+        ::close(req.fd);
+#endif
+        req.fd = -1;
+    }
+}
+
+void finish_request(AsyncFileIO::Request& req) {
+    close_request(req);
+
+    // Short reads (end of file reached) are not errors:
+    Any value;
+    switch (req.kind) {
+    case ASYNC_RESULT_STRING:
+        req.text.resize(req.done);
+        value.set(std::move(req.text));
+        break;
+    case ASYNC_RESULT_BYTES:
+        req.bytes.resize(req.done);
+        value.set(std::move(req.bytes));
+        break;
+    default:
+        value = Any(req.done);
+    }
+    req.promise->resolve_internal(std::move(value));
+}
+
+void fail_request(AsyncFileIO::Request& req, std::exception_ptr error) {
+    close_request(req);
+    req.promise->reject_internal(Any(std::move(error)));
+}
+
+auto make_read_error(const AsyncFileIO::Request& req, int err)
+    -> std::exception_ptr {
+    return std::make_exception_ptr(std::runtime_error(
+        fmt::format("Read error on file {} (errno={})", req.filename, err)));
+}
+
+// Positional read, returning the number of bytes read or -1 with errno set.
+auto read_at(int fd, U8* dest, U64 size, U64 offset) -> I64 {
+#ifdef _WIN32
+    auto handle = (HANDLE)_get_osfhandle(fd);
+    OVERLAPPED ov{};
+    ov.Offset = (DWORD)(offset & 0xffffffffULL);
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD count = 0;
+    if (ReadFile(handle, dest, (DWORD)size, &count, &ov) == 0) {
+        if (GetLastError() == ERROR_HANDLE_EOF) {
+            return 0;
+        }
+        errno = EIO;
+        return -1;
+    }
+    return count;
+#else
+    return ::pread(fd, dest, size, (off_t)offset);
+#endif
+}
+
+// Execute a request synchronously, in the current thread.
+void read_request(AsyncFileIO::Request& req) {
+    try {
+        open_request(req);
+        while (req.done < req.size) {
+            U64 chunk = minimum(req.size - req.done, kMaxReadChunk);
+            I64 res = read_at(req.fd, req.dest + req.done, chunk,
+                              req.offset + req.done);
+            if (res < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fail_request(req, make_read_error(req, errno));
+                return;
+            }
+            if (res == 0) {
+                break;
+            }
+            req.done += res;
+        }
+    } catch (...) {
+        fail_request(req, std::current_exception());
+        return;
+    }
+    finish_request(req);
+}
+
+} // namespace
+
+#if NV_USE_IO_URING
+
+// User data of the completion of the wake up poll on the eventfd:
+static constexpr U64 kWakeUpUserData = 0;
+
+struct AsyncFileIO::Ring {
+    int fd{-1};
+    int eventFd{-1};
+
+    void* sqPtr{nullptr};
+    size_t sqSize{0};
+    void* cqPtr{nullptr};
+    size_t cqSize{0};
+    io_uring_sqe* sqes{nullptr};
+    size_t sqesSize{0};
+
+    U32* sqHead{nullptr};
+    U32* sqTail{nullptr};
+    U32 sqMask{0};
+    U32* sqArray{nullptr};
+    U32 sqEntries{0};
+    U32* cqHead{nullptr};
+    U32* cqTail{nullptr};
+    U32 cqMask{0};
+    io_uring_cqe* cqes{nullptr};
+
+    // Tail of the SQEs prepared but not yet published to the kernel:
+    U32 localTail{0};
+    // Number of SQEs queued and not yet passed to io_uring_enter():
+    U32 toSubmit{0};
+    bool pollArmed{false};
+
+    ~Ring() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqPtr != nullptr && cqPtr != sqPtr) {
+            munmap(cqPtr, cqSize);
+        }
+        if (sqPtr != nullptr) {
+            munmap(sqPtr, sqSize);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        if (eventFd >= 0) {
+            ::close(eventFd);
+        }
+    }
+
+    auto get_sqe() -> io_uring_sqe* {
+        U32 index = localTail++ & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        sqArray[index] = index;
+        toSubmit++;
+        return sqe;
+    }
+
+    // Make the prepared SQEs visible to the kernel:
+    void publish() { __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE); }
+};
+
+#endif
+
+NV_IMPLEMENT_RAW_INSTANCE(AsyncFileIO)
+
+AsyncFileIO::AsyncFileIO() = default;
+
+AsyncFileIO::~AsyncFileIO() { stop(); }
+
+void AsyncFileIO::init_instance() {
+#if NV_USE_IO_URING
+    if (init_ring()) {
+        _backend = ASYNC_IO_IO_URING;
+        _threads.emplace_back([this] { ring_loop(); });
+        logDEBUG("AsyncFileIO: using io_uring backend.");
+        return;
+    }
+#endif
+
+    if (NV_ASYNC_IO_THREADS > 0) {
+        _backend = ASYNC_IO_THREAD_POOL;
+        for (U32 i = 0; i < NV_ASYNC_IO_THREADS; ++i) {
+            _threads.emplace_back([this] { worker_loop(); });
+        }
+    }
+    logDEBUG("AsyncFileIO: using {} backend.",
+             _backend == ASYNC_IO_SYNC ? "synchronous" : "thread pool");
+}
+
+void AsyncFileIO::uninit_instance() { stop(); }
+
+void AsyncFileIO::stop() {
+    {
+        std::lock_guard lock(_mutex);
+        if (_stopping) {
+            return;
+        }
+        _stopping = true;
+    }
+    _cv.notify_all();
+
+#if NV_USE_IO_URING
+    if (_ring != nullptr) {
+        U64 one = 1;
+        auto res = ::write(_ring->eventFd, &one, sizeof(one));
+        (void)res;
+    }
+#endif
+
+    for (auto& t : _threads) {
+        t.join();
+    }
+    _threads.clear();
+
+    // Reject the reads that were never started:
+    for (auto& req : _queue) {
+        fail_request(*req, std::make_exception_ptr(std::runtime_error(
+                               "AsyncFileIO stopped before reading " +
+                               req->filename)));
+    }
+    _queue.clear();
+}
+
+auto AsyncFileIO::read_file(const String& fname) -> Promise<U8Vector> {
+    auto req = make_request(fname, 0, 0, ASYNC_RESULT_BYTES);
+    Promise<U8Vector> res(req->promise);
+    Vector<RequestPtr> reqs;
+    reqs.emplace_back(std::move(req));
+    submit(std::move(reqs));
+    return res;
+}
+
+auto AsyncFileIO::read_file_string(const String& fname) -> Promise<String> {
+    auto req = make_request(fname, 0, 0, ASYNC_RESULT_STRING);
+    Promise<String> res(req->promise);
+    Vector<RequestPtr> reqs;
+    reqs.emplace_back(std::move(req));
+    submit(std::move(reqs));
+    return res;
+}
+
+auto AsyncFileIO::read_range(const String& fname, U64 offset, U64 size)
+    -> Promise<U8Vector> {
+    auto req = make_request(fname, offset, size, ASYNC_RESULT_BYTES);
+    Promise<U8Vector> res(req->promise);
+    Vector<RequestPtr> reqs;
+    reqs.emplace_back(std::move(req));
+    submit(std::move(reqs));
+    return res;
+}
+
+auto AsyncFileIO::read_into(const String& fname, std::span<U8> dest,
+                            U64 offset) -> Promise<U64> {
+    auto req = make_request(fname, offset, dest.size(), ASYNC_RESULT_COUNT);
+    req->toEnd = false;
+    req->dest = dest.data();
+    Promise<U64> res(req->promise);
+    Vector<RequestPtr> reqs;
+    reqs.emplace_back(std::move(req));
+    submit(std::move(reqs));
+    return res;
+}
+
+auto AsyncFileIO::read_batch(const Vector<AsyncReadDesc>& reads)
+    -> Vector<Promise<U8Vector>> {
+    Vector<Promise<U8Vector>> res;
+    Vector<RequestPtr> reqs;
+    res.reserve(reads.size());
+    reqs.reserve(reads.size());
+    for (const auto& desc : reads) {
+        auto req = make_request(desc.filename, desc.offset, desc.size,
+                                ASYNC_RESULT_BYTES);
+        res.emplace_back(req->promise);
+        reqs.emplace_back(std::move(req));
+    }
+    submit(std::move(reqs));
+    return res;
+}
+
+void AsyncFileIO::submit(Vector<RequestPtr> requests) {
+    if (_backend == ASYNC_IO_SYNC) {
+        for (auto& req : requests) {
+            read_request(*req);
+        }
+        return;
+    }
+
+    bool stopping = false;
+    {
+        std::lock_guard lock(_mutex);
+        stopping = _stopping;
+        if (!stopping) {
+            for (auto& req : requests) {
+                _queue.emplace_back(std::move(req));
+            }
+        }
+    }
+
+    // Report the error through the promises, like the other read failures:
+    if (stopping) {
+        for (auto& req : requests) {
+            fail_request(*req, std::make_exception_ptr(std::runtime_error(
+                                   "AsyncFileIO stopped, cannot read " +
+                                   req->filename)));
+        }
+        return;
+    }
+
+#if NV_USE_IO_URING
+    if (_backend == ASYNC_IO_IO_URING) {
+        // Wake up the ring thread:
+        U64 one = 1;
+        auto res = ::write(_ring->eventFd, &one, sizeof(one));
+        (void)res;
+        return;
+    }
+#endif
+
+    if (requests.size() == 1) {
+        _cv.notify_one();
+    } else {
+        _cv.notify_all();
+    }
+}
+
+void AsyncFileIO::worker_loop() {
+    while (true) {
+        RequestPtr req;
+        {
+            std::unique_lock lock(_mutex);
+            _cv.wait(lock, [this] { return _stopping || !_queue.empty(); });
+            if (_stopping) {
+                return;
+            }
+            req = std::move(_queue.front());
+            _queue.pop_front();
+        }
+        read_request(*req);
+    }
+}
+
+#if NV_USE_IO_URING
+
+auto AsyncFileIO::init_ring() -> bool {
+    auto ring = std::make_unique<Ring>();
+
+    io_uring_params params{};
+    ring->fd = (int)syscall(__NR_io_uring_setup, NV_ASYNC_IO_QUEUE_DEPTH,
+                            &params);
+    if (ring->fd < 0) {
+        // Old kernel, or io_uring disabled (eg. in containers):
+        logDEBUG("AsyncFileIO: io_uring not available (errno={})", errno);
+        return false;
+    }
+
+    ring->sqSize = params.sq_off.array + params.sq_entries * sizeof(U32);
+    ring->cqSize =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) {
+        ring->sqSize = ring->cqSize = maximum(ring->sqSize, ring->cqSize);
+    }
+
+    ring->sqPtr = mmap(nullptr, ring->sqSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqPtr == MAP_FAILED) {
+        ring->sqPtr = nullptr;
+        return false;
+    }
+
+    if (singleMap) {
+        ring->cqPtr = ring->sqPtr;
+    } else {
+        ring->cqPtr =
+            mmap(nullptr, ring->cqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqPtr == MAP_FAILED) {
+            ring->cqPtr = nullptr;
+            return false;
+        }
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    ring->sqes = (io_uring_sqe*)sqes;
+
+    auto* sq = (U8*)ring->sqPtr;
+    ring->sqHead = (U32*)(sq + params.sq_off.head);
+    ring->sqTail = (U32*)(sq + params.sq_off.tail);
+    ring->sqMask = *(U32*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (U32*)(sq + params.sq_off.array);
+    ring->sqEntries = params.sq_entries;
+    ring->localTail = *ring->sqTail;
+
+    auto* cq = (U8*)ring->cqPtr;
+    ring->cqHead = (U32*)(cq + params.cq_off.head);
+    ring->cqTail = (U32*)(cq + params.cq_off.tail);
+    ring->cqMask = *(U32*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    ring->eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring->eventFd < 0) {
+        return false;
+    }
+
+    _ring = std::move(ring);
+    return true;
+}
+
+auto AsyncFileIO::ring_prepare(Request* req) -> bool {
+    if (req->done >= req->size) {
+        return false;
+    }
+
+    req->iov.iov_base = req->dest + req->done;
+    req->iov.iov_len = minimum(req->size - req->done, kMaxReadChunk);
+
+    io_uring_sqe* sqe = _ring->get_sqe();
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = req->fd;
+    sqe->addr = (U64)&req->iov;
+    sqe->len = 1;
+    sqe->off = req->offset + req->done;
+    sqe->user_data = (U64)req;
+    return true;
+}
+
+void AsyncFileIO::ring_complete(U64 userData, I32 res) {
+    auto* req = (Request*)userData;
+
+    if (res == -EINTR || res == -EAGAIN) {
+        ring_prepare(req);
+        return;
+    }
+
+    if (res > 0) {
+        req->done += res;
+        if (ring_prepare(req)) {
+            return;
+        }
+    }
+
+    // Done, end of file reached, or error:
+    RequestPtr owned(req);
+    _inFlight--;
+    if (res < 0) {
+        fail_request(*req, make_read_error(*req, -res));
+    } else {
+        finish_request(*req);
+    }
+}
+
+void AsyncFileIO::ring_loop() {
+    // Keep one SQE for the wake up poll:
+    U32 maxInFlight = _ring->sqEntries - 1;
+
+    while (true) {
+        Vector<RequestPtr> incoming;
+        {
+            std::lock_guard lock(_mutex);
+            if (_stopping) {
+                // Only wait for the reads already submitted:
+                if (_inFlight == 0) {
+                    break;
+                }
+            } else {
+                while (!_queue.empty() && _inFlight + incoming.size() <
+                                              maxInFlight) {
+                    incoming.emplace_back(std::move(_queue.front()));
+                    _queue.pop_front();
+                }
+            }
+        }
+
+        for (auto& req : incoming) {
+            try {
+                open_request(*req);
+            } catch (...) {
+                fail_request(*req, std::current_exception());
+                continue;
+            }
+
+            if (ring_prepare(req.get())) {
+                // Owned by the ring until its completion:
+                req.release();
+                _inFlight++;
+            } else {
+                // Nothing to read:
+                finish_request(*req);
+            }
+        }
+
+        if (!_ring->pollArmed && !_stopping) {
+            io_uring_sqe* sqe = _ring->get_sqe();
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = _ring->eventFd;
+            sqe->poll_events = POLLIN;
+            sqe->user_data = kWakeUpUserData;
+            _ring->pollArmed = true;
+        }
+
+        // Submit the new reads and wait for at least one completion:
+        _ring->publish();
+        int ret = (int)syscall(__NR_io_uring_enter, _ring->fd, _ring->toSubmit,
+                               1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0) {
+            if (errno != EINTR && errno != EBUSY && errno != EAGAIN) {
+                logERROR("AsyncFileIO: io_uring_enter failed (errno={})",
+                         errno);
+            }
+        } else {
+            _ring->toSubmit -= minimum((U32)ret, _ring->toSubmit);
+        }
+
+        // Process the completions:
+        U32 head = *_ring->cqHead;
+        U32 tail = __atomic_load_n(_ring->cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const io_uring_cqe& cqe = _ring->cqes[head & _ring->cqMask];
+            U64 userData = cqe.user_data;
+            I32 res = cqe.res;
+            head++;
+
+            if (userData == kWakeUpUserData) {
+                U64 count = 0;
+                auto n = ::read(_ring->eventFd, &count, sizeof(count));
+                (void)n;
+                _ring->pollArmed = false;
+            } else {
+                ring_complete(userData, res);
+            }
+        }
+        __atomic_store_n(_ring->cqHead, head, __ATOMIC_RELEASE);
+    }
+}
+
+#endif
+
+} // namespace nv
@@ -0,0 +1,124 @@
+// file: sources/nvk/io/AsyncFileIO.h
+
+#ifndef NV_ASYNCFILEIO_H_
+#define NV_ASYNCFILEIO_H_
+
+#include <nvk_common.h>
+
+#include <nvk/task/Promise.h>
+
+#include <span>
+
+// Use io_uring on Linux when the kernel supports it (set to 0 to always use
+// the thread pool backend):
+#ifndef NV_USE_IO_URING
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define NV_USE_IO_URING 1
+#else
+#define NV_USE_IO_URING 0
+#endif
+#endif
+
+// Number of threads of the fallback backend (0 to read synchronously in the
+// calling thread):
+#ifndef NV_ASYNC_IO_THREADS
+#ifdef __EMSCRIPTEN__
+#define NV_ASYNC_IO_THREADS 0
+#else
+#define NV_ASYNC_IO_THREADS 4
+#endif
+#endif
+
+// Max number of reads in flight in the io_uring backend:
+#ifndef NV_ASYNC_IO_QUEUE_DEPTH
+#define NV_ASYNC_IO_QUEUE_DEPTH 256
+#endif
+
+namespace nv {
+
+enum AsyncFileIOBackend : U8 {
+    ASYNC_IO_IO_URING,
+    ASYNC_IO_THREAD_POOL,
+    ASYNC_IO_SYNC,
+};
+
+/** Description of a read for AsyncFileIO::read_batch(). */
+struct AsyncReadDesc {
+    String filename;
+    U64 offset{0};
+    // Number of bytes to read, or 0 to read up to the end of the file:
+    U64 size{0};
+};
+
+/** Asynchronous file reader.
+
+    The reads are submitted to io_uring when available, or else executed by a
+    small pool of threads with pread(), so the calling thread never blocks on
+    the disk and many reads can be in flight at the same time.
+
+    The promises are settled from the I/O thread: their continuations run
+    there unless the JobDispatcher posts them to a thread pool, so heavy
+    processing (eg. decompression) should be dispatched to keep the I/O
+    flowing. Missing files and read errors reject the promises. */
+class AsyncFileIO {
+    NV_DECLARE_RAW_INSTANCE(AsyncFileIO)
+
+  public:
+    struct Request;
+
+    virtual ~AsyncFileIO();
+
+    /** Read a whole file. */
+    auto read_file(const String& fname) -> Promise<U8Vector>;
+    auto read_file_string(const String& fname) -> Promise<String>;
+
+    /** Read size bytes at offset (up to the end of the file if size is 0).
+     * The result is shorter than size if the end of file is reached. */
+    auto read_range(const String& fname, U64 offset, U64 size)
+        -> Promise<U8Vector>;
+
+    /** Read into a caller provided buffer, which must stay valid until the
+     * promise settles. Resolves with the number of bytes read. */
+    auto read_into(const String& fname, std::span<U8> dest, U64 offset = 0)
+        -> Promise<U64>;
+
+    /** Submit multiple reads at once (with a single wake up of the I/O
+     * thread). */
+    auto read_batch(const Vector<AsyncReadDesc>& reads)
+        -> Vector<Promise<U8Vector>>;
+
+    [[nodiscard]] auto get_backend() const -> AsyncFileIOBackend {
+        return _backend;
+    }
+
+  private:
+    void submit(Vector<std::unique_ptr<Request>> requests);
+    void stop();
+
+    void worker_loop();
+
+#if NV_USE_IO_URING
+    struct Ring;
+
+    auto init_ring() -> bool;
+    void ring_loop();
+    auto ring_prepare(Request* req) -> bool;
+    void ring_complete(U64 userData, I32 res);
+
+    std::unique_ptr<Ring> _ring;
+    // Number of requests currently submitted to the ring:
+    U32 _inFlight{0};
+#endif
+
+    AsyncFileIOBackend _backend{ASYNC_IO_SYNC};
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::unique_ptr<Request>> _queue;
+    Vector<std::thread> _threads;
+    bool _stopping{false};
+};
+
+} // namespace nv
+
+#endif
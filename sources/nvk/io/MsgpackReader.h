@@ -10,9 +10,15 @@
 //   positive fixint / negative fixint
 //   uint8 / uint16 / uint32 / uint64
 //   int8  / int16  / int32  / int64
-//   float32
+//   float32 / float64
 //   bin8  / bin16  / bin32   (raw bytes)
-//   nil / false / true       (skippable, not explicitly returned)
+//   fixext 1-16 / ext8 / ext16 / ext32, including the timestamp type
+//   nil / false / true
+//
+// Strings, bins and exts can be read as views pointing into the source
+// buffer (readStringView / readBinSpan / readExt) to avoid allocations.
+// Numeric arrays written with MsgpackWriter::writeTypedArray() (or plain
+// arrays of numbers) can be decoded in bulk with readArrayInto().
 //
 // Usage:
 //   std::vector<U8> bytes = ...;
@@ -20,10 +26,11 @@
 //
 //   U32 nKeys = rdr.readMapSize();
 //   for (U32 i = 0; i < nKeys; ++i) {
-//       std::string key = rdr.readString();
+//       std::string_view key = rdr.readStringView();
 //       if (key == "count")       { I64 v = rdr.readInt(); }
 //       else if (key == "value")  { F32 v = rdr.readFloat(); }
-//       else if (key == "blob")   { auto b = rdr.readBin(); }
+//       else if (key == "blob")   { auto b = rdr.readBinSpan(); }
+//       else if (key == "label")  { auto l = rdr.readOptionalStringView(); }
 //       else                      { rdr.skipValue(); }
 //   }
 
@@ -31,10 +38,12 @@
 
 #include <cstdint>
 #include <cstring>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+#include <nvk/io/MsgpackTypes.h>
 #include <nvk_common.h> // NVCHK, THROW_MSG
 #include <nvk_types.h>
 
@@ -43,13 +52,17 @@ namespace nv {
 class MsgpackReader {
   public:
     // Construct from a raw byte span.  The caller owns the buffer and must
-    // keep it alive for the lifetime of this reader.
+    // keep it alive for the lifetime of this reader (and of the views
+    // returned by the reader).
     MsgpackReader(const U8* data, size_t size) noexcept
         : _p(data), _end(data + size) {}
 
     explicit MsgpackReader(const std::vector<U8>& buf) noexcept
         : MsgpackReader(buf.data(), buf.size()) {}
 
+    explicit MsgpackReader(std::span<const U8> buf) noexcept
+        : MsgpackReader(buf.data(), buf.size()) {}
+
     // ── Position queries ─────────────────────────────────────────────────────
 
     [[nodiscard]] auto atEnd() const noexcept -> bool { return _p >= _end; }
@@ -57,6 +70,9 @@ class MsgpackReader {
         return static_cast<size_t>(_end - _p);
     }
 
+    // True if the next value is nil (without consuming it).
+    [[nodiscard]] auto isNil() const -> bool { return _peekU8() == 0xc0; }
+
     // ── High-level typed readers
     // ──────────────────────────────────────────────
 
@@ -85,7 +101,10 @@ class MsgpackReader {
     }
 
     // Read a string (fixstr / str8 / str16 / str32).
-    auto readString() -> std::string {
+    auto readString() -> std::string { return std::string(readStringView()); }
+
+    // Read a string as a view into the source buffer.
+    auto readStringView() -> std::string_view {
         const U8 b = _readU8();
         U32 len = 0;
         if ((b & 0xe0u) == 0xa0u)
@@ -99,22 +118,20 @@ class MsgpackReader {
         else
             THROW_MSG("MsgpackReader::readString: unexpected byte 0x{:02x}.",
                       b);
-        return _readRawString(len);
+        const U8* ptr = _take(len, "readString");
+        return {reinterpret_cast<const char*>(ptr), len};
     }
 
     // Read a binary blob (bin8 / bin16 / bin32) → vector of bytes.
     auto readBin() -> std::vector<U8> {
-        const U8 b = _readU8();
-        U32 len = 0;
-        if (b == 0xc4)
-            len = _readU8(); // bin8
-        else if (b == 0xc5)
-            len = _readU16BE(); // bin16
-        else if (b == 0xc6)
-            len = _readU32BE(); // bin32
-        else
-            THROW_MSG("MsgpackReader::readBin: unexpected byte 0x{:02x}.", b);
-        return _readRawBytes(len);
+        const auto bin = readBinSpan();
+        return {bin.begin(), bin.end()};
+    }
+
+    // Read a binary blob as a view into the source buffer.
+    auto readBinSpan() -> std::span<const U8> {
+        const U32 len = _readBinHeader();
+        return {_take(len, "readBin"), len};
     }
 
     // Read any integer variant (positive/negative fixint, u/int 8–64) as I64.
@@ -151,27 +168,154 @@ class MsgpackReader {
         }
     }
 
-    // Read a float32 value.
+    // Read a float32 value (float64 and integer values are converted).
     auto readFloat() -> F32 {
-        const U8 b = _readU8();
-        NVCHK(
-            b == 0xca,
-            "MsgpackReader::readFloat: expected float32 (0xca), got 0x{:02x}.",
-            b);
-        return _readF32BE();
+        if (_peekU8() == 0xca) {
+            _p++;
+            return _readF32BE();
+        }
+        return static_cast<F32>(readDouble());
     }
 
-    // Read a float64 value.
+    // Read a float64 value (float32 and integer values are converted).
     auto readDouble() -> F64 {
+        const U8 b = _peekU8();
+        if (b == 0xcb) {
+            _p++;
+            return _readBE<F64>();
+        }
+        if (b == 0xca) {
+            _p++;
+            return _readF32BE();
+        }
+        NVCHK(_isInt(b),
+              "MsgpackReader::readDouble: expected a number, got 0x{:02x}.",
+              b);
+        if (b == 0xcf) {
+            _p++;
+            return static_cast<F64>(_readU64BE());
+        }
+        return static_cast<F64>(readInt());
+    }
+
+    // Read a boolean (0xc2 = false, 0xc3 = true).
+    auto readBool() -> bool {
         const U8 b = _readU8();
-        NVCHK(
-            b == 0xcb,
-            "MsgpackReader::readDouble: expected float64 (0xcb), got 0x{:02x}.",
-            b);
-        const U64 bits = _readU64BE();
-        F64 v;
-        std::memcpy(&v, &bits, sizeof(v));
-        return v;
+        NVCHK(b == 0xc2 || b == 0xc3,
+              "MsgpackReader::readBool: unexpected byte 0x{:02x}.", b);
+        return b == 0xc3;
+    }
+
+    // Read a nil value.
+    void readNil() {
+        const U8 b = _readU8();
+        NVCHK(b == 0xc0, "MsgpackReader::readNil: unexpected byte 0x{:02x}.",
+              b);
+    }
+
+    // Nil-aware readers: return an empty optional for nil values.
+    auto readOptionalInt() -> std::optional<I64> {
+        return _readOptional([this] { return readInt(); });
+    }
+    auto readOptionalDouble() -> std::optional<F64> {
+        return _readOptional([this] { return readDouble(); });
+    }
+    auto readOptionalBool() -> std::optional<bool> {
+        return _readOptional([this] { return readBool(); });
+    }
+    auto readOptionalStringView() -> std::optional<std::string_view> {
+        return _readOptional([this] { return readStringView(); });
+    }
+
+    // Read an ext header (fixext 1-16 / ext8 / ext16 / ext32) → payload
+    // size, with its type stored in type.
+    auto readExtHeader(I8& type) -> U32 {
+        const U8 b = _readU8();
+        U32 len = 0;
+        switch (b) {
+        case 0xd4:
+            len = 1;
+            break;
+        case 0xd5:
+            len = 2;
+            break;
+        case 0xd6:
+            len = 4;
+            break;
+        case 0xd7:
+            len = 8;
+            break;
+        case 0xd8:
+            len = 16;
+            break;
+        case 0xc7:
+            len = _readU8();
+            break;
+        case 0xc8:
+            len = _readU16BE();
+            break;
+        case 0xc9:
+            len = _readU32BE();
+            break;
+        default:
+            THROW_MSG("MsgpackReader::readExt: unexpected byte 0x{:02x}.", b);
+        }
+        type = static_cast<I8>(_readU8());
+        return len;
+    }
+
+    // Read an ext value, with its payload as a view into the source buffer.
+    auto readExt() -> MsgpackExt {
+        MsgpackExt ext;
+        const U32 len = readExtHeader(ext.type);
+        ext.data = {_take(len, "readExt"), len};
+        return ext;
+    }
+
+    // Read a timestamp ext value (32, 64 or 96 bits formats).
+    auto readTimestamp() -> MsgpackTimestamp {
+        const auto ext = readExt();
+        NVCHK(ext.type == MSGPACK_EXT_TIMESTAMP,
+              "MsgpackReader::readTimestamp: unexpected ext type {}.",
+              ext.type);
+        const U8* ptr = ext.data.data();
+        switch (ext.data.size()) {
+        case 4:
+            return {msgpack::load_be<U32>(ptr), 0};
+        case 8: {
+            const U64 v = msgpack::load_be<U64>(ptr);
+            return {static_cast<I64>(v & 0x3ffffffffULL),
+                    static_cast<U32>(v >> 34u)};
+        }
+        case 12:
+            return {msgpack::load_be<I64>(ptr + 4),
+                    msgpack::load_be<U32>(ptr)};
+        default:
+            THROW_MSG("MsgpackReader::readTimestamp: invalid size {}.",
+                      ext.data.size());
+        }
+    }
+
+    // Bulk read of a numeric array into out, from a typed array ext or a bin
+    // (as written by MsgpackWriter::writeTypedArray), or from a plain array
+    // of numbers. T may be a scalar or a vector type such as Vec3f.
+    // Returns the number of elements read, which must fit in out.
+    template <typename T> auto readArrayInto(std::span<T> out) -> size_t {
+        return _readTypedArray<T>([&out](size_t count) {
+            NVCHK(count <= out.size(),
+                  "MsgpackReader::readArrayInto: {} elements, buffer holds "
+                  "{}.",
+                  count, out.size());
+            return out.data();
+        });
+    }
+
+    // Bulk read of a numeric array, resizing out to the array size.
+    template <typename T> void readArrayInto(Vector<T>& out) {
+        _readTypedArray<T>([&out](size_t count) {
+            out.resize(count);
+            return out.data();
+        });
     }
 
     // Skip exactly one complete msgpack value (any type).
@@ -223,6 +367,21 @@ class MsgpackReader {
         case 0xcb:
             _advance(8);
             return; // uint64, int64, float64
+        case 0xd4:
+            _advance(2);
+            return; // fixext1 (type + data)
+        case 0xd5:
+            _advance(3);
+            return; // fixext2
+        case 0xd6:
+            _advance(5);
+            return; // fixext4
+        case 0xd7:
+            _advance(9);
+            return; // fixext8
+        case 0xd8:
+            _advance(17);
+            return; // fixext16
         case 0xd9: {
             _advance(_readU8());
             return;
@@ -247,6 +406,18 @@ class MsgpackReader {
             _advance(_readU32BE());
             return;
         } // bin32
+        case 0xc7: {
+            _advance(size_t(_readU8()) + 1);
+            return;
+        } // ext8
+        case 0xc8: {
+            _advance(size_t(_readU16BE()) + 1);
+            return;
+        } // ext16
+        case 0xc9: {
+            _advance(size_t(_readU32BE()) + 1);
+            return;
+        } // ext32
         case 0xde: {
             const U32 n = _readU16BE();
             for (U32 i = 0; i < n * 2u; ++i)
@@ -255,7 +426,7 @@ class MsgpackReader {
         } // map16
         case 0xdf: {
             const U32 n = _readU32BE();
-            for (U32 i = 0; i < n * 2u; ++i)
+            for (U64 i = 0; i < U64(n) * 2u; ++i)
                 skipValue();
             return;
         } // map32
@@ -283,9 +454,17 @@ class MsgpackReader {
     // ── Low-level primitives
     // ──────────────────────────────────────────────────
 
+    static auto _isInt(U8 b) -> bool {
+        return b <= 0x7fu || b >= 0xe0u || (b >= 0xcc && b <= 0xd3);
+    }
+
+    static auto _isExt(U8 b) -> bool {
+        return (b >= 0xd4 && b <= 0xd8) || (b >= 0xc7 && b <= 0xc9);
+    }
+
     void _checkAvailable(size_t n, const char* caller) const {
         NVCHK(
-            _p + n <= _end,
+            n <= remaining(),
             "MsgpackReader::{}: buffer overrun (need {} bytes, {} remaining).",
             caller, n, remaining());
     }
@@ -300,61 +479,105 @@ class MsgpackReader {
         return *_p++;
     }
 
-    auto _readU16BE() -> U16 {
-        _checkAvailable(2, "readU16BE");
-        const U16 v = static_cast<U16>((static_cast<U16>(_p[0]) << 8u) | _p[1]);
-        _p += 2;
+    template <typename T> auto _readBE() -> T {
+        _checkAvailable(sizeof(T), "readBE");
+        const T v = msgpack::load_be<T>(_p);
+        _p += sizeof(T);
         return v;
     }
 
-    auto _readU32BE() -> U32 {
-        _checkAvailable(4, "readU32BE");
-        const U32 v = (static_cast<U32>(_p[0]) << 24u) |
-                      (static_cast<U32>(_p[1]) << 16u) |
-                      (static_cast<U32>(_p[2]) << 8u) | static_cast<U32>(_p[3]);
-        _p += 4;
-        return v;
-    }
+    auto _readU16BE() -> U16 { return _readBE<U16>(); }
 
-    auto _readU64BE() -> U64 {
-        _checkAvailable(8, "readU64BE");
-        const U64 hi = _readU32BE();
-        const U64 lo = _readU32BE();
-        return (hi << 32u) | lo;
-    }
+    auto _readU32BE() -> U32 { return _readBE<U32>(); }
+
+    auto _readU64BE() -> U64 { return _readBE<U64>(); }
 
     // Reads a big-endian IEEE-754 float32 via memcpy — no aliasing UB,
     // same pattern used by RprDecoder in the SDK.
-    auto _readF32BE() -> F32 {
-        _checkAvailable(4, "readF32BE");
-        U32 raw = (static_cast<U32>(_p[0]) << 24u) |
-                  (static_cast<U32>(_p[1]) << 16u) |
-                  (static_cast<U32>(_p[2]) << 8u) | static_cast<U32>(_p[3]);
-        _p += 4;
-        F32 v;
-        std::memcpy(&v, &raw, sizeof(v));
-        return v;
-    }
+    auto _readF32BE() -> F32 { return _readBE<F32>(); }
 
-    void _advance(U32 n) {
+    void _advance(size_t n) {
         _checkAvailable(n, "advance");
         _p += n;
     }
 
-    auto _readRawString(U32 len) -> std::string {
-        _checkAvailable(len, "readRawString");
-        std::string s(reinterpret_cast<const char*>(_p), len);
-        _p += len;
-        return s;
+    // Return the current position and skip n bytes.
+    auto _take(size_t n, const char* caller) -> const U8* {
+        _checkAvailable(n, caller);
+        const U8* ptr = _p;
+        _p += n;
+        return ptr;
+    }
+
+    auto _readBinHeader() -> U32 {
+        const U8 b = _readU8();
+        if (b == 0xc4)
+            return _readU8(); // bin8
+        if (b == 0xc5)
+            return _readU16BE(); // bin16
+        if (b == 0xc6)
+            return _readU32BE(); // bin32
+        THROW_MSG("MsgpackReader::readBin: unexpected byte 0x{:02x}.", b);
+    }
+
+    template <typename Func>
+    auto _readOptional(Func&& func) -> std::optional<decltype(func())> {
+        if (isNil()) {
+            _p++;
+            return std::nullopt;
+        }
+        return func();
+    }
+
+    template <typename S> auto _readScalar() -> S {
+        if constexpr (std::is_floating_point_v<S>) {
+            return static_cast<S>(readDouble());
+        } else {
+            return static_cast<S>(readInt());
+        }
     }
 
-    auto _readRawBytes(U32 len) -> std::vector<U8> {
-        _checkAvailable(len, "readRawBytes");
-        std::vector<U8> out(len);
-        std::memcpy(out.data(), _p, len);
-        _p += len;
-        return out;
+    // Decode a numeric array, with alloc(count) providing the destination.
+    template <typename T, typename Alloc>
+    auto _readTypedArray(Alloc&& alloc) -> size_t {
+        using Elem = msgpack::ArrayElement<T>;
+        using S = typename Elem::scalar_t;
+        constexpr size_t numComps = Elem::num_components;
+
+        const U8 b = _peekU8();
+        size_t len = 0;
+        if (_isExt(b)) {
+            I8 type = 0;
+            len = readExtHeader(type);
+            NVCHK(type == msgpack::array_ext_type<S>(),
+                  "MsgpackReader::readArrayInto: unexpected ext type {}.",
+                  type);
+        } else if (b >= 0xc4 && b <= 0xc6) {
+            len = _readBinHeader();
+        } else {
+            // Plain array of numbers:
+            const U32 num = readArraySize();
+            NVCHK(num % numComps == 0,
+                  "MsgpackReader::readArrayInto: invalid array size {}.",
+                  num);
+            const size_t count = num / numComps;
+            T* dst = alloc(count);
+            S* values = reinterpret_cast<S*>(dst);
+            for (U32 i = 0; i < num; ++i) {
+                values[i] = _readScalar<S>();
+            }
+            return count;
+        }
+
+        NVCHK(len % sizeof(T) == 0,
+              "MsgpackReader::readArrayInto: invalid payload size {}.", len);
+        const size_t count = len / sizeof(T);
+        const U8* src = _take(len, "readArrayInto");
+        T* dst = alloc(count);
+        msgpack::copy_swapped<S>(reinterpret_cast<U8*>(dst), src,
+                                 count * numComps);
+        return count;
     }
 };
 
-} // namespace nv
\ No newline at end of file
+} // namespace nv
@@ -0,0 +1,493 @@
+// File: nvk/io/MsgpackSchema.h
+// Compile-time msgpack (de)serialization of plain structs.
+//
+// A struct declares its serialized fields with NV_MSGPACK_FIELDS at namespace
+// scope (in the namespace of the struct):
+//
+//   struct RoadRib { Vec2d left; Vec2d right; F64 z; F64 u; };
+//   NV_MSGPACK_FIELDS(RoadRib, left, right, z, u)
+//
+// and is then written as a map keyed by the field names with
+// msgpack::write(writer, obj) and read back with msgpack::read(reader, obj).
+//
+// On decoding, keys are matched with a perfect hash of the field names
+// computed at compile time: one hash of the key bytes, one table lookup, one
+// key comparison and an indirect call to the field decoder. Unknown keys are
+// skipped and missing keys leave the fields untouched.
+//
+// Field values can be:
+//   bool, integers, enums, F32/F64, String
+//   packed vectors (Vec2/3/4): plain arrays of numbers
+//   Vector of numbers or packed vectors: typed arrays (see writeTypedArray)
+//   other Vectors: arrays of values
+//   std::optional: nil when empty
+//   structs with a schema: nested maps
+//
+// Vectors of a struct declared with NV_MSGPACK_COLUMNAR(Type) are written
+// in a columnar layout: a map of field name -> column, where the numeric
+// columns are written as typed arrays.
+
+#pragma once
+
+#include <nvk/io/MsgpackReader.h>
+#include <nvk/io/MsgpackWriter.h>
+
+#include <optional>
+#include <tuple>
+
+#define NV_MSGPACK_EXPAND(x) x
+#define NV_MSGPACK_CAT_(a, b) a##b
+#define NV_MSGPACK_CAT(a, b) NV_MSGPACK_CAT_(a, b)
+
+#define NV_MSGPACK_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+                          _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, \
+                          _23, _24, N, ...)                                   \
+    N
+#define NV_MSGPACK_NARGS(...)                                                 \
+    NV_MSGPACK_EXPAND(NV_MSGPACK_NARGS_(__VA_ARGS__, 24, 23, 22, 21, 20, 19,  \
+                                        18, 17, 16, 15, 14, 13, 12, 11, 10,  \
+                                        9, 8, 7, 6, 5, 4, 3, 2, 1))
+
+#define NV_MSGPACK_FIELD(T, f)                                                \
+    ::nv::msgpack::Field<T, decltype(T::f)> { #f, &T::f }
+
+// NV_MSGPACK_F<n>(T, fields...) expands to the n field descriptors:
+#define NV_MSGPACK_F1(T, f) NV_MSGPACK_FIELD(T, f)
+#define NV_MSGPACK_F2(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F1(T, __VA_ARGS__))
+#define NV_MSGPACK_F3(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F2(T, __VA_ARGS__))
+#define NV_MSGPACK_F4(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F3(T, __VA_ARGS__))
+#define NV_MSGPACK_F5(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F4(T, __VA_ARGS__))
+#define NV_MSGPACK_F6(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F5(T, __VA_ARGS__))
+#define NV_MSGPACK_F7(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F6(T, __VA_ARGS__))
+#define NV_MSGPACK_F8(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F7(T, __VA_ARGS__))
+#define NV_MSGPACK_F9(T, f, ...)                                              \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F8(T, __VA_ARGS__))
+#define NV_MSGPACK_F10(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F9(T, __VA_ARGS__))
+#define NV_MSGPACK_F11(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F10(T, __VA_ARGS__))
+#define NV_MSGPACK_F12(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F11(T, __VA_ARGS__))
+#define NV_MSGPACK_F13(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F12(T, __VA_ARGS__))
+#define NV_MSGPACK_F14(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F13(T, __VA_ARGS__))
+#define NV_MSGPACK_F15(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F14(T, __VA_ARGS__))
+#define NV_MSGPACK_F16(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F15(T, __VA_ARGS__))
+#define NV_MSGPACK_F17(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F16(T, __VA_ARGS__))
+#define NV_MSGPACK_F18(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F17(T, __VA_ARGS__))
+#define NV_MSGPACK_F19(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F18(T, __VA_ARGS__))
+#define NV_MSGPACK_F20(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F19(T, __VA_ARGS__))
+#define NV_MSGPACK_F21(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F20(T, __VA_ARGS__))
+#define NV_MSGPACK_F22(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F21(T, __VA_ARGS__))
+#define NV_MSGPACK_F23(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F22(T, __VA_ARGS__))
+#define NV_MSGPACK_F24(T, f, ...)                                             \
+    NV_MSGPACK_FIELD(T, f), NV_MSGPACK_EXPAND(NV_MSGPACK_F23(T, __VA_ARGS__))
+
+// Declare the serialized fields of a struct, up to 24 (found by ADL):
+#define NV_MSGPACK_FIELDS(Type, ...)                                          \
+    constexpr auto nv_msgpack_fields(const Type*) {                           \
+        return std::make_tuple(NV_MSGPACK_EXPAND(NV_MSGPACK_CAT(              \
+            NV_MSGPACK_F, NV_MSGPACK_NARGS(__VA_ARGS__))(Type, __VA_ARGS__))); \
+    }
+
+// Use the columnar layout for the Vectors of a struct with a schema:
+#define NV_MSGPACK_COLUMNAR(Type)                                             \
+    constexpr auto nv_msgpack_columnar(const Type*) -> bool { return true; }
+
+namespace nv {
+
+namespace msgpack {
+
+template <typename C, typename M> struct Field {
+    using value_t = M;
+    std::string_view name;
+    M C::*member;
+};
+
+// Seed and table mask of the perfect hash of a schema:
+struct PerfectHash {
+    U32 seed{0};
+    U32 mask{0};
+};
+
+// Max number of slots in a perfect hash table:
+static constexpr U32 kMaxHashTableSize = 4096;
+
+constexpr auto hash_key(std::string_view key, U32 seed) -> U32 {
+    // FNV-1a with a seeded basis and a final avalanche:
+    U32 h = 2166136261U ^ seed;
+    for (char c : key) {
+        h = (h ^ U8(c)) * 16777619U;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return h;
+}
+
+// Find the smallest table (starting at 2 slots per key) and a seed without
+// collisions between the keys.
+template <size_t N>
+constexpr auto find_perfect_hash(const std::array<std::string_view, N>& keys)
+    -> PerfectHash {
+    U32 size = 2;
+    while (size < 2 * N) {
+        size *= 2;
+    }
+    for (; size <= kMaxHashTableSize; size *= 2) {
+        for (U32 seed = 1; seed <= 512; ++seed) {
+            std::array<U32, N> slots{};
+            bool ok = true;
+            for (size_t i = 0; i < N && ok; ++i) {
+                slots[i] = hash_key(keys[i], seed) & (size - 1);
+                for (size_t j = 0; j < i; ++j) {
+                    if (slots[j] == slots[i]) {
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+            if (ok) {
+                return {seed, size - 1};
+            }
+        }
+    }
+    return {};
+}
+
+// ── Type traits ──────────────────────────────────────────────────────────────
+
+template <typename T, typename = void>
+struct has_schema : std::false_type {};
+
+template <typename T>
+struct has_schema<
+    T, std::void_t<decltype(nv_msgpack_fields(static_cast<const T*>(nullptr)))>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct is_columnar : std::false_type {};
+
+template <typename T>
+struct is_columnar<T, std::void_t<decltype(nv_msgpack_columnar(
+                          static_cast<const T*>(nullptr)))>>
+    : std::true_type {};
+
+// Numbers or tightly packed vectors of numbers (Vec2/3/4), which can be
+// written as typed arrays:
+template <typename T, typename = void>
+struct is_packed_vector : std::false_type {};
+
+template <typename T>
+struct is_packed_vector<T, std::void_t<typename T::value_t,
+                                       decltype(T::num_components)>>
+    : std::bool_constant<std::is_arithmetic_v<typename T::value_t> &&
+                         sizeof(T) == sizeof(typename T::value_t) *
+                                          T::num_components> {};
+
+template <typename T>
+inline constexpr bool is_bulk_element_v =
+    (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) ||
+    is_packed_vector<T>::value;
+
+template <typename T> struct is_optional : std::false_type {};
+template <typename U> struct is_optional<std::optional<U>> : std::true_type {};
+
+// ── Schema ───────────────────────────────────────────────────────────────────
+
+template <typename T> struct Codec;
+
+template <typename T> struct Schema {
+    static constexpr auto fields =
+        nv_msgpack_fields(static_cast<const T*>(nullptr));
+    static constexpr size_t num_fields =
+        std::tuple_size_v<std::decay_t<decltype(fields)>>;
+    static_assert(num_fields > 0 && num_fields < 255,
+                  "Invalid number of msgpack fields");
+
+    static constexpr auto keys = std::apply(
+        [](const auto&... f) {
+            return std::array<std::string_view, num_fields>{f.name...};
+        },
+        fields);
+
+    static constexpr PerfectHash hash = find_perfect_hash(keys);
+    static_assert(hash.mask != 0,
+                  "No perfect hash found for the msgpack keys (duplicates?)");
+
+    // Hash slot -> field index + 1 (0 for empty slots):
+    static constexpr auto table = [] {
+        std::array<U8, hash.mask + 1> res{};
+        for (size_t i = 0; i < num_fields; ++i) {
+            res[hash_key(keys[i], hash.seed) & hash.mask] = U8(i + 1);
+        }
+        return res;
+    }();
+
+    // Index of the field with the given key, or -1.
+    static auto find(std::string_view key) -> I32 {
+        const I32 idx = I32(table[hash_key(key, hash.seed) & hash.mask]) - 1;
+        return idx >= 0 && keys[idx] == key ? idx : -1;
+    }
+
+    using RowDecoder = void (*)(MsgpackReader&, T&);
+    using ColumnDecoder = void (*)(MsgpackReader&, Vector<T>&, bool);
+
+    template <size_t... I>
+    static constexpr auto make_row_decoders(std::index_sequence<I...>) {
+        return std::array<RowDecoder, num_fields>{
+            [](MsgpackReader& rdr, T& obj) {
+                auto& value = obj.*(std::get<I>(fields).member);
+                Codec<std::decay_t<decltype(value)>>::read(rdr, value);
+            }...};
+    }
+
+    template <size_t... I>
+    static constexpr auto make_column_decoders(std::index_sequence<I...>) {
+        return std::array<ColumnDecoder, num_fields>{
+            [](MsgpackReader& rdr, Vector<T>& rows, bool first) {
+                constexpr auto member = std::get<I>(fields).member;
+                using M = typename std::decay_t<
+                    decltype(std::get<I>(fields))>::value_t;
+                Vector<M> column;
+                Codec<Vector<M>>::read(rdr, column);
+                if (first) {
+                    rows.resize(column.size());
+                }
+                NVCHK(column.size() == rows.size(),
+                      "msgpack: column {} has {} values, expected {}.",
+                      std::get<I>(fields).name, column.size(), rows.size());
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    rows[i].*member = std::move(column[i]);
+                }
+            }...};
+    }
+
+    static constexpr auto rowDecoders =
+        make_row_decoders(std::make_index_sequence<num_fields>{});
+
+    static void write(MsgpackWriter& wrt, const T& obj) {
+        wrt.writeMapHeader(U32(num_fields));
+        std::apply(
+            [&](const auto&... f) {
+                ((wrt.writeStr(f.name),
+                  Codec<typename std::decay_t<decltype(f)>::value_t>::write(
+                      wrt, obj.*(f.member))),
+                 ...);
+            },
+            fields);
+    }
+
+    static void read(MsgpackReader& rdr, T& obj) {
+        const U32 num = rdr.readMapSize();
+        for (U32 i = 0; i < num; ++i) {
+            const I32 idx = find(rdr.readStringView());
+            if (idx < 0) {
+                rdr.skipValue();
+            } else {
+                rowDecoders[idx](rdr, obj);
+            }
+        }
+    }
+
+    static void write_columns(MsgpackWriter& wrt, const Vector<T>& rows) {
+        wrt.writeMapHeader(U32(num_fields));
+        std::apply(
+            [&](const auto&... f) {
+                (write_column(wrt, rows, f), ...);
+            },
+            fields);
+    }
+
+    static void read_columns(MsgpackReader& rdr, Vector<T>& rows) {
+        // Local so that it's only instantiated for the columnar types:
+        static constexpr auto columnDecoders =
+            make_column_decoders(std::make_index_sequence<num_fields>{});
+
+        rows.clear();
+        bool first = true;
+        const U32 num = rdr.readMapSize();
+        for (U32 i = 0; i < num; ++i) {
+            const I32 idx = find(rdr.readStringView());
+            if (idx < 0) {
+                rdr.skipValue();
+            } else {
+                columnDecoders[idx](rdr, rows, first);
+                first = false;
+            }
+        }
+    }
+
+  private:
+    template <typename F>
+    static void write_column(MsgpackWriter& wrt, const Vector<T>& rows,
+                             const F& field) {
+        using M = typename F::value_t;
+        wrt.writeStr(field.name);
+        if constexpr (is_bulk_element_v<M>) {
+            // Gather the column for a single typed array write:
+            Vector<M> column(rows.size());
+            for (size_t i = 0; i < rows.size(); ++i) {
+                column[i] = rows[i].*(field.member);
+            }
+            wrt.writeTypedArray(column);
+        } else {
+            wrt.writeArrayHeader(U32(rows.size()));
+            for (const auto& row : rows) {
+                Codec<M>::write(wrt, row.*(field.member));
+            }
+        }
+    }
+};
+
+// ── Value codecs ─────────────────────────────────────────────────────────────
+
+template <typename T> struct Codec {
+    static void write(MsgpackWriter& wrt, const T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            wrt.writeBool(value);
+        } else if constexpr (std::is_enum_v<T>) {
+            wrt.writeInt(I64(value));
+        } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            wrt.writeInt(value);
+        } else if constexpr (std::is_integral_v<T>) {
+            wrt.writeUInt(value);
+        } else if constexpr (std::is_same_v<T, F32>) {
+            wrt.writeFloat32(value);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            wrt.writeFloat64(F64(value));
+        } else if constexpr (std::is_convertible_v<const T&,
+                                                   std::string_view>) {
+            wrt.writeStr(value);
+        } else if constexpr (has_schema<T>::value) {
+            Schema<T>::write(wrt, value);
+        } else if constexpr (is_packed_vector<T>::value) {
+            using S = typename T::value_t;
+            const S* comps = reinterpret_cast<const S*>(&value);
+            wrt.writeArrayHeader(T::num_components);
+            for (size_t i = 0; i < T::num_components; ++i) {
+                Codec<S>::write(wrt, comps[i]);
+            }
+        } else {
+            static_assert(sizeof(T) == 0, "Unsupported msgpack field type");
+        }
+    }
+
+    static void read(MsgpackReader& rdr, T& value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            value = rdr.readBool();
+        } else if constexpr (std::is_enum_v<T> || std::is_integral_v<T>) {
+            value = T(rdr.readInt());
+        } else if constexpr (std::is_same_v<T, F32>) {
+            value = rdr.readFloat();
+        } else if constexpr (std::is_floating_point_v<T>) {
+            value = T(rdr.readDouble());
+        } else if constexpr (std::is_same_v<T, String>) {
+            value = rdr.readString();
+        } else if constexpr (has_schema<T>::value) {
+            Schema<T>::read(rdr, value);
+        } else if constexpr (is_packed_vector<T>::value) {
+            const size_t num = rdr.readArrayInto(std::span<T>(&value, 1));
+            NVCHK(num == 1, "msgpack: invalid vector value.");
+        } else {
+            static_assert(sizeof(T) == 0, "Unsupported msgpack field type");
+        }
+    }
+};
+
+template <typename U> struct Codec<std::optional<U>> {
+    static void write(MsgpackWriter& wrt, const std::optional<U>& value) {
+        if (value.has_value()) {
+            Codec<U>::write(wrt, *value);
+        } else {
+            wrt.writeNil();
+        }
+    }
+
+    static void read(MsgpackReader& rdr, std::optional<U>& value) {
+        if (rdr.isNil()) {
+            rdr.readNil();
+            value.reset();
+        } else {
+            Codec<U>::read(rdr, value.emplace());
+        }
+    }
+};
+
+template <typename U> struct Codec<Vector<U>> {
+    static void write(MsgpackWriter& wrt, const Vector<U>& values) {
+        if constexpr (is_bulk_element_v<U>) {
+            wrt.writeTypedArray(values);
+        } else if constexpr (is_columnar<U>::value) {
+            Schema<U>::write_columns(wrt, values);
+        } else {
+            wrt.writeArrayHeader(U32(values.size()));
+            for (const auto& val : values) {
+                Codec<U>::write(wrt, val);
+            }
+        }
+    }
+
+    static void read(MsgpackReader& rdr, Vector<U>& values) {
+        if constexpr (is_bulk_element_v<U>) {
+            rdr.readArrayInto(values);
+        } else if constexpr (is_columnar<U>::value) {
+            Schema<U>::read_columns(rdr, values);
+        } else {
+            values.resize(rdr.readArraySize());
+            for (size_t i = 0; i < values.size(); ++i) {
+                // Through a temporary for the Vector<bool> proxies:
+                U val{};
+                Codec<U>::read(rdr, val);
+                values[i] = std::move(val);
+            }
+        }
+    }
+};
+
+// ── Entry points ─────────────────────────────────────────────────────────────
+
+template <typename T> void write(MsgpackWriter& wrt, const T& value) {
+    Codec<T>::write(wrt, value);
+}
+
+template <typename T> void read(MsgpackReader& rdr, T& value) {
+    Codec<T>::read(rdr, value);
+}
+
+template <typename T> auto read(MsgpackReader& rdr) -> T {
+    T value{};
+    Codec<T>::read(rdr, value);
+    return value;
+}
+
+// Explicit columnar write/read of a Vector of structs with a schema:
+template <typename T>
+void write_columns(MsgpackWriter& wrt, const Vector<T>& rows) {
+    Schema<T>::write_columns(wrt, rows);
+}
+
+template <typename T> void read_columns(MsgpackReader& rdr, Vector<T>& rows) {
+    Schema<T>::read_columns(rdr, rows);
+}
+
+} // namespace msgpack
+
+} // namespace nv
@@ -0,0 +1,136 @@
+
+#include <nvk/io/MsgpackSink.h>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define NV_WRITE_FD _write
+#define NV_OPEN_FD _open
+#define NV_CLOSE_FD _close
+#define NV_OPEN_FLAGS (_O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY)
+#define NV_OPEN_MODE (_S_IREAD | _S_IWRITE)
+#else
+#include <unistd.h>
+#define NV_WRITE_FD ::write
+#define NV_OPEN_FD ::open
+#define NV_CLOSE_FD ::close
+#define NV_OPEN_FLAGS (O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC)
+#define NV_OPEN_MODE 0644
+#endif
+
+namespace nv {
+
+// Size of the compressed output chunks passed to the next sink:
+static constexpr size_t kZlibChunkSize = 64 * 1024;
+
+MsgpackFileSink::MsgpackFileSink(const String& filename)
+    : _filename(filename), _ownFd(true) {
+    _fd = NV_OPEN_FD(filename.c_str(), NV_OPEN_FLAGS, NV_OPEN_MODE);
+    NVCHK(_fd >= 0, "Cannot open file {} for writing", filename);
+}
+
+MsgpackFileSink::MsgpackFileSink(int fd, bool ownFd) : _fd(fd), _ownFd(ownFd) {
+    NVCHK(_fd >= 0, "Invalid file descriptor for MsgpackFileSink");
+}
+
+MsgpackFileSink::~MsgpackFileSink() {
+    if (_ownFd && _fd >= 0) {
+        NV_CLOSE_FD(_fd);
+    }
+}
+
+void MsgpackFileSink::write(const U8* data, size_t size) {
+    while (size > 0) {
+        // Chunked to stay below the 32-bit size limit of _write():
+        auto chunk = (U32)minimum(size, (size_t)(1U << 30));
+        auto res = NV_WRITE_FD(_fd, data, chunk);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        NVCHK(res > 0, "MsgpackFileSink: write failed on {} (errno={})",
+              _filename.empty() ? fmt::format("fd {}", _fd) : _filename,
+              errno);
+        data += res;
+        size -= res;
+    }
+}
+
+MsgpackZlibSink::MsgpackZlibSink(MsgpackSink& next, I32 level, bool gzip)
+    : _next(next), _outBuffer(kZlibChunkSize) {
+    auto* zs = new z_stream{};
+    // 16 + MAX_WBITS selects the gzip wrapper:
+    int windowBits = gzip ? 16 + MAX_WBITS : MAX_WBITS;
+    if (deflateInit2(zs, level, Z_DEFLATED, windowBits, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        delete zs;
+        THROW_MSG("zlib initialization failed");
+    }
+    _zstream = zs;
+}
+
+MsgpackZlibSink::~MsgpackZlibSink() {
+    // Not finishing the stream here: this would throw in a destructor on
+    // errors, so finish() must be called explicitly.
+    auto* zs = (z_stream*)_zstream;
+    deflateEnd(zs);
+    delete zs;
+}
+
+void MsgpackZlibSink::deflate_input(const U8* data, size_t size, int mode) {
+    NVCHK(!_finished, "MsgpackZlibSink: stream already finished");
+    auto* zs = (z_stream*)_zstream;
+    zs->next_in = (Bytef*)data;
+    zs->avail_in = (uInt)size;
+
+    while (true) {
+        zs->next_out = _outBuffer.data();
+        zs->avail_out = (uInt)_outBuffer.size();
+        int ret = deflate(zs, mode);
+        NVCHK(ret != Z_STREAM_ERROR, "MsgpackZlibSink: deflate failed");
+
+        size_t produced = _outBuffer.size() - zs->avail_out;
+        if (produced > 0) {
+            _next.write(_outBuffer.data(), produced);
+        }
+
+        if (mode == Z_FINISH) {
+            if (ret == Z_STREAM_END) {
+                break;
+            }
+        } else if (zs->avail_out != 0) {
+            // All the input consumed and the output fully flushed:
+            break;
+        }
+    }
+}
+
+void MsgpackZlibSink::write(const U8* data, size_t size) {
+    // avail_in is 32 bits:
+    while (size > 0) {
+        size_t chunk = minimum(size, (size_t)(1U << 30));
+        deflate_input(data, chunk, Z_NO_FLUSH);
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+void MsgpackZlibSink::flush() {
+    if (!_finished) {
+        deflate_input(nullptr, 0, Z_SYNC_FLUSH);
+    }
+    _next.flush();
+}
+
+void MsgpackZlibSink::finish() {
+    if (_finished) {
+        return;
+    }
+    deflate_input(nullptr, 0, Z_FINISH);
+    _finished = true;
+    _next.flush();
+}
+
+} // namespace nv
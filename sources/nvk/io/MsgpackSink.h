@@ -0,0 +1,96 @@
+// File: nvk/io/MsgpackSink.h
+// Output destinations for MsgpackWriter: the writer buffers the encoded data
+// and hands it over to its sink in large blocks.
+
+#pragma once
+
+#include <nvk_common.h>
+#include <nvk_types.h>
+
+namespace nv {
+
+class MsgpackSink {
+  public:
+    virtual ~MsgpackSink() = default;
+
+    // Consume a block of encoded data.
+    virtual void write(const U8* data, size_t size) = 0;
+
+    // Push any data kept by the sink itself to its destination.
+    virtual void flush() {}
+};
+
+// Appends the data to a byte vector.
+class MsgpackMemorySink : public MsgpackSink {
+  public:
+    MsgpackMemorySink() : _out(&_own) {}
+    explicit MsgpackMemorySink(U8Vector& out) : _out(&out) {}
+
+    void write(const U8* data, size_t size) override {
+        _out->insert(_out->end(), data, data + size);
+    }
+
+    [[nodiscard]] auto data() const -> const U8Vector& { return *_out; }
+    auto take() -> U8Vector { return std::move(*_out); }
+
+  private:
+    U8Vector _own;
+    U8Vector* _out;
+};
+
+// Writes the data to a file descriptor (owned or not).
+class MsgpackFileSink : public MsgpackSink {
+    NV_DECLARE_NO_COPY(MsgpackFileSink)
+    NV_DECLARE_NO_MOVE(MsgpackFileSink)
+
+  public:
+    // Create (or truncate) a file.
+    explicit MsgpackFileSink(const String& filename);
+
+    // Write to an already opened descriptor.
+    explicit MsgpackFileSink(int fd, bool ownFd = false);
+
+    ~MsgpackFileSink() override;
+
+    void write(const U8* data, size_t size) override;
+
+    [[nodiscard]] auto get_fd() const -> int { return _fd; }
+
+  private:
+    String _filename;
+    int _fd{-1};
+    bool _ownFd{false};
+};
+
+// Compresses the data with zlib before passing it to another sink. finish()
+// must be called once all the data was written.
+class MsgpackZlibSink : public MsgpackSink {
+    NV_DECLARE_NO_COPY(MsgpackZlibSink)
+    NV_DECLARE_NO_MOVE(MsgpackZlibSink)
+
+  public:
+    // With gzip=true the output uses the gzip format (readable with zcat),
+    // otherwise the zlib format.
+    explicit MsgpackZlibSink(MsgpackSink& next, I32 level = 6,
+                             bool gzip = false);
+
+    ~MsgpackZlibSink() override;
+
+    void write(const U8* data, size_t size) override;
+
+    // Sync flush of the compressed stream, then flush of the next sink.
+    void flush() override;
+
+    // Write the end of the compressed stream.
+    void finish();
+
+  private:
+    void deflate_input(const U8* data, size_t size, int mode);
+
+    MsgpackSink& _next;
+    void* _zstream{nullptr};
+    U8Vector _outBuffer;
+    bool _finished{false};
+};
+
+} // namespace nv
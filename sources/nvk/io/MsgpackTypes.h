@@ -0,0 +1,164 @@
+// File: nvk/io/MsgpackTypes.h
+// Definitions shared by MsgpackWriter and MsgpackReader: extension type codes
+// and big-endian load/store/byte-swap helpers.
+
+#pragma once
+
+#include <nvk_common.h>
+#include <nvk_types.h>
+
+#include <bit>
+#include <span>
+
+namespace nv {
+
+// Extension types:
+// -1 is the timestamp type reserved by the msgpack spec. The typed array
+// types hold a flat array of big-endian scalars (eg. Vec3f arrays are stored
+// as F32 arrays of 3*n elements).
+enum MsgpackExtType : I8 {
+    MSGPACK_EXT_TIMESTAMP = -1,
+    MSGPACK_EXT_I8_ARRAY = 16,
+    MSGPACK_EXT_U8_ARRAY = 17,
+    MSGPACK_EXT_I16_ARRAY = 18,
+    MSGPACK_EXT_U16_ARRAY = 19,
+    MSGPACK_EXT_I32_ARRAY = 20,
+    MSGPACK_EXT_U32_ARRAY = 21,
+    MSGPACK_EXT_I64_ARRAY = 22,
+    MSGPACK_EXT_U64_ARRAY = 23,
+    MSGPACK_EXT_F32_ARRAY = 24,
+    MSGPACK_EXT_F64_ARRAY = 25,
+};
+
+// How the bulk typed arrays are written: as an extension value carrying the
+// element type, or as a plain bin payload of big-endian elements.
+enum MsgpackArrayFormat : U8 {
+    MSGPACK_ARRAY_EXT,
+    MSGPACK_ARRAY_BIN,
+};
+
+// Decoded extension value, pointing into the source buffer.
+struct MsgpackExt {
+    I8 type{0};
+    std::span<const U8> data;
+};
+
+// Value of the timestamp extension type.
+struct MsgpackTimestamp {
+    I64 seconds{0};
+    U32 nanoseconds{0};
+};
+
+namespace msgpack {
+
+// Scalar type of a bulk array element: T itself for numbers, or the
+// component type of vectors such as Vec3f (with T::num_components values).
+template <typename T, typename = void> struct ArrayElement {
+    using scalar_t = T;
+    static constexpr size_t num_components = 1;
+};
+
+template <typename T>
+struct ArrayElement<T, std::void_t<typename T::value_t>> {
+    using scalar_t = typename T::value_t;
+    static constexpr size_t num_components = T::num_components;
+    static_assert(sizeof(T) == sizeof(scalar_t) * num_components,
+                  "Vector types must be tightly packed");
+};
+
+template <typename S> constexpr auto array_ext_type() -> MsgpackExtType {
+    if constexpr (std::is_same_v<S, I8>) {
+        return MSGPACK_EXT_I8_ARRAY;
+    } else if constexpr (std::is_same_v<S, U8>) {
+        return MSGPACK_EXT_U8_ARRAY;
+    } else if constexpr (std::is_same_v<S, I16>) {
+        return MSGPACK_EXT_I16_ARRAY;
+    } else if constexpr (std::is_same_v<S, U16>) {
+        return MSGPACK_EXT_U16_ARRAY;
+    } else if constexpr (std::is_same_v<S, I32>) {
+        return MSGPACK_EXT_I32_ARRAY;
+    } else if constexpr (std::is_same_v<S, U32>) {
+        return MSGPACK_EXT_U32_ARRAY;
+    } else if constexpr (std::is_same_v<S, I64>) {
+        return MSGPACK_EXT_I64_ARRAY;
+    } else if constexpr (std::is_same_v<S, U64>) {
+        return MSGPACK_EXT_U64_ARRAY;
+    } else if constexpr (std::is_same_v<S, F32>) {
+        return MSGPACK_EXT_F32_ARRAY;
+    } else {
+        static_assert(std::is_same_v<S, F64>, "Unsupported array type");
+        return MSGPACK_EXT_F64_ARRAY;
+    }
+}
+
+template <typename U> inline auto bswap(U v) -> U {
+    if constexpr (sizeof(U) == 1) {
+        return v;
+    } else if constexpr (sizeof(U) == 2) {
+        return U((v >> 8) | (v << 8));
+    } else if constexpr (sizeof(U) == 4) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return _byteswap_ulong(v);
+#else
+        return __builtin_bswap32(v);
+#endif
+    } else {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return _byteswap_uint64(v);
+#else
+        return __builtin_bswap64(v);
+#endif
+    }
+}
+
+// Unsigned integer type with the same size as T:
+template <typename T>
+using uint_for = std::conditional_t<
+    sizeof(T) == 1, U8,
+    std::conditional_t<sizeof(T) == 2, U16,
+                       std::conditional_t<sizeof(T) == 4, U32, U64>>>;
+
+// Store/load a value in big-endian order with a single word access.
+template <typename T> inline void store_be(U8* dst, T value) {
+    using UT = uint_for<T>;
+    UT bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    if constexpr (std::endian::native == std::endian::little) {
+        bits = bswap(bits);
+    }
+    std::memcpy(dst, &bits, sizeof(T));
+}
+
+template <typename T> inline auto load_be(const U8* src) -> T {
+    using UT = uint_for<T>;
+    UT bits;
+    std::memcpy(&bits, src, sizeof(T));
+    if constexpr (std::endian::native == std::endian::little) {
+        bits = bswap(bits);
+    }
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+// Copy count scalars converting between native and big-endian order (the
+// conversion is symmetric). This loop is vectorized by the compilers.
+template <typename T>
+inline void copy_swapped(U8* dst, const U8* src, size_t count) {
+    if constexpr (sizeof(T) == 1 ||
+                  std::endian::native == std::endian::big) {
+        std::memcpy(dst, src, count * sizeof(T));
+    } else {
+        using UT = uint_for<T>;
+        for (size_t i = 0; i < count; ++i) {
+            UT bits;
+            std::memcpy(&bits, src + i * sizeof(T), sizeof(T));
+            bits = bswap(bits);
+            std::memcpy(dst + i * sizeof(T), &bits, sizeof(T));
+        }
+    }
+}
+
+} // namespace msgpack
+
+} // namespace nv
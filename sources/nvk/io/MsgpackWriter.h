@@ -1,131 +1,317 @@
 
 #pragma once
 
-#include <nvk_common.h>
-#include <nvk_types.h>
+#include <nvk/io/MsgpackSink.h>
+#include <nvk/io/MsgpackTypes.h>
+
+// Default size of the staging buffer of a MsgpackWriter emitting into a sink:
+#ifndef NV_MSGPACK_SINK_BUFFER_SIZE
+#define NV_MSGPACK_SINK_BUFFER_SIZE (64 * 1024)
+#endif
 
 namespace nv {
 // ---------------------------------------------------------------------------
 // MsgpackWriter — minimal hand-rolled msgpack serialiser.
 // Produces the subset used by building_placer.py: map, array, str, bin,
-// int (positive fixint / uint32), float32.
+// int, float32/64, bool, nil and ext, plus bulk typed arrays.
+//
+// By default the data is accumulated in memory (retrieved with take()).
+// When constructed with a sink, the data is staged in a fixed buffer which
+// is handed over to the sink when full: flush() must be called at the end
+// (the destructor doesn't flush since the sink may throw). Payloads larger
+// than half the buffer are passed to the sink directly.
 // ---------------------------------------------------------------------------
 class MsgpackWriter {
   public:
-    auto take() -> U8Vector { return std::move(_buf); }
-    [[nodiscard]] auto data() const -> const U8Vector& { return _buf; }
+    MsgpackWriter() = default;
+
+    explicit MsgpackWriter(MsgpackSink* sink,
+                           size_t bufferSize = NV_MSGPACK_SINK_BUFFER_SIZE)
+        : _sink(sink), _buf(maximum(bufferSize, (size_t)64)) {
+        NVCHK(_sink != nullptr, "MsgpackWriter: invalid sink.");
+    }
+
+    // In memory mode only:
+    auto take() -> U8Vector {
+        NVCHK(_sink == nullptr, "MsgpackWriter::take: writer has a sink.");
+        _buf.resize(_size);
+        _size = 0;
+        return std::move(_buf);
+    }
+    [[nodiscard]] auto data() const -> std::span<const U8> {
+        return {_buf.data(), _size};
+    }
+
+    // Total number of bytes written so far:
+    [[nodiscard]] auto size() const -> size_t { return _flushed + _size; }
+
+    // Pass the staged data to the sink and flush it.
+    void flush() {
+        if (_sink != nullptr) {
+            _flushBuffer();
+            _sink->flush();
+        }
+    }
 
     void writeMapHeader(U32 n) {
         if (n <= 15) {
-            _buf.push_back(0x80U | U8(n));
+            _writeU8(0x80U | U8(n));
         } else if (n <= 0xffffU) {
-            _buf.push_back(0xde);
-            _writeU16BE(U16(n));
+            _writeTagged(0xde, U16(n));
         } else {
-            _buf.push_back(0xdf);
-            _writeU32BE(n);
+            _writeTagged(0xdf, n);
         }
     }
 
     void writeArrayHeader(U32 n) {
         if (n <= 15) {
-            _buf.push_back(0x90U | U8(n));
+            _writeU8(0x90U | U8(n));
         } else if (n <= 0xffffU) {
-            _buf.push_back(0xdc);
-            _writeU16BE(U16(n));
+            _writeTagged(0xdc, U16(n));
         } else {
-            _buf.push_back(0xdd);
-            _writeU32BE(n);
+            _writeTagged(0xdd, n);
         }
     }
 
-    void writeStr(const std::string& s) {
-        U32 len = U32(s.size());
+    void writeStr(std::string_view s) {
+        size_t len = s.size();
         if (len <= 31) {
-            _buf.push_back(0xa0U | U8(len));
+            _writeU8(0xa0U | U8(len));
         } else if (len <= 0xffU) {
-            _buf.push_back(0xd9);
-            _buf.push_back(U8(len));
+            _writeTagged(0xd9, U8(len));
+        } else if (len <= 0xffffU) {
+            _writeTagged(0xda, U16(len));
         } else {
-            _buf.push_back(0xda);
-            _writeU16BE(U16(len));
+            _writeTagged(0xdb, _checkedLen(len));
         }
-        _buf.insert(_buf.end(), s.begin(), s.end());
+        _writeBytes((const U8*)s.data(), len);
     }
 
-    void writeBin(const U8Vector& b) {
-        U32 len = U32(b.size());
-        if (len <= 0xffU) {
-            _buf.push_back(0xc4);
-            _buf.push_back(U8(len));
-        } else if (len <= 0xffffU) {
-            _buf.push_back(0xc5);
-            _writeU16BE(U16(len));
+    void writeBin(const U8* data, size_t len) {
+        _writeBinHeader(len);
+        _writeBytes(data, len);
+    }
+
+    void writeBin(const U8Vector& b) { writeBin(b.data(), b.size()); }
+
+    // Writes the smallest encoding of an integer.
+    void writeInt(I64 v) {
+        if (v >= 0) {
+            writeUInt(U64(v));
+        } else if (v >= -32) {
+            _writeU8(U8(v));
+        } else if (v >= INT8_MIN) {
+            _writeTagged(0xd0, U8(v));
+        } else if (v >= INT16_MIN) {
+            _writeTagged(0xd1, U16(v));
+        } else if (v >= INT32_MIN) {
+            _writeTagged(0xd2, U32(v));
         } else {
-            _buf.push_back(0xc6);
-            _writeU32BE(len);
+            _writeTagged(0xd3, U64(v));
         }
-        _buf.insert(_buf.end(), b.begin(), b.end());
     }
 
-    void writeInt(I64 v) {
-        if (v >= 0 && v <= 127) {
-            _buf.push_back(U8(v));
-        } else if (v >= 0 && v <= 0xffffU) {
-            _buf.push_back(0xcd);
-            _writeU16BE(U16(v));
-        } else if (v >= 0) {
-            _buf.push_back(0xce);
-            _writeU32BE(U32(v));
+    void writeUInt(U64 v) {
+        if (v <= 127) {
+            _writeU8(U8(v));
+        } else if (v <= 0xffU) {
+            _writeTagged(0xcc, U8(v));
+        } else if (v <= 0xffffU) {
+            _writeTagged(0xcd, U16(v));
+        } else if (v <= 0xffffffffU) {
+            _writeTagged(0xce, U32(v));
         } else {
-            // negative — use int32
-            _buf.push_back(0xd2);
-            _writeU32BE(U32(I32(v)));
+            _writeTagged(0xcf, v);
         }
     }
 
     // Writes a float32 as msgpack float32 (0xca).
     // Note: origin_x/origin_y are stored as float32 bytes in the Python writer.
-    void writeFloat32(F32 v) {
-        _buf.push_back(0xca);
-        U32 bits = 0;
-        std::memcpy(&bits, &v, 4);
-        _writeU32BE(bits);
+    void writeFloat32(F32 v) { _writeTagged(0xca, v); }
+
+    void writeFloat64(F64 v) { _writeTagged(0xcb, v); }
+
+    // Writes a boolean as msgpack bool (0xc2 = false, 0xc3 = true).
+    void writeBool(bool v) { _writeU8(v ? 0xc3U : 0xc2U); }
+
+    void writeNil() { _writeU8(0xc0); }
+
+    void writeExtHeader(I8 type, size_t len) {
+        switch (len) {
+        case 1:
+            _writeU8(0xd4);
+            break;
+        case 2:
+            _writeU8(0xd5);
+            break;
+        case 4:
+            _writeU8(0xd6);
+            break;
+        case 8:
+            _writeU8(0xd7);
+            break;
+        case 16:
+            _writeU8(0xd8);
+            break;
+        default:
+            if (len <= 0xffU) {
+                _writeTagged(0xc7, U8(len));
+            } else if (len <= 0xffffU) {
+                _writeTagged(0xc8, U16(len));
+            } else {
+                _writeTagged(0xc9, _checkedLen(len));
+            }
+        }
+        _writeU8(U8(type));
     }
 
-    void writeFloat64(F64 v) {
-        _buf.push_back(0xcb);
-        U64 bits = 0;
-        std::memcpy(&bits, &v, 8);
-        _writeU64BE(bits);
+    void writeExt(I8 type, const U8* data, size_t len) {
+        writeExtHeader(type, len);
+        _writeBytes(data, len);
     }
 
-    // Writes a boolean as msgpack bool (0xc2 = false, 0xc3 = true).
-    void writeBool(bool v) { _buf.push_back(v ? 0xc3U : 0xc2U); }
+    // Writes a timestamp ext value, in the smallest of its 3 formats.
+    void writeTimestamp(const MsgpackTimestamp& ts) {
+        if (ts.seconds >= 0 && (ts.seconds >> 34) == 0) {
+            if (ts.nanoseconds == 0 && ts.seconds <= 0xffffffffLL) {
+                writeExtHeader(MSGPACK_EXT_TIMESTAMP, 4);
+                msgpack::store_be(_claim(4), U32(ts.seconds));
+            } else {
+                writeExtHeader(MSGPACK_EXT_TIMESTAMP, 8);
+                msgpack::store_be(_claim(8), (U64(ts.nanoseconds) << 34) |
+                                                 U64(ts.seconds));
+            }
+        } else {
+            writeExtHeader(MSGPACK_EXT_TIMESTAMP, 12);
+            U8* ptr = _claim(12);
+            msgpack::store_be(ptr, ts.nanoseconds);
+            msgpack::store_be(ptr + 4, ts.seconds);
+        }
+    }
+
+    // Bulk typed arrays: count contiguous numbers (I8..U64, F32, F64) or
+    // vectors of numbers (eg. Vec3f, flattened to 3*count numbers), stored
+    // in big-endian order either as an extension value identifying the
+    // scalar type (see MsgpackExtType), or as a plain bin value.
+    template <typename T>
+    void writeTypedArray(const T* values, size_t count,
+                         MsgpackArrayFormat format = MSGPACK_ARRAY_EXT) {
+        using Elem = msgpack::ArrayElement<T>;
+        using S = typename Elem::scalar_t;
+        size_t num = count * Elem::num_components;
+        size_t len = num * sizeof(S);
+
+        if (format == MSGPACK_ARRAY_EXT) {
+            writeExtHeader(msgpack::array_ext_type<S>(), len);
+        } else {
+            _writeBinHeader(len);
+        }
+        _writeSwapped<S>((const U8*)values, num);
+    }
+
+    template <typename T>
+    void writeTypedArray(const Vector<T>& values,
+                         MsgpackArrayFormat format = MSGPACK_ARRAY_EXT) {
+        writeTypedArray(values.data(), values.size(), format);
+    }
 
   private:
+    MsgpackSink* _sink{nullptr};
     U8Vector _buf;
+    // Number of bytes used in _buf:
+    size_t _size{0};
+    // Number of bytes already passed to the sink:
+    size_t _flushed{0};
+
+    static auto _checkedLen(size_t len) -> U32 {
+        NVCHK(len <= 0xffffffffU, "MsgpackWriter: value too large ({} bytes).",
+              len);
+        return U32(len);
+    }
+
+    // Make room for n bytes in _buf and return the write position.
+    auto _claim(size_t n) -> U8* {
+        if (_size + n > _buf.size()) {
+            _makeRoom(n);
+        }
+        U8* ptr = _buf.data() + _size;
+        _size += n;
+        return ptr;
+    }
+
+    void _makeRoom(size_t n) {
+        if (_sink != nullptr) {
+            _flushBuffer();
+            if (n > _buf.size()) {
+                _buf.resize(n);
+            }
+        } else {
+            _buf.resize(maximum(maximum(_buf.size() * 2, _size + n),
+                                (size_t)256));
+        }
+    }
+
+    void _flushBuffer() {
+        if (_size > 0) {
+            _sink->write(_buf.data(), _size);
+            _flushed += _size;
+            _size = 0;
+        }
+    }
+
+    void _writeU8(U8 v) { *_claim(1) = v; }
 
-    void _writeU16BE(U16 v) {
-        _buf.push_back(U8(v >> 8));
-        _buf.push_back(U8(v));
-    }
-    void _writeU32BE(U32 v) {
-        _buf.push_back(U8(v >> 24));
-        _buf.push_back(U8(v >> 16));
-        _buf.push_back(U8(v >> 8));
-        _buf.push_back(U8(v));
-    }
-    void _writeU64BE(U64 v) {
-        _buf.push_back(U8(v >> 56));
-        _buf.push_back(U8(v >> 48));
-        _buf.push_back(U8(v >> 40));
-        _buf.push_back(U8(v >> 32));
-        _buf.push_back(U8(v >> 24));
-        _buf.push_back(U8(v >> 16));
-        _buf.push_back(U8(v >> 8));
-        _buf.push_back(U8(v));
+    // Type byte followed by a big-endian value, in a single reservation.
+    template <typename T> void _writeTagged(U8 tag, T v) {
+        U8* ptr = _claim(1 + sizeof(T));
+        ptr[0] = tag;
+        msgpack::store_be(ptr + 1, v);
+    }
+
+    void _writeBinHeader(size_t len) {
+        if (len <= 0xffU) {
+            _writeTagged(0xc4, U8(len));
+        } else if (len <= 0xffffU) {
+            _writeTagged(0xc5, U16(len));
+        } else {
+            _writeTagged(0xc6, _checkedLen(len));
+        }
+    }
+
+    void _writeBytes(const U8* data, size_t len) {
+        if (len == 0) {
+            return;
+        }
+        if (_sink != nullptr && len >= _buf.size() / 2) {
+            _flushBuffer();
+            _sink->write(data, len);
+            _flushed += len;
+            return;
+        }
+        std::memcpy(_claim(len), data, len);
+    }
+
+    // Copy num scalars converted to big-endian, chunked through the
+    // staging buffer in sink mode.
+    template <typename S> void _writeSwapped(const U8* src, size_t num) {
+        if (_sink == nullptr) {
+            msgpack::copy_swapped<S>(_claim(num * sizeof(S)), src, num);
+            return;
+        }
+
+        while (num > 0) {
+            size_t avail = (_buf.size() - _size) / sizeof(S);
+            if (avail == 0) {
+                _flushBuffer();
+                continue;
+            }
+            size_t chunk = minimum(avail, num);
+            msgpack::copy_swapped<S>(_buf.data() + _size, src, chunk);
+            _size += chunk * sizeof(S);
+            src += chunk * sizeof(S);
+            num -= chunk;
+        }
     }
 };
 
-} // namespace nv
\ No newline at end of file
+} // namespace nv
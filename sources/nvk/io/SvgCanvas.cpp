@@ -1,39 +1,163 @@
 #include <nvk/io/SvgCanvas.h>
+#include <nvk/io/SvgRaster.h>
 
 namespace nv {
 
 namespace {
 
+// Size of the markup accumulated before writing to the file in streaming
+// mode:
+constexpr size_t kStreamFlushSize = 1024 * 1024;
+
 // Minimal XML entity escaping so labels containing '&', '<', '>' or quotes
 // (eg. connector ids, formatted floats with a stray '<' from debug strings)
 // don't corrupt the surrounding markup.
-auto escape_xml(const String& str) -> String {
-    String out;
-    out.reserve(str.size());
+void escape_xml(fmt::memory_buffer& out, const String& str) {
     for (char c : str) {
         switch (c) {
         case '&':
-            out += "&amp;";
+            out.append(std::string_view("&amp;"));
             break;
         case '<':
-            out += "&lt;";
+            out.append(std::string_view("&lt;"));
             break;
         case '>':
-            out += "&gt;";
+            out.append(std::string_view("&gt;"));
             break;
         case '"':
-            out += "&quot;";
+            out.append(std::string_view("&quot;"));
             break;
         default:
-            out += c;
+            out.push_back(c);
             break;
         }
     }
-    return out;
+}
+
+// Fixed point formatting, equivalent to std::fixed with the given precision
+// but without the iostream machinery.
+void append_fixed(fmt::memory_buffer& out, F64 val, U32 decimals) {
+    static constexpr F64 kScales[] = {1.0, 10.0, 100.0, 1000.0};
+    decimals = minimum(decimals, 3U);
+    F64 scaled = std::round(val * kScales[decimals]);
+    if (!(std::abs(scaled) < 1e18)) {
+        // Inf/NaN or out of the integer range:
+        fmt::format_to(std::back_inserter(out), "{:.{}f}", val, decimals);
+        return;
+    }
+
+    auto ival = (I64)scaled;
+    U64 mag = ival < 0 ? U64(-ival) : U64(ival);
+    char buf[32];
+    char* end = buf + sizeof(buf);
+    char* ptr = end;
+    for (U32 i = 0; i < decimals; ++i) {
+        *--ptr = char('0' + mag % 10);
+        mag /= 10;
+    }
+    if (decimals > 0) {
+        *--ptr = '.';
+    }
+    do {
+        *--ptr = char('0' + mag % 10);
+        mag /= 10;
+    } while (mag != 0);
+    if (ival < 0) {
+        *--ptr = '-';
+    }
+    out.append(ptr, end);
+}
+
+// Squared distance from p to the segment [a, b].
+auto segment_dist2(const Vec2d& p, const Vec2d& a, const Vec2d& b) -> F64 {
+    const F64 dx = b.x() - a.x();
+    const F64 dy = b.y() - a.y();
+    const F64 len2 = dx * dx + dy * dy;
+    F64 t = 0.0;
+    if (len2 > 0.0) {
+        t = clamp(((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / len2, 0.0,
+                  1.0);
+    }
+    const F64 ex = a.x() + t * dx - p.x();
+    const F64 ey = a.y() + t * dy - p.y();
+    return ex * ex + ey * ey;
+}
+
+// In-place simplification of screen space points to the given tolerance,
+// keeping the end points: a radial distance pass first (cheap, removes the
+// bulk of the points of over-sampled data), then Douglas-Peucker with an
+// explicit stack.
+void simplify(Vector<Vec2d>& pts, F64 tol, Vector<U32>& stack,
+              Vector<U8>& keep) {
+    if (pts.size() < 3) {
+        return;
+    }
+    const F64 tol2 = tol * tol;
+
+    size_t count = 1;
+    for (size_t i = 1; i + 1 < pts.size(); ++i) {
+        const F64 dx = pts[i].x() - pts[count - 1].x();
+        const F64 dy = pts[i].y() - pts[count - 1].y();
+        if (dx * dx + dy * dy >= tol2) {
+            pts[count++] = pts[i];
+        }
+    }
+    pts[count++] = pts.back();
+    pts.resize(count);
+    if (count < 3) {
+        return;
+    }
+
+    keep.assign(count, 0);
+    keep[0] = keep[count - 1] = 1;
+    stack.clear();
+    stack.push_back(0);
+    stack.push_back(U32(count - 1));
+    while (!stack.empty()) {
+        U32 last = stack.back();
+        stack.pop_back();
+        U32 first = stack.back();
+        stack.pop_back();
+
+        F64 maxDist2 = tol2;
+        U32 index = 0;
+        for (U32 i = first + 1; i < last; ++i) {
+            F64 d2 = segment_dist2(pts[i], pts[first], pts[last]);
+            if (d2 > maxDist2) {
+                maxDist2 = d2;
+                index = i;
+            }
+        }
+        if (index != 0) {
+            keep[index] = 1;
+            stack.push_back(first);
+            stack.push_back(index);
+            stack.push_back(index);
+            stack.push_back(last);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (keep[i] != 0) {
+            pts[kept++] = pts[i];
+        }
+    }
+    pts.resize(kept);
 }
 
 } // namespace
 
+SvgCanvas::~SvgCanvas() {
+    if (_stream != nullptr) {
+        try {
+            end_stream();
+        } catch (...) {
+            // Not throwing from a destructor.
+        }
+    }
+}
+
 void SvgCanvas::fit(const Vector<Vec2d>& pts, F64 targetWidthPx) {
     F64 maxX = std::numeric_limits<F64>::lowest();
     F64 minY = std::numeric_limits<F64>::max();
@@ -49,7 +173,7 @@ void SvgCanvas::fit(const Vector<Vec2d>& pts, F64 targetWidthPx) {
 }
 void SvgCanvas::fit_bounds(F64 minXIn, F64 minYIn, F64 maxXIn, F64 maxYIn,
                            F64 targetWidthPx, bool flipVertical) {
-    body << std::fixed << std::setprecision(1);
+    NVCHK(_stream == nullptr, "SvgCanvas: cannot change the fit of a stream.");
     widthPx = targetWidthPx;
     minX = minXIn;
     maxY = maxYIn;
@@ -75,67 +199,159 @@ auto SvgCanvas::radius_px(F64 radiusWorld) const -> F64 {
     return clamp(radiusWorld * scale, minRadiusPx, maxRadiusPx);
 }
 
+void SvgCanvas::put_num(F64 val, U32 decimals) {
+    append_fixed(body, val, decimals);
+}
+
+void SvgCanvas::put_point(const Vec2d& s, char sep) {
+    append_fixed(body, s.x(), 1);
+    body.push_back(sep);
+    append_fixed(body, s.y(), 1);
+    body.push_back(' ');
+}
+
+auto SvgCanvas::map_points(const Vector<Vec2d>& pts, size_t minPoints,
+                           Vector<Vec2d>& out) -> bool {
+    out.clear();
+    if (pts.size() < minPoints)
+        return false;
+
+    out.reserve(pts.size());
+    for (const auto& p : pts) {
+        out.push_back(map(p));
+    }
+    if (lodTolerancePx <= 0.0)
+        return true;
+
+    // Drop the shapes smaller than the tolerance:
+    F64 x0 = out[0].x();
+    F64 x1 = x0;
+    F64 y0 = out[0].y();
+    F64 y1 = y0;
+    for (const auto& s : out) {
+        x0 = std::min(x0, s.x());
+        x1 = std::max(x1, s.x());
+        y0 = std::min(y0, s.y());
+        y1 = std::max(y1, s.y());
+    }
+    if (x1 - x0 < lodTolerancePx && y1 - y0 < lodTolerancePx)
+        return false;
+
+    simplify(out, lodTolerancePx, _stack, _keep);
+    return out.size() >= minPoints;
+}
+
 void SvgCanvas::polyline(const Vector<Vec2d>& pts, const char* color,
                          F64 strokePx, bool dashed) {
-    if (pts.size() < 2)
+    if (!map_points(pts, 2, _mapped))
+        return;
+    if (_raster != nullptr) {
+        _raster->stroke(color, _mapped, strokePx);
         return;
-    body << "<polyline fill=\"none\" stroke=\"" << color << "\" stroke-width=\""
-         << strokePx << "\"";
+    }
+    put("<polyline fill=\"none\" stroke=\"");
+    put(color);
+    put("\" stroke-width=\"");
+    put_num(strokePx);
+    put("\"");
     if (dashed)
-        body << " stroke-dasharray=\"6 4\"";
-    body << " points=\"";
-    for (const auto& p : pts) {
-        const Vec2d s = map(p);
-        body << s.x() << "," << s.y() << " ";
+        put(" stroke-dasharray=\"6 4\"");
+    put(" points=\"");
+    for (const auto& s : _mapped) {
+        put_point(s, ',');
     }
-    body << "\"/>\n";
+    put("\"/>\n");
+    flush_stream();
 }
 void SvgCanvas::polygon(const Vector<Vec2d>& pts, const char* fillColor,
                         const char* strokeColor, F64 strokePx,
                         F64 fillOpacity) {
-    if (pts.size() < 3)
+    if (!map_points(pts, 3, _mapped))
         return;
-    body << "<polygon fill=\"" << (fillColor ? fillColor : "none") << "\"";
-    if (fillColor)
-        body << " fill-opacity=\"" << fillOpacity << "\"";
-    body << " stroke=\"" << strokeColor << "\" stroke-width=\"" << strokePx
-         << "\" points=\"";
-    for (const auto& p : pts) {
-        const Vec2d s = map(p);
-        body << s.x() << "," << s.y() << " ";
+    if (_raster != nullptr) {
+        if (fillColor != nullptr) {
+            const U32 size = U32(_mapped.size());
+            _raster->fill(fillColor, fillOpacity, _mapped, {&size, 1});
+        }
+        if (strokeColor != nullptr)
+            _raster->stroke(strokeColor, _mapped, strokePx, true);
+        return;
+    }
+    put("<polygon fill=\"");
+    put(fillColor ? fillColor : "none");
+    put("\"");
+    if (fillColor) {
+        put(" fill-opacity=\"");
+        put_num(fillOpacity, 2);
+        put("\"");
+    }
+    put(" stroke=\"");
+    put(strokeColor);
+    put("\" stroke-width=\"");
+    put_num(strokePx);
+    put("\" points=\"");
+    for (const auto& s : _mapped) {
+        put_point(s, ',');
     }
-    body << "\"/>\n";
+    put("\"/>\n");
+    flush_stream();
 }
 void SvgCanvas::polygons(const Vector<Vector<Vec2d>>& rings,
                          const char* fillColor, const char* strokeColor,
                          F64 strokePx, F64 fillOpacity) {
-    bool anyRing = false;
+    // Map all the rings first, to skip the path if none of them remains:
+    _ringPoints.clear();
+    _ringSizes.clear();
     for (const auto& ring : rings) {
-        if (ring.size() >= 3) {
-            anyRing = true;
-            break;
+        if (map_points(ring, 3, _mapped)) {
+            _ringPoints.insert(_ringPoints.end(), _mapped.begin(),
+                               _mapped.end());
+            _ringSizes.push_back(U32(_mapped.size()));
         }
     }
-    if (!anyRing)
+    if (_ringSizes.empty())
+        return;
+
+    if (_raster != nullptr) {
+        if (fillColor != nullptr) {
+            _raster->fill(fillColor, fillOpacity, _ringPoints, _ringSizes,
+                          true);
+        }
+        if (strokeColor != nullptr) {
+            std::span<const Vec2d> pts = _ringPoints;
+            for (U32 size : _ringSizes) {
+                _raster->stroke(strokeColor, pts.first(size), strokePx, true);
+                pts = pts.subspan(size);
+            }
+        }
         return;
+    }
 
-    body << "<path fill-rule=\"evenodd\" fill=\""
-         << (fillColor != nullptr ? fillColor : "none") << "\"";
-    if (fillColor != nullptr)
-        body << " fill-opacity=\"" << fillOpacity << "\"";
-    body << " stroke=\"" << (strokeColor != nullptr ? strokeColor : "none")
-         << "\" stroke-width=\"" << strokePx << "\" d=\"";
+    put("<path fill-rule=\"evenodd\" fill=\"");
+    put(fillColor != nullptr ? fillColor : "none");
+    put("\"");
+    if (fillColor != nullptr) {
+        put(" fill-opacity=\"");
+        put_num(fillOpacity, 2);
+        put("\"");
+    }
+    put(" stroke=\"");
+    put(strokeColor != nullptr ? strokeColor : "none");
+    put("\" stroke-width=\"");
+    put_num(strokePx);
+    put("\" d=\"");
 
-    for (const auto& ring : rings) {
-        if (ring.size() < 3)
-            continue;
-        for (U32 i = 0; i < U32(ring.size()); ++i) {
-            const Vec2d s = map(ring[i]);
-            body << (i == 0 ? "M " : "L ") << s.x() << " " << s.y() << " ";
+    const Vec2d* s = _ringPoints.data();
+    for (U32 size : _ringSizes) {
+        for (U32 i = 0; i < size; ++i) {
+            put(i == 0 ? "M " : "L ");
+            put_point(s[i], ' ');
         }
-        body << "Z ";
+        s += size;
+        put("Z ");
     }
-    body << "\"/>\n";
+    put("\"/>\n");
+    flush_stream();
 }
 
 void SvgCanvas::line(const Vec2d& a, const Vec2d& b, const char* color,
@@ -150,7 +366,7 @@ void SvgCanvas::line_arrow(const Vec2d& a, const Vec2d& b, const char* color,
     const F64 dx = sb.x() - sa.x();
     const F64 dy = sb.y() - sa.y();
     const F64 len = std::hypot(dx, dy);
-    if (len < 1e-6)
+    if (len < 1e-6 || len < lodTolerancePx)
         return;
     const F64 ux = dx / len;
     const F64 uy = dy / len;
@@ -165,69 +381,192 @@ void SvgCanvas::line_arrow(const Vec2d& a, const Vec2d& b, const char* color,
     const F64 wing1Y = backX * sinA + backY * cosA;
     const F64 wing2X = backX * cosA + backY * sinA;
     const F64 wing2Y = -backX * sinA + backY * cosA;
-    body << "<polygon fill=\"" << color << "\" points=\"" << sb.x() << ","
-         << sb.y() << " " << (sb.x() + wing1X * headSizePx) << ","
-         << (sb.y() + wing1Y * headSizePx) << " "
-         << (sb.x() + wing2X * headSizePx) << ","
-         << (sb.y() + wing2Y * headSizePx) << "\"/>\n";
+    if (_raster != nullptr) {
+        const Vec2d head[3] = {
+            sb,
+            {sb.x() + wing1X * headSizePx, sb.y() + wing1Y * headSizePx},
+            {sb.x() + wing2X * headSizePx, sb.y() + wing2Y * headSizePx}};
+        const U32 size = 3;
+        _raster->fill(color, 1.0, head, {&size, 1});
+        return;
+    }
+    put("<polygon fill=\"");
+    put(color);
+    put("\" points=\"");
+    put_point(sb, ',');
+    put_point({sb.x() + wing1X * headSizePx, sb.y() + wing1Y * headSizePx},
+              ',');
+    put_point({sb.x() + wing2X * headSizePx, sb.y() + wing2Y * headSizePx},
+              ',');
+    put("\"/>\n");
+    flush_stream();
 }
 void SvgCanvas::dot(const Vec2d& c, F64 radiusPx, const char* color,
                     bool filled) {
     const Vec2d s = map(c);
-    body << "<circle cx=\"" << s.x() << "\" cy=\"" << s.y() << "\" r=\""
-         << radiusPx << "\" ";
-    if (filled)
-        body << "fill=\"" << color << "\"/>\n";
-    else
-        body << "fill=\"none\" stroke=\"" << color
-             << "\" stroke-width=\"2\"/>\n";
+    if (_raster != nullptr) {
+        if (filled)
+            _raster->disc(color, s, radiusPx);
+        else
+            _raster->ring(color, s, radiusPx, 2.0);
+        return;
+    }
+    put("<circle cx=\"");
+    put_num(s.x());
+    put("\" cy=\"");
+    put_num(s.y());
+    put("\" r=\"");
+    put_num(radiusPx);
+    put("\" ");
+    if (filled) {
+        put("fill=\"");
+        put(color);
+        put("\"/>\n");
+    } else {
+        put("fill=\"none\" stroke=\"");
+        put(color);
+        put("\" stroke-width=\"2\"/>\n");
+    }
+    flush_stream();
 }
 void SvgCanvas::circle_world(const Vec2d& c, F64 radiusPx, const char* color) {
     const Vec2d s = map(c);
-    body << "<circle cx=\"" << s.x() << "\" cy=\"" << s.y() << "\" r=\""
-         << radiusPx << "\" fill=\"none\" stroke=\"" << color
-         << "\" stroke-width=\"1\" stroke-dasharray=\"3 3\"/>\n";
+    if (_raster != nullptr) {
+        _raster->ring(color, s, radiusPx, 1.0);
+        return;
+    }
+    put("<circle cx=\"");
+    put_num(s.x());
+    put("\" cy=\"");
+    put_num(s.y());
+    put("\" r=\"");
+    put_num(radiusPx);
+    put("\" fill=\"none\" stroke=\"");
+    put(color);
+    put("\" stroke-width=\"1\" stroke-dasharray=\"3 3\"/>\n");
+    flush_stream();
 }
 void SvgCanvas::cross(const Vec2d& c, F64 sizePx, const char* color) {
     const Vec2d s = map(c);
-    body << "<path fill=\"none\" stroke=\"" << color
-         << "\" stroke-width=\"2\" d=\"M " << (s.x() - sizePx) << " "
-         << (s.y() - sizePx) << " L " << (s.x() + sizePx) << " "
-         << (s.y() + sizePx) << " M " << (s.x() - sizePx) << " "
-         << (s.y() + sizePx) << " L " << (s.x() + sizePx) << " "
-         << (s.y() - sizePx) << "\"/>\n";
+    if (_raster != nullptr) {
+        const Vec2d d1[2] = {{s.x() - sizePx, s.y() - sizePx},
+                             {s.x() + sizePx, s.y() + sizePx}};
+        const Vec2d d2[2] = {{s.x() - sizePx, s.y() + sizePx},
+                             {s.x() + sizePx, s.y() - sizePx}};
+        _raster->stroke(color, d1, 2.0);
+        _raster->stroke(color, d2, 2.0);
+        return;
+    }
+    put("<path fill=\"none\" stroke=\"");
+    put(color);
+    put("\" stroke-width=\"2\" d=\"M ");
+    put_point({s.x() - sizePx, s.y() - sizePx}, ' ');
+    put("L ");
+    put_point({s.x() + sizePx, s.y() + sizePx}, ' ');
+    put("M ");
+    put_point({s.x() - sizePx, s.y() + sizePx}, ' ');
+    put("L ");
+    put_point({s.x() + sizePx, s.y() - sizePx}, ' ');
+    put("\"/>\n");
+    flush_stream();
 }
 void SvgCanvas::text(const Vec2d& pos, const String& str, const char* color,
                      F64 sizePx) {
     const Vec2d s = map(pos);
-    body << "<text x=\"" << s.x() << "\" y=\"" << s.y() << "\" fill=\"" << color
-         << "\" font-size=\"" << sizePx << "\" font-family=\"monospace\">"
-         << escape_xml(str) << "</text>\n";
+    text_px(s.x(), s.y(), str, color, sizePx);
 }
 void SvgCanvas::text_px(F64 x, F64 y, const String& str, const char* color,
                         F64 sizePx) {
-    body << "<text x=\"" << x << "\" y=\"" << y << "\" fill=\"" << color
-         << "\" font-size=\"" << sizePx << "\" font-family=\"monospace\">"
-         << escape_xml(str) << "</text>\n";
+    if (_raster != nullptr)
+        return;
+    put("<text x=\"");
+    put_num(x);
+    put("\" y=\"");
+    put_num(y);
+    put("\" fill=\"");
+    put(color);
+    put("\" font-size=\"");
+    put_num(sizePx);
+    put("\" font-family=\"monospace\">");
+    escape_xml(body, str);
+    put("</text>\n");
+    flush_stream();
 }
 void SvgCanvas::clear() {
-    body.str("");
+    NVCHK(_stream == nullptr, "SvgCanvas: cannot clear a stream.");
     body.clear();
-    body << std::fixed << std::setprecision(1);
+    if (_raster != nullptr)
+        _raster->clear();
+}
+void SvgCanvas::put_header(fmt::memory_buffer& out) const {
+    fmt::format_to(std::back_inserter(out),
+                   "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"{:.1f}\" "
+                   "height=\"{:.1f}\" viewBox=\"0 0 {:.1f} {:.1f}\">\n"
+                   "<rect width=\"100%\" height=\"100%\" fill=\"#ffffff\"/>\n",
+                   widthPx, heightPx, widthPx, heightPx);
 }
 auto SvgCanvas::finalize() const -> String {
-    std::ostringstream out;
-    out << std::fixed << std::setprecision(1)
-        << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << widthPx
-        << "\" height=\"" << heightPx << "\" viewBox=\"0 0 " << widthPx << " "
-        << heightPx << "\">\n"
-        << "<rect width=\"100%\" height=\"100%\" fill=\"#ffffff\"/>\n"
-        << body.str() << "</svg>\n";
-    return out.str();
+    NVCHK(_stream == nullptr, "SvgCanvas: finalize() called on a stream.");
+    fmt::memory_buffer out;
+    put_header(out);
+    out.append(body);
+    out.append(std::string_view("</svg>\n"));
+    return {out.data(), out.size()};
 }
 void SvgCanvas::write_file(const String& fpath) const {
     auto folder = get_parent_folder(fpath);
     create_folders(folder);
     nv::write_file(fpath.c_str(), finalize());
 }
+
+void SvgCanvas::begin_stream(const String& fpath, F64 lodTolPx) {
+    NVCHK(_stream == nullptr, "SvgCanvas: already streaming to {}",
+          _streamPath);
+    NVCHK(heightPx > 0.0, "SvgCanvas: fit() must be called before streaming.");
+    create_folders(get_parent_folder(fpath));
+    _stream = std::fopen(fpath.c_str(), "wb");
+    NVCHK(_stream != nullptr, "SvgCanvas: cannot open {} for writing", fpath);
+    _streamPath = fpath;
+    lodTolerancePx = lodTolPx;
+
+    // Anything drawn before is kept, after the header:
+    fmt::memory_buffer header;
+    put_header(header);
+    header.append(body);
+    body.clear();
+    body.append(header);
+    flush_stream();
+}
+
+void SvgCanvas::end_stream() {
+    if (_stream == nullptr)
+        return;
+    put("</svg>\n");
+    flush_stream(true);
+    bool ok = std::fclose(_stream) == 0;
+    _stream = nullptr;
+    NVCHK(ok, "SvgCanvas: error while writing {}", _streamPath);
+}
+
+void SvgCanvas::begin_raster() {
+    NVCHK(_stream == nullptr, "SvgCanvas: cannot rasterize a stream.");
+    NVCHK(heightPx > 0.0, "SvgCanvas: fit() must be called first.");
+    _raster = std::make_unique<SvgRaster>(U32(std::ceil(widthPx)),
+                                          U32(std::ceil(heightPx)));
+}
+
+void SvgCanvas::write_png(const String& fpath, U32 numThreads) {
+    NVCHK(_raster != nullptr, "SvgCanvas: begin_raster() was not called.");
+    _raster->render(numThreads);
+    _raster->write_png(fpath);
+}
+
+void SvgCanvas::flush_stream(bool force) {
+    if (_stream == nullptr || (!force && body.size() < kStreamFlushSize))
+        return;
+    size_t count = std::fwrite(body.data(), 1, body.size(), _stream);
+    NVCHK(count == body.size(), "SvgCanvas: error while writing {}",
+          _streamPath);
+    body.clear();
+}
 } // namespace nv
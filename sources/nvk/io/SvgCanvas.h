@@ -3,12 +3,15 @@
 
 // Minimal SVG canvas used by dump_junction_svg(): fits world-cm points into a
 // fixed-width viewport (Y axis flipped: world Y-up -> SVG Y-down) and
-// accumulates shapes as SVG markup.
+// accumulates shapes as SVG markup, streams them to a file for very large
+// scenes, or rasterizes them to a PNG image.
 
 #include <nvk_common.h>
 
 namespace nv {
 
+class SvgRaster;
+
 struct SvgCanvas {
     F64 minX{0.0};
     F64 maxY{0.0};
@@ -26,7 +29,20 @@ struct SvgCanvas {
     F64 minRadiusPx{0.5};
     F64 maxRadiusPx{5.0};
 
-    std::ostringstream body;
+    // Level of detail tolerance in px (0 to disable): polylines and polygons
+    // smaller than this on screen are dropped, and the others are simplified
+    // to this tolerance (Douglas-Peucker in screen space). A whole city road
+    // network then costs what is actually visible at the current scale.
+    F64 lodTolerancePx{0.0};
+
+    // Markup (not yet written to the file in streaming mode), with the
+    // coordinates written with 1 decimal.
+    fmt::memory_buffer body;
+
+    SvgCanvas() = default;
+    ~SvgCanvas();
+    NV_DECLARE_NO_COPY(SvgCanvas)
+    NV_DECLARE_NO_MOVE(SvgCanvas)
 
     void fit(const Vector<Vec2d>& pts, F64 targetWidthPx);
 
@@ -103,6 +119,57 @@ struct SvgCanvas {
     [[nodiscard]] auto finalize() const -> String;
 
     void write_file(const String& fpath) const;
+
+    // Streaming mode: the markup is written to fpath as it is produced
+    // instead of being kept in memory, so the memory usage stays bounded
+    // whatever the size of the scene. Must be called after fit() since the
+    // header holds the canvas size, and enables the LOD culling with the
+    // given tolerance (pass 0 to keep every primitive).
+    void begin_stream(const String& fpath, F64 lodTolPx = 0.5);
+
+    // Writes the closing tag and closes the file (also done on destruction).
+    void end_stream();
+
+    [[nodiscard]] auto is_streaming() const -> bool {
+        return _stream != nullptr;
+    }
+
+    // Raster mode: the primitives are drawn into an anti-aliased image of
+    // widthPx x heightPx pixels instead of being written as markup, and
+    // saved with write_png(). Must be called after fit(). Text is not
+    // rendered, and dashed lines are drawn solid.
+    void begin_raster();
+
+    // Render the image (tiles rendered by numThreads threads, 0 for all the
+    // cores) and write it as a PNG file.
+    void write_png(const String& fpath, U32 numThreads = 0);
+
+    [[nodiscard]] auto is_raster() const -> bool { return _raster != nullptr; }
+
+  private:
+    void put(std::string_view str) {
+        body.append(str.data(), str.data() + str.size());
+    }
+    void put_num(F64 val, U32 decimals = 1);
+    void put_point(const Vec2d& s, char sep);
+    void put_header(fmt::memory_buffer& out) const;
+    void flush_stream(bool force = false);
+
+    // Map points to the canvas and apply the LOD. Returns false if nothing
+    // remains to draw (fewer than minPoints points, or sub-pixel shape).
+    auto map_points(const Vector<Vec2d>& pts, size_t minPoints,
+                    Vector<Vec2d>& out) -> bool;
+
+    std::FILE* _stream{nullptr};
+    String _streamPath;
+    std::unique_ptr<SvgRaster> _raster;
+
+    // Scratch buffers, reused across calls:
+    Vector<Vec2d> _mapped;
+    Vector<Vec2d> _ringPoints;
+    Vector<U32> _ringSizes;
+    Vector<U32> _stack;
+    Vector<U8> _keep;
 };
 
 } // namespace nv
@@ -0,0 +1,463 @@
+#include <nvk/io/SvgRaster.h>
+
+// Private copy of the writer functions, so we don't conflict with another
+// stb_image_write implementation linked in the same binary:
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <external/stb/stb_image_write.h>
+
+namespace nv {
+
+namespace {
+
+// Tile size in pixels:
+constexpr U32 kTileSize = 64;
+// Row stride of the accumulation buffer: the clamped edges may write up to
+// 2 cells past the tile width.
+constexpr U32 kAccStride = kTileSize + 2;
+
+struct NamedColor {
+    const char* name;
+    U32 rgb;
+};
+
+constexpr NamedColor kNamedColors[] = {
+    {"black", 0x000000},   {"white", 0xffffff},  {"red", 0xff0000},
+    {"green", 0x008000},   {"lime", 0x00ff00},   {"blue", 0x0000ff},
+    {"yellow", 0xffff00},  {"cyan", 0x00ffff},   {"aqua", 0x00ffff},
+    {"magenta", 0xff00ff}, {"fuchsia", 0xff00ff}, {"gray", 0x808080},
+    {"grey", 0x808080},    {"silver", 0xc0c0c0}, {"orange", 0xffa500},
+    {"purple", 0x800080},  {"brown", 0xa52a2a},  {"pink", 0xffc0cb},
+    {"navy", 0x000080},    {"teal", 0x008080},   {"olive", 0x808000},
+    {"maroon", 0x800000},  {"gold", 0xffd700},   {"violet", 0xee82ee},
+    {"darkgray", 0xa9a9a9}, {"lightgray", 0xd3d3d3},
+    {"darkgreen", 0x006400}, {"darkblue", 0x00008b},
+    {"darkred", 0x8b0000}, {"darkorange", 0xff8c00},
+    {"steelblue", 0x4682b4}, {"crimson", 0xdc143c},
+};
+
+auto hex_value(char c) -> I32 {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Accumulate the signed area covered by an edge in each cell of the rows it
+// crosses (the coverage is the running sum of a row). The x coordinates must
+// be within [0, tile width].
+void accumulate_line(F32* acc, U32 height, F32 x0, F32 y0, F32 x1, F32 y1) {
+    if (y0 == y1)
+        return;
+    F32 dir = 1.0F;
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1.0F;
+    }
+    if (y1 <= 0.0F || y0 >= (F32)height)
+        return;
+
+    const F32 dxdy = (x1 - x0) / (y1 - y0);
+    F32 x = x0;
+    if (y0 < 0.0F)
+        x -= y0 * dxdy;
+    const U32 rowStart = y0 < 0.0F ? 0 : (U32)y0;
+    const U32 rowEnd = std::min(height, (U32)std::ceil(y1));
+
+    for (U32 y = rowStart; y < rowEnd; ++y) {
+        F32* row = acc + y * kAccStride;
+        const F32 dy = std::min(F32(y + 1), y1) - std::max(F32(y), y0);
+        const F32 xnext = std::max(x + dxdy * dy, 0.0F);
+        const F32 d = dy * dir;
+        const F32 xa = std::min(x, xnext);
+        const F32 xb = std::max(x, xnext);
+        const F32 xaFloor = std::floor(xa);
+        const auto xai = (I32)xaFloor;
+        const F32 xbCeil = std::ceil(xb);
+        const auto xbi = (I32)xbCeil;
+
+        if (xbi <= xai + 1) {
+            // Within a single cell:
+            const F32 xmf = 0.5F * (x + xnext) - xaFloor;
+            row[xai] += d - d * xmf;
+            row[xai + 1] += d * xmf;
+        } else {
+            const F32 s = 1.0F / (xb - xa);
+            const F32 xaf = xa - xaFloor;
+            const F32 a0 = 0.5F * s * (1.0F - xaf) * (1.0F - xaf);
+            const F32 xbf = xb - xbCeil + 1.0F;
+            const F32 am = 0.5F * s * xbf * xbf;
+            row[xai] += d * a0;
+            if (xbi == xai + 2) {
+                row[xai + 1] += d * (1.0F - a0 - am);
+            } else {
+                const F32 a1 = s * (1.5F - xaf);
+                row[xai + 1] += d * (a1 - a0);
+                for (I32 xi = xai + 2; xi < xbi - 1; ++xi) {
+                    row[xi] += d * s;
+                }
+                const F32 a2 = a1 + F32(xbi - xai - 3) * s;
+                row[xbi - 1] += d * (1.0F - a2 - am);
+            }
+            row[xbi] += d * am;
+        }
+        x = xnext;
+    }
+}
+
+// Add an edge in tile coordinates: the parts left/right of the tile are
+// replaced by vertical edges on its borders, which keeps the coverage of the
+// pixels inside the tile exact.
+void add_tile_edge(F32* acc, U32 width, U32 height, F32 x0, F32 y0, F32 x1,
+                   F32 y1) {
+    const F32 w = (F32)width;
+    F32 ts[4] = {0.0F};
+    U32 n = 1;
+    if ((x0 < 0.0F) != (x1 < 0.0F))
+        ts[n++] = -x0 / (x1 - x0);
+    if ((x0 > w) != (x1 > w))
+        ts[n++] = (w - x0) / (x1 - x0);
+    if (n == 3 && ts[1] > ts[2])
+        std::swap(ts[1], ts[2]);
+    ts[n++] = 1.0F;
+
+    for (U32 i = 0; i + 1 < n; ++i) {
+        const F32 xa = clamp(x0 + (x1 - x0) * ts[i], 0.0F, w);
+        const F32 ya = y0 + (y1 - y0) * ts[i];
+        const F32 xb = clamp(x0 + (x1 - x0) * ts[i + 1], 0.0F, w);
+        const F32 yb = y0 + (y1 - y0) * ts[i + 1];
+        accumulate_line(acc, height, xa, ya, xb, yb);
+    }
+}
+
+} // namespace
+
+struct SvgRaster::TileScratch {
+    Vector<F32> acc = Vector<F32>(kAccStride * kTileSize, 0.0F);
+};
+
+SvgRaster::SvgRaster(U32 width, U32 height)
+    : _width(maximum(width, 1U)), _height(maximum(height, 1U)) {
+    _tilesX = (_width + kTileSize - 1) / kTileSize;
+    _tilesY = (_height + kTileSize - 1) / kTileSize;
+}
+
+auto SvgRaster::parse_color(const char* color) -> U32 {
+    U32 rgb = 0;
+    U32 alpha = 0xff;
+    if (color == nullptr)
+        return 0xff000000U;
+
+    if (color[0] == '#') {
+        const char* hex = color + 1;
+        size_t len = std::strlen(hex);
+        U32 value = 0;
+        for (size_t i = 0; i < len; ++i) {
+            I32 v = hex_value(hex[i]);
+            if (v < 0)
+                return 0xff000000U;
+            value = (value << 4) | U32(v);
+        }
+        if (len == 3) {
+            // #rgb: each digit is doubled.
+            U32 r = (value >> 8) & 0xf;
+            U32 g = (value >> 4) & 0xf;
+            U32 b = value & 0xf;
+            rgb = (r * 0x11 << 16) | (g * 0x11 << 8) | (b * 0x11);
+        } else if (len == 6) {
+            rgb = value;
+        } else if (len == 8) {
+            rgb = value >> 8;
+            alpha = value & 0xff;
+        }
+    } else {
+        for (const auto& named : kNamedColors) {
+            if (std::strcmp(named.name, color) == 0) {
+                rgb = named.rgb;
+                break;
+            }
+        }
+    }
+
+    // Stored as 0xAABBGGRR (RGBA bytes in memory):
+    return (alpha << 24) | ((rgb & 0xff) << 16) | (rgb & 0xff00) |
+           ((rgb >> 16) & 0xff);
+}
+
+auto SvgRaster::begin_shape(const char* color, F64 opacity, bool evenOdd)
+    -> U32 {
+    const char* key = color != nullptr ? color : "black";
+    auto it = _colors.find(key);
+    if (it == _colors.end()) {
+        it = _colors.emplace(key, parse_color(key)).first;
+    }
+
+    Shape shape{};
+    shape.color = it->second;
+    shape.alpha = F32(clamp(opacity, 0.0, 1.0) * F64(shape.color >> 24) /
+                      255.0);
+    shape.evenOdd = evenOdd;
+    _shapes.push_back(shape);
+    _rendered = false;
+    return U32(_shapes.size() - 1);
+}
+
+void SvgRaster::add_path(U32 shape, const Vec2d* pts, size_t count) {
+    if (count < 3)
+        return;
+
+    Path path{};
+    path.firstEdge = U32(_edges.size());
+    path.numEdges = U32(count);
+    path.shape = shape;
+    path.minX = path.minY = std::numeric_limits<F32>::max();
+    path.maxX = path.maxY = std::numeric_limits<F32>::lowest();
+    for (size_t i = 0; i < count; ++i) {
+        const Vec2d& a = pts[i];
+        const Vec2d& b = pts[(i + 1) % count];
+        _edges.push_back({F32(a.x()), F32(a.y()), F32(b.x()), F32(b.y())});
+        path.minX = std::min(path.minX, F32(a.x()));
+        path.maxX = std::max(path.maxX, F32(a.x()));
+        path.minY = std::min(path.minY, F32(a.y()));
+        path.maxY = std::max(path.maxY, F32(a.y()));
+    }
+
+    // Fully outside of the image:
+    if (path.maxX <= 0.0F || path.maxY <= 0.0F ||
+        path.minX >= (F32)_width || path.minY >= (F32)_height) {
+        _edges.resize(path.firstEdge);
+        return;
+    }
+    _paths.push_back(path);
+}
+
+void SvgRaster::add_quad(U32 shape, const Vec2d& a, const Vec2d& b,
+                         F64 halfWidth) {
+    F64 dx = b.x() - a.x();
+    F64 dy = b.y() - a.y();
+    F64 len = std::hypot(dx, dy);
+    if (len < 1e-9) {
+        dx = 1.0;
+        dy = 0.0;
+    } else {
+        dx /= len;
+        dy /= len;
+    }
+    // Square caps: extended by half the width on both ends.
+    const F64 ex = dx * halfWidth;
+    const F64 ey = dy * halfWidth;
+    const F64 nx = -ey;
+    const F64 ny = ex;
+    const Vec2d quad[4] = {
+        {a.x() - ex + nx, a.y() - ey + ny},
+        {b.x() + ex + nx, b.y() + ey + ny},
+        {b.x() + ex - nx, b.y() + ey - ny},
+        {a.x() - ex - nx, a.y() - ey - ny},
+    };
+    add_path(shape, quad, 4);
+}
+
+void SvgRaster::add_circle(U32 shape, const Vec2d& center, F64 radius,
+                           bool reversed) {
+    // Enough segments to stay within ~0.1 px of the circle:
+    U32 count = clamp(U32(std::ceil(PI * std::sqrt(radius / 0.2))), 8U, 256U);
+    _scratch.resize(count);
+    for (U32 i = 0; i < count; ++i) {
+        F64 angle = 2.0 * PI * F64(reversed ? count - i : i) / F64(count);
+        _scratch[i] = {center.x() + radius * std::cos(angle),
+                       center.y() + radius * std::sin(angle)};
+    }
+    add_path(shape, _scratch.data(), count);
+}
+
+void SvgRaster::fill(const char* color, F64 opacity,
+                     std::span<const Vec2d> pts,
+                     std::span<const U32> ringSizes, bool evenOdd) {
+    U32 shape = begin_shape(color, opacity, evenOdd);
+    size_t offset = 0;
+    for (U32 size : ringSizes) {
+        NVCHK(offset + size <= pts.size(), "SvgRaster: invalid ring sizes.");
+        add_path(shape, pts.data() + offset, size);
+        offset += size;
+    }
+}
+
+void SvgRaster::stroke(const char* color, std::span<const Vec2d> pts,
+                       F64 widthPx, bool closed) {
+    if (pts.size() < 2 || widthPx <= 0.0)
+        return;
+    U32 shape = begin_shape(color, 1.0, false);
+    const F64 halfWidth = 0.5 * widthPx;
+    for (size_t i = 0; i + 1 < pts.size(); ++i) {
+        add_quad(shape, pts[i], pts[i + 1], halfWidth);
+    }
+    if (closed && pts.size() > 2) {
+        add_quad(shape, pts.back(), pts.front(), halfWidth);
+    }
+}
+
+void SvgRaster::disc(const char* color, const Vec2d& center, F64 radius) {
+    U32 shape = begin_shape(color, 1.0, false);
+    add_circle(shape, center, radius, false);
+}
+
+void SvgRaster::ring(const char* color, const Vec2d& center, F64 radius,
+                     F64 widthPx) {
+    U32 shape = begin_shape(color, 1.0, false);
+    // The inner circle in the opposite direction cancels the outer one:
+    add_circle(shape, center, radius + 0.5 * widthPx, false);
+    if (radius > 0.5 * widthPx) {
+        add_circle(shape, center, radius - 0.5 * widthPx, true);
+    }
+}
+
+void SvgRaster::clear() {
+    _edges.clear();
+    _paths.clear();
+    _shapes.clear();
+    _rendered = false;
+}
+
+void SvgRaster::bin_paths() {
+    _tilePaths.assign(size_t(_tilesX) * _tilesY, {});
+    const auto tileSize = (F32)kTileSize;
+    for (U32 p = 0; p < U32(_paths.size()); ++p) {
+        const Path& path = _paths[p];
+        // A closed path has no effect outside of its bounding box:
+        U32 tx0 = U32(std::max(path.minX, 0.0F) / tileSize);
+        U32 ty0 = U32(std::max(path.minY, 0.0F) / tileSize);
+        U32 tx1 = std::min(U32(path.maxX / tileSize), _tilesX - 1);
+        U32 ty1 = std::min(U32(path.maxY / tileSize), _tilesY - 1);
+        for (U32 ty = ty0; ty <= ty1; ++ty) {
+            for (U32 tx = tx0; tx <= tx1; ++tx) {
+                _tilePaths[ty * _tilesX + tx].push_back(p);
+            }
+        }
+    }
+}
+
+void SvgRaster::render_tile(U32 tile, TileScratch& scratch) {
+    const U32 tileX = (tile % _tilesX) * kTileSize;
+    const U32 tileY = (tile / _tilesX) * kTileSize;
+    const U32 w = std::min(kTileSize, _width - tileX);
+    const U32 h = std::min(kTileSize, _height - tileY);
+    const F32 ox = (F32)tileX;
+    const F32 oy = (F32)tileY;
+    F32* acc = scratch.acc.data();
+
+    // White background:
+    for (U32 y = 0; y < h; ++y) {
+        U8* px = _pixels.data() + (size_t(tileY + y) * _width + tileX) * 4;
+        std::memset(px, 0xff, size_t(w) * 4);
+    }
+
+    const auto& list = _tilePaths[tile];
+    size_t i = 0;
+    while (i < list.size()) {
+        // All the paths of a shape are accumulated together:
+        const U32 shapeIdx = _paths[list[i]].shape;
+        F32 minX = std::numeric_limits<F32>::max();
+        F32 minY = minX;
+        F32 maxX = std::numeric_limits<F32>::lowest();
+        F32 maxY = maxX;
+        for (; i < list.size() && _paths[list[i]].shape == shapeIdx; ++i) {
+            const Path& path = _paths[list[i]];
+            minX = std::min(minX, path.minX);
+            minY = std::min(minY, path.minY);
+            maxX = std::max(maxX, path.maxX);
+            maxY = std::max(maxY, path.maxY);
+            const Edge* edge = _edges.data() + path.firstEdge;
+            for (U32 e = 0; e < path.numEdges; ++e, ++edge) {
+                add_tile_edge(acc, w, h, edge->x0 - ox, edge->y0 - oy,
+                              edge->x1 - ox, edge->y1 - oy);
+            }
+        }
+
+        // Region of the accumulation buffer touched by the shape (it is
+        // reset while compositing):
+        const U32 r0 = U32(std::max(minY - oy, 0.0F));
+        const U32 r1 = std::min(h, U32(std::max(std::ceil(maxY - oy), 0.0F)));
+        const U32 c0 = std::min(w, U32(std::max(minX - ox, 0.0F)));
+        const U32 c1 =
+            std::min(w + 2, U32(std::max(std::ceil(maxX - ox), 0.0F)) + 2);
+
+        const Shape& shape = _shapes[shapeIdx];
+        const auto sr = F32(shape.color & 0xff);
+        const auto sg = F32((shape.color >> 8) & 0xff);
+        const auto sb = F32((shape.color >> 16) & 0xff);
+        for (U32 y = r0; y < r1; ++y) {
+            F32* row = acc + y * kAccStride;
+            U8* px = _pixels.data() + (size_t(tileY + y) * _width + tileX) * 4;
+            F32 sum = 0.0F;
+            for (U32 x = c0; x < c1; ++x) {
+                sum += row[x];
+                row[x] = 0.0F;
+                if (x >= w)
+                    continue;
+
+                F32 cov = std::abs(sum);
+                if (shape.evenOdd) {
+                    cov = std::fmod(cov, 2.0F);
+                    if (cov > 1.0F)
+                        cov = 2.0F - cov;
+                } else {
+                    cov = std::min(cov, 1.0F);
+                }
+                const F32 a = cov * shape.alpha;
+                if (a < 1.0F / 512.0F)
+                    continue;
+                U8* p = px + size_t(x) * 4;
+                p[0] = U8(F32(p[0]) + (sr - F32(p[0])) * a + 0.5F);
+                p[1] = U8(F32(p[1]) + (sg - F32(p[1])) * a + 0.5F);
+                p[2] = U8(F32(p[2]) + (sb - F32(p[2])) * a + 0.5F);
+            }
+        }
+    }
+}
+
+void SvgRaster::render(U32 numThreads) {
+    _pixels.resize(size_t(_width) * _height * 4);
+    bin_paths();
+
+    const U32 numTiles = _tilesX * _tilesY;
+    if (numThreads == 0) {
+        numThreads = maximum(std::thread::hardware_concurrency(), 1U);
+    }
+    numThreads = minimum(numThreads, numTiles);
+
+    std::atomic<U32> nextTile{0};
+    auto worker = [this, &nextTile, numTiles]() {
+        TileScratch scratch;
+        for (U32 tile = nextTile++; tile < numTiles; tile = nextTile++) {
+            render_tile(tile, scratch);
+        }
+    };
+
+    Vector<std::thread> threads;
+    for (U32 i = 1; i < numThreads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    _tilePaths.clear();
+    _rendered = true;
+}
+
+void SvgRaster::write_png(const String& fpath) {
+    if (!_rendered) {
+        render();
+    }
+    create_folders(get_parent_folder(fpath));
+    int res = stbi_write_png(fpath.c_str(), int(_width), int(_height), 4,
+                             _pixels.data(), int(_width * 4));
+    NVCHK(res != 0, "SvgRaster: cannot write {}", fpath);
+}
+
+} // namespace nv
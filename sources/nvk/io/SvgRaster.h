@@ -0,0 +1,101 @@
+#ifndef _SVG_RASTER_H_
+#define _SVG_RASTER_H_
+
+// Raster target of SvgCanvas: records the primitives as closed polygons in
+// pixel space and renders them with an anti-aliased scanline rasterizer
+// (signed area accumulation), in tiles processed in parallel. Rendering
+// millions of segments takes seconds, and the PNG size only depends on the
+// image size.
+
+#include <nvk_common.h>
+
+#include <span>
+
+namespace nv {
+
+class SvgRaster {
+  public:
+    SvgRaster(U32 width, U32 height);
+
+    // Fill closed rings (given as consecutive point runs of ringSizes
+    // points), with the non-zero or even-odd rule.
+    void fill(const char* color, F64 opacity, std::span<const Vec2d> pts,
+              std::span<const U32> ringSizes, bool evenOdd = false);
+
+    // Stroke a polyline (square caps, so consecutive segments overlap at the
+    // joints).
+    void stroke(const char* color, std::span<const Vec2d> pts, F64 widthPx,
+                bool closed = false);
+
+    void disc(const char* color, const Vec2d& center, F64 radius);
+    void ring(const char* color, const Vec2d& center, F64 radius,
+              F64 widthPx);
+
+    // Render the primitives recorded so far onto a white background.
+    void render(U32 numThreads = 0);
+
+    // Render (if needed) and save the image.
+    void write_png(const String& fpath);
+
+    void clear();
+
+    [[nodiscard]] auto width() const -> U32 { return _width; }
+    [[nodiscard]] auto height() const -> U32 { return _height; }
+
+    // RGBA pixels, valid after render().
+    [[nodiscard]] auto pixels() const -> const U8Vector& { return _pixels; }
+
+    // Parse an SVG color (#rgb, #rrggbb, #rrggbbaa or a common color name)
+    // as 0xAABBGGRR. Unknown names give black.
+    static auto parse_color(const char* color) -> U32;
+
+  private:
+    struct Edge {
+        F32 x0, y0, x1, y1;
+    };
+
+    // Closed polygon, contributing nothing outside of its bounding box.
+    struct Path {
+        U32 firstEdge;
+        U32 numEdges;
+        U32 shape;
+        F32 minX, minY, maxX, maxY;
+    };
+
+    struct Shape {
+        U32 color;
+        F32 alpha;
+        bool evenOdd;
+    };
+
+    struct TileScratch;
+
+    auto begin_shape(const char* color, F64 opacity, bool evenOdd) -> U32;
+    void add_path(U32 shape, const Vec2d* pts, size_t count);
+    void add_quad(U32 shape, const Vec2d& a, const Vec2d& b, F64 halfWidth);
+    void add_circle(U32 shape, const Vec2d& center, F64 radius,
+                    bool reversed);
+
+    void bin_paths();
+    void render_tile(U32 tile, TileScratch& scratch);
+
+    U32 _width;
+    U32 _height;
+    U32 _tilesX;
+    U32 _tilesY;
+
+    Vector<Edge> _edges;
+    Vector<Path> _paths;
+    Vector<Shape> _shapes;
+    // Indices of the paths overlapping each tile, in drawing order:
+    Vector<Vector<U32>> _tilePaths;
+    UnorderedMap<String, U32> _colors;
+    Vector<Vec2d> _scratch;
+
+    U8Vector _pixels;
+    bool _rendered{false};
+};
+
+} // namespace nv
+
+#endif
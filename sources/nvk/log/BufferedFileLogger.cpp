@@ -0,0 +1,180 @@
+
+#include <nvk/log/BufferedFileLogger.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace nv {
+
+namespace {
+
+void sync_file(std::FILE* file) {
+#if defined(_WIN32)
+    _commit(_fileno(file));
+#elif defined(__APPLE__)
+    fsync(fileno(file));
+#else
+    fdatasync(fileno(file));
+#endif
+}
+
+} // namespace
+
+BufferedFileLogger::BufferedFileLogger(const char* filename, Traits traits)
+    : _filename(filename), _traits(traits) {
+    _pending.reserve(_traits.bufferSize + 1024);
+    open_file(_traits.append);
+}
+
+BufferedFileLogger::~BufferedFileLogger() {
+    write_pending(_traits.syncPolicy != LOG_SYNC_NONE);
+    close_file();
+}
+
+void BufferedFileLogger::open_file(bool append) {
+    auto folder = get_parent_folder(_filename);
+    if (!folder.empty()) {
+        create_folders(folder);
+    }
+
+    _file = std::fopen(_filename.c_str(), append ? "ab" : "wb");
+    NVCHK(_file != nullptr, "Cannot open file {}", _filename);
+
+    // We do our own buffering: each write_block() should go straight to the
+    // OS.
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+
+    _fileSize = 0;
+    if (append) {
+        std::fseek(_file, 0, SEEK_END);
+        auto pos = std::ftell(_file);
+        _fileSize = pos > 0 ? (U64)pos : 0;
+    }
+    _fileOpenTime = Clock::now();
+}
+
+void BufferedFileLogger::close_file() {
+    if (_file != nullptr) {
+        std::fclose(_file);
+        _file = nullptr;
+    }
+}
+
+void BufferedFileLogger::output(int level, const char* prefix,
+                                const char* msg, size_t size) {
+    if (_pending.empty()) {
+        _pendingSince = Clock::now();
+    }
+
+    if (prefix != nullptr) {
+        _pending += prefix;
+    }
+    _pending.append(msg, size);
+    _pending += '\n';
+
+    check_pending(level);
+}
+
+void BufferedFileLogger::check_pending(int level) {
+    bool severe = level <= _traits.flushLevel;
+    if (severe || _pending.size() >= _traits.bufferSize ||
+        Clock::now() - _pendingSince >=
+            std::chrono::milliseconds(_traits.flushIntervalMs)) {
+        write_pending(_traits.syncPolicy == LOG_SYNC_ALWAYS ||
+                      (severe && _traits.syncPolicy == LOG_SYNC_ON_SEVERE));
+    }
+}
+
+void BufferedFileLogger::flush() {
+    write_pending(_traits.syncPolicy == LOG_SYNC_ALWAYS);
+}
+
+void BufferedFileLogger::poll() {
+    if (!_pending.empty() && Clock::now() - _pendingSince >=
+                                 std::chrono::milliseconds(
+                                     _traits.flushIntervalMs)) {
+        flush();
+    }
+}
+
+void BufferedFileLogger::rotate() {
+    write_pending(false);
+    rotate_files();
+}
+
+auto BufferedFileLogger::get_backup_path(U32 idx) const -> String {
+    if (idx == 0) {
+        return _filename;
+    }
+
+    // Insert the index before the extension(s) of the filename:
+    // "logs/app.log" -> "logs/app.1.log"
+    auto sepPos = _filename.find_last_of("/\\");
+    auto namePos = sepPos == String::npos ? 0 : sepPos + 1;
+    auto dotPos = _filename.find('.', namePos + 1);
+    if (dotPos == String::npos) {
+        return format_msg("{}.{}", _filename, idx);
+    }
+
+    return format_msg("{}.{}{}", _filename.substr(0, dotPos), idx,
+                      _filename.substr(dotPos));
+}
+
+void BufferedFileLogger::rotate_files() {
+    close_file();
+
+    namespace fs = std::filesystem;
+    std::error_code ec;
+
+    if (_traits.maxBackups == 0) {
+        fs::remove(_filename, ec);
+    } else {
+        fs::remove(get_backup_path(_traits.maxBackups), ec);
+        for (U32 i = _traits.maxBackups - 1; i > 0; --i) {
+            auto src = get_backup_path(i);
+            if (fs::exists(src, ec)) {
+                fs::rename(src, get_backup_path(i + 1), ec);
+            }
+        }
+        fs::rename(_filename, get_backup_path(1), ec);
+    }
+
+    open_file(false);
+}
+
+void BufferedFileLogger::write_pending(bool sync) {
+    if (_pending.empty() || _file == nullptr) {
+        return;
+    }
+
+    bool sizeExceeded = _traits.maxFileSize > 0 && _fileSize > 0 &&
+                        _fileSize + _pending.size() > _traits.maxFileSize;
+    bool ageExceeded =
+        _traits.rotationPeriodS > 0 &&
+        Clock::now() - _fileOpenTime >=
+            std::chrono::seconds(_traits.rotationPeriodS);
+    if (sizeExceeded || ageExceeded) {
+        rotate_files();
+    }
+
+    write_block(_pending.data(), _pending.size());
+    _pending.clear();
+
+    if (sync) {
+        sync_file(_file);
+    }
+}
+
+void BufferedFileLogger::write_block(const char* data, size_t size) {
+    size_t written = std::fwrite(data, 1, size, _file);
+    if (written != size) {
+        std::cout << "BufferedFileLogger: failed to write to " << _filename
+                  << std::endl;
+    }
+    _fileSize += written;
+}
+
+} // namespace nv
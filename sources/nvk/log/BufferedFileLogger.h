@@ -0,0 +1,102 @@
+#ifndef NV_BUFFEREDFILELOGGER_H_
+#define NV_BUFFEREDFILELOGGER_H_
+
+#include <nvk/log/LogManager.h>
+#include <nvk/log/LogSink.h>
+
+namespace nv {
+
+enum LogSyncPolicy : U8 {
+    // Never force the data to the disk (rely on the OS page cache).
+    LOG_SYNC_NONE,
+    // fdatasync() only after writing severe messages.
+    LOG_SYNC_ON_SEVERE,
+    // fdatasync() after every write.
+    LOG_SYNC_ALWAYS,
+};
+
+struct BufferedFileLoggerTraits {
+    bool append{false};
+    // Size of the pending data triggering a write (in bytes).
+    U32 bufferSize{256 * 1024};
+    // Max age of the pending data before it is written (in ms).
+    U32 flushIntervalMs{500};
+    // Messages at this level (or more severe) are written immediately.
+    int flushLevel{LogManager::L_ERROR};
+    // Rotate the file when the next block would grow it beyond this size
+    // (0 = never).
+    U64 maxFileSize{0};
+    // Rotate the file after this duration (in seconds, 0 = never).
+    U32 rotationPeriodS{0};
+    // Number of rotated files to keep (file.1.log, file.2.log, ...).
+    U32 maxBackups{5};
+    LogSyncPolicy syncPolicy{LOG_SYNC_NONE};
+};
+
+/**
+File sink accumulating the log lines in memory and writing them in large
+blocks: the data is only sent to the file when the buffer is full, when the
+oldest pending line gets older than the flush interval, or immediately for
+severe messages (ERROR/FATAL by default). The output file can also be rotated
+on size and/or age, keeping a limited number of backups.
+*/
+class BufferedFileLogger : public LogSink {
+    NV_DECLARE_NO_COPY(BufferedFileLogger)
+    NV_DECLARE_NO_MOVE(BufferedFileLogger)
+
+  public:
+    using Traits = BufferedFileLoggerTraits;
+
+    explicit BufferedFileLogger(const char* filename, Traits traits = {});
+
+    ~BufferedFileLogger() override;
+
+    void output(int level, const char* prefix, const char* msg,
+                size_t size) override;
+
+    void flush() override;
+
+    void poll() override;
+
+    /** Close the current file, shift the backups and start a new file. */
+    void rotate();
+
+    /** Path of the n-th rotated file (idx=0 is the active file). */
+    [[nodiscard]] auto get_backup_path(U32 idx) const -> String;
+
+    [[nodiscard]] auto get_traits() const -> const Traits& { return _traits; }
+
+  protected:
+    using Clock = std::chrono::steady_clock;
+
+    void open_file(bool append);
+
+    void close_file();
+
+    /** Write the pending data if it is full, too old, or if the level of the
+     * last appended message is severe enough. */
+    void check_pending(int level);
+
+    /** Send the pending data to the file, rotating first if needed. */
+    void write_pending(bool sync);
+
+    /** Shift the backup files and re-open a fresh active file. */
+    void rotate_files();
+
+    /** Write a raw block of data into the active file. */
+    virtual void write_block(const char* data, size_t size);
+
+    String _filename;
+    Traits _traits;
+
+    std::FILE* _file{nullptr};
+    U64 _fileSize{0};
+    Clock::time_point _fileOpenTime;
+
+    String _pending;
+    Clock::time_point _pendingSince;
+};
+
+} /* namespace nv*/
+
+#endif /* NV_BUFFEREDFILELOGGER_H_ */
@@ -0,0 +1,232 @@
+
+#include <nvk/log/CompressedFileLogger.h>
+
+#include <zlib.h>
+
+namespace nv {
+
+namespace {
+
+// gzip member header: 10 bytes fixed + 2 bytes XLEN + our 16 bytes subfield
+// ('N','V', LEN=12, U32 member size, U64 first line time in us).
+constexpr size_t kGzipFixedHeaderSize = 10;
+constexpr size_t kNvSubfieldSize = 16;
+constexpr size_t kMemberHeaderSize = kGzipFixedHeaderSize + 2 + kNvSubfieldSize;
+constexpr size_t kMemberTrailerSize = 8;
+constexpr U8 kGzipFlagExtra = 0x04;
+
+void put_u16le(U8* ptr, U16 v) {
+    ptr[0] = U8(v);
+    ptr[1] = U8(v >> 8);
+}
+
+void put_u32le(U8* ptr, U32 v) {
+    put_u16le(ptr, U16(v));
+    put_u16le(ptr + 2, U16(v >> 16));
+}
+
+void put_u64le(U8* ptr, U64 v) {
+    put_u32le(ptr, U32(v));
+    put_u32le(ptr + 4, U32(v >> 32));
+}
+
+auto get_u16le(const U8* ptr) -> U16 { return U16(ptr[0] | (ptr[1] << 8)); }
+
+auto get_u32le(const U8* ptr) -> U32 {
+    return U32(get_u16le(ptr)) | (U32(get_u16le(ptr + 2)) << 16);
+}
+
+auto get_u64le(const U8* ptr) -> U64 {
+    return U64(get_u32le(ptr)) | (U64(get_u32le(ptr + 4)) << 32);
+}
+
+auto now_us() -> U64 {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+
+struct MemberInfo {
+    U64 timeUs{0};
+    size_t size{0};
+};
+
+// Parse the header of the gzip member starting at ptr.
+auto parse_member(const U8* ptr, size_t avail, const String& filename)
+    -> MemberInfo {
+    NVCHK(avail >= kMemberHeaderSize + kMemberTrailerSize && ptr[0] == 0x1f &&
+              ptr[1] == 0x8b && ptr[2] == Z_DEFLATED &&
+              (ptr[3] & kGzipFlagExtra) != 0,
+          "Invalid compressed log block in {}", filename);
+    NVCHK(get_u16le(ptr + 10) == kNvSubfieldSize && ptr[12] == 'N' &&
+              ptr[13] == 'V' && get_u16le(ptr + 14) == 12,
+          "Missing NV block header in {}", filename);
+
+    MemberInfo info;
+    info.size = get_u32le(ptr + 16);
+    info.timeUs = get_u64le(ptr + 20);
+    NVCHK(info.size >= kMemberHeaderSize + kMemberTrailerSize &&
+              info.size <= avail,
+          "Truncated compressed log block in {}", filename);
+    return info;
+}
+
+} // namespace
+
+CompressedFileLogger::CompressedFileLogger(const char* filename,
+                                           Traits traits,
+                                           I32 compressionLevel)
+    : BufferedFileLogger(filename, traits),
+      _compressionLevel(compressionLevel) {
+    auto* zs = new z_stream{};
+    // Raw deflate stream: we write the gzip framing ourselves.
+    if (deflateInit2(zs, _compressionLevel, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        delete zs;
+        THROW_MSG("zlib initialization failed");
+    }
+    _zstream = zs;
+}
+
+CompressedFileLogger::~CompressedFileLogger() {
+    // Must be done here: write_block() is not dispatched to this class
+    // anymore in the base destructor.
+    write_pending(_traits.syncPolicy != LOG_SYNC_NONE);
+
+    auto* zs = (z_stream*)_zstream;
+    deflateEnd(zs);
+    delete zs;
+}
+
+void CompressedFileLogger::output(int level, const char* prefix,
+                                  const char* msg, size_t size) {
+    if (_pending.empty()) {
+        _blockTimeUs = now_us();
+    }
+    BufferedFileLogger::output(level, prefix, msg, size);
+}
+
+void CompressedFileLogger::write_block(const char* data, size_t size) {
+    auto* zs = (z_stream*)_zstream;
+    deflateReset(zs);
+
+    size_t maxSize = kMemberHeaderSize + deflateBound(zs, size) +
+                     kMemberTrailerSize;
+    if (_outBuffer.size() < maxSize) {
+        _outBuffer.resize(maxSize);
+    }
+
+    U8* out = _outBuffer.data();
+    zs->next_in = (Bytef*)data;
+    zs->avail_in = (uInt)size;
+    zs->next_out = out + kMemberHeaderSize;
+    zs->avail_out = (uInt)(maxSize - kMemberHeaderSize - kMemberTrailerSize);
+
+    int ret = deflate(zs, Z_FINISH);
+    NVCHK(ret == Z_STREAM_END, "CompressedFileLogger: deflate failed ({})",
+          ret);
+
+    size_t memberSize = kMemberHeaderSize + zs->total_out + kMemberTrailerSize;
+
+    // gzip header with our extra subfield:
+    out[0] = 0x1f;
+    out[1] = 0x8b;
+    out[2] = Z_DEFLATED;
+    out[3] = kGzipFlagExtra;
+    put_u32le(out + 4, U32(_blockTimeUs / 1000000));
+    out[8] = 0;   // XFL
+    out[9] = 255; // OS: unknown
+    put_u16le(out + 10, kNvSubfieldSize);
+    out[12] = 'N';
+    out[13] = 'V';
+    put_u16le(out + 14, 12);
+    put_u32le(out + 16, U32(memberSize));
+    put_u64le(out + 20, _blockTimeUs);
+
+    // gzip trailer:
+    U8* trailer = out + memberSize - kMemberTrailerSize;
+    put_u32le(trailer, crc32(0, (const Bytef*)data, (uInt)size));
+    put_u32le(trailer + 4, U32(size));
+
+    BufferedFileLogger::write_block((const char*)out, memberSize);
+}
+
+void CompressedFileLogger::read_blocks(const String& filename,
+                                       U64 fromTimeUs, const BlockFunc& func) {
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    NVCHK(file.is_open(), "File {} doesn't exist.", filename);
+    file.seekg(0, std::ios::end);
+    auto fileSize = (U64)file.tellg();
+
+    // Only the headers are read while looking for the first block of
+    // interest, the logs can be huge:
+    U8 header[kMemberHeaderSize];
+    auto read_header = [&](U64 pos) -> MemberInfo {
+        U64 avail = fileSize - pos;
+        file.seekg((std::streamoff)pos);
+        file.read((char*)header,
+                  (std::streamsize)minimum<U64>(avail, kMemberHeaderSize));
+        NVCHK(file.good() || avail < kMemberHeaderSize,
+              "Failed to read compressed log {}", filename);
+        return parse_member(header, avail, filename);
+    };
+
+    // A block can only be skipped if the next one already starts before
+    // fromTimeUs:
+    U64 pos = 0;
+    while (pos < fileSize) {
+        U64 next = pos + read_header(pos).size;
+        if (next >= fileSize || read_header(next).timeUs > fromTimeUs) {
+            break;
+        }
+        pos = next;
+    }
+
+    z_stream zs{};
+    NVCHK(inflateInit2(&zs, -MAX_WBITS) == Z_OK,
+          "zlib initialization failed");
+    // Released even if parse_member() or func throws:
+    auto zsGuard = std::unique_ptr<z_stream, int (*)(z_stream*)>(
+        &zs, [](z_stream* ptr) { return inflateEnd(ptr); });
+
+    U8Vector member;
+    String block;
+    while (pos < fileSize) {
+        auto info = read_header(pos);
+        member.resize(info.size);
+        file.seekg((std::streamoff)pos);
+        file.read((char*)member.data(), (std::streamsize)info.size);
+        NVCHK(file.good(), "Failed to read compressed log {}", filename);
+
+        const U8* trailer = member.data() + info.size - kMemberTrailerSize;
+        U32 origSize = get_u32le(trailer + 4);
+
+        block.resize(origSize);
+        inflateReset(&zs);
+        zs.next_in = (Bytef*)(member.data() + kMemberHeaderSize);
+        zs.avail_in =
+            (uInt)(info.size - kMemberHeaderSize - kMemberTrailerSize);
+        zs.next_out = (Bytef*)block.data();
+        zs.avail_out = (uInt)origSize;
+        int ret = inflate(&zs, Z_FINISH);
+        NVCHK(ret == Z_STREAM_END &&
+                  crc32(0, (const Bytef*)block.data(), origSize) ==
+                      get_u32le(trailer),
+              "Corrupted compressed log block in {}", filename);
+
+        func(info.timeUs, block.data(), block.size());
+        pos += info.size;
+    }
+}
+
+auto CompressedFileLogger::read_file(const String& filename, U64 fromTimeUs)
+    -> String {
+    String res;
+    read_blocks(filename, fromTimeUs,
+                [&res](U64 /*timeUs*/, const char* data, size_t size) {
+                    res.append(data, size);
+                });
+    return res;
+}
+
+} // namespace nv
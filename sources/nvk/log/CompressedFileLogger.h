@@ -0,0 +1,51 @@
+#ifndef NV_COMPRESSEDFILELOGGER_H_
+#define NV_COMPRESSEDFILELOGGER_H_
+
+#include <nvk/log/BufferedFileLogger.h>
+
+namespace nv {
+
+/**
+Buffered file sink writing its blocks as independent gzip members: the
+resulting file can be read with any gzip tool (eg. zcat app.log.gz), and each
+member carries an extra "NV" header field holding its total size and the time
+of its first line, so a reader can hop from block to block and start
+decompressing at a given time without inflating the whole file.
+Rotated segments keep the ".log.gz" extension (app.1.log.gz, ...).
+*/
+class CompressedFileLogger : public BufferedFileLogger {
+  public:
+    /** Callback receiving the decompressed content of a block with the time
+     * (in microseconds since epoch) of its first line. */
+    using BlockFunc = std::function<void(U64 timeUs, const char* data,
+                                         size_t size)>;
+
+    explicit CompressedFileLogger(const char* filename, Traits traits = {},
+                                  I32 compressionLevel = 3);
+
+    ~CompressedFileLogger() override;
+
+    void output(int level, const char* prefix, const char* msg,
+                size_t size) override;
+
+    /** Decompress all the blocks of a compressed log file that may contain
+     * lines emitted at or after fromTimeUs. */
+    static void read_blocks(const String& filename, U64 fromTimeUs,
+                            const BlockFunc& func);
+
+    /** Convenience version of read_blocks() concatenating the content. */
+    static auto read_file(const String& filename, U64 fromTimeUs = 0)
+        -> String;
+
+  protected:
+    void write_block(const char* data, size_t size) override;
+
+    I32 _compressionLevel;
+    void* _zstream{nullptr};
+    U8Vector _outBuffer;
+    U64 _blockTimeUs{0};
+};
+
+} /* namespace nv*/
+
+#endif /* NV_COMPRESSEDFILELOGGER_H_ */
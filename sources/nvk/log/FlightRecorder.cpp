@@ -0,0 +1,178 @@
+
+#include <nvk/log/FlightRecorder.h>
+
+#include <csignal>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define NV_WRITE_FD _write
+#define NV_OPEN_FD _open
+#define NV_CLOSE_FD _close
+#else
+#include <unistd.h>
+#define NV_WRITE_FD ::write
+#define NV_OPEN_FD ::open
+#define NV_CLOSE_FD ::close
+#endif
+
+namespace nv {
+
+namespace {
+
+const int fatalSignals[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#ifdef SIGBUS
+                            SIGBUS
+#endif
+};
+
+using SignalHandler = void (*)(int);
+
+// State used by the signal handler, which cannot allocate:
+std::atomic<FlightRecorder*> crashRecorder{nullptr};
+std::array<char, 1024> crashDumpFile{};
+std::array<SignalHandler, std::size(fatalSignals)> previousHandlers{};
+
+void write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        auto res = NV_WRITE_FD(fd, data, (U32)size);
+        if (res <= 0) {
+            return;
+        }
+        data += res;
+        size -= res;
+    }
+}
+
+void write_str(int fd, const char* str) { write_all(fd, str, strlen(str)); }
+
+void on_fatal_signal(int sig) {
+    // Only dump once, even if another thread crashes meanwhile:
+    auto* recorder = crashRecorder.exchange(nullptr);
+    if (recorder != nullptr) {
+        int fd = 2;
+        if (crashDumpFile[0] != '\0') {
+            fd = NV_OPEN_FD(crashDumpFile.data(), O_WRONLY | O_CREAT | O_APPEND,
+                            0644);
+            if (fd < 0) {
+                fd = 2;
+            }
+        }
+
+        write_str(fd, "==== Flight recorder dump (fatal signal) ====\n");
+        recorder->dump_to_fd(fd);
+        write_str(fd, "==== End of flight recorder dump ====\n");
+        if (fd != 2) {
+            NV_CLOSE_FD(fd);
+        }
+    }
+
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
+} // namespace
+
+FlightRecorder::FlightRecorder(U32 capacity)
+    : _capacity(capacity), _slots(new Slot[capacity]) {
+    NVCHK(capacity > 0, "Invalid flight recorder capacity");
+}
+
+FlightRecorder::~FlightRecorder() { uninstall_signal_handlers(); }
+
+void FlightRecorder::record(const char* prefix, size_t prefixSize,
+                            const char* msg, size_t size) {
+    U64 idx = _next.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = _slots[idx % _capacity];
+
+    // Mark the slot as being written:
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    constexpr size_t maxSize = NV_LOG_FLIGHT_RECORD_SIZE;
+    size_t len = minimum(prefixSize, maxSize);
+    memcpy(slot.data.data(), prefix, len);
+
+    size_t msgLen = minimum(size, maxSize - len);
+    memcpy(slot.data.data() + len, msg, msgLen);
+    len += msgLen;
+
+    if (msgLen < size) {
+        // Mark truncated lines:
+        memcpy(slot.data.data() + maxSize - 3, "...", 3);
+    }
+
+    slot.size.store((U32)len, std::memory_order_relaxed);
+    slot.seq.store(idx + 1, std::memory_order_release);
+}
+
+auto FlightRecorder::read_slot(U64 idx, char* out) const -> U32 {
+    const auto& slot = _slots[idx % _capacity];
+    if (slot.seq.load(std::memory_order_acquire) != idx + 1) {
+        return 0;
+    }
+
+    U32 size = slot.size.load(std::memory_order_relaxed);
+    memcpy(out, slot.data.data(), size);
+
+    // Discard the copy if the slot was overwritten meanwhile:
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != idx + 1) {
+        return 0;
+    }
+    return size;
+}
+
+void FlightRecorder::dump_to_fd(int fd) const {
+    for_each_line(
+        [fd](const char* data, size_t size) { write_all(fd, data, size); });
+}
+
+auto FlightRecorder::dump_to_file(const char* filename,
+                                  const char* reason) const -> bool {
+    int fd = NV_OPEN_FD(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    write_str(fd, "==== Flight recorder dump (");
+    write_str(fd, reason);
+    write_str(fd, ") ====\n");
+    dump_to_fd(fd);
+    write_str(fd, "==== End of flight recorder dump ====\n");
+    NV_CLOSE_FD(fd);
+    return true;
+}
+
+auto FlightRecorder::dump_to_string() const -> String {
+    String res;
+    for_each_line(
+        [&res](const char* data, size_t size) { res.append(data, size); });
+    return res;
+}
+
+void FlightRecorder::install_signal_handlers(const char* dumpFile) {
+    size_t len = dumpFile != nullptr ? strlen(dumpFile) : 0;
+    NVCHK(len < crashDumpFile.size(), "Flight recorder dump path too long");
+    if (len > 0) {
+        memcpy(crashDumpFile.data(), dumpFile, len);
+    }
+    crashDumpFile[len] = '\0';
+
+    if (crashRecorder.exchange(this) == nullptr) {
+        for (size_t i = 0; i < std::size(fatalSignals); ++i) {
+            previousHandlers[i] = std::signal(fatalSignals[i], on_fatal_signal);
+        }
+    }
+}
+
+void FlightRecorder::uninstall_signal_handlers() {
+    FlightRecorder* expected = this;
+    if (crashRecorder.compare_exchange_strong(expected, nullptr)) {
+        for (size_t i = 0; i < std::size(fatalSignals); ++i) {
+            std::signal(fatalSignals[i], previousHandlers[i]);
+        }
+    }
+}
+
+} // namespace nv
@@ -0,0 +1,91 @@
+#ifndef NV_FLIGHTRECORDER_H_
+#define NV_FLIGHTRECORDER_H_
+
+#include <nvk_common.h>
+
+// Max size of a recorded line (including the time/level prefix), longer
+// messages are truncated:
+#define NV_LOG_FLIGHT_RECORD_SIZE 256
+
+namespace nv {
+
+/**
+Lock-free ring buffer keeping the last log lines in memory, whatever the
+notify level, so that they can be dumped when the process fails. All the
+storage is allocated in the constructor: recording a line is a fetch_add on
+the write index and a copy into a fixed size slot. Each slot carries a
+sequence number so that readers can skip the slots being overwritten.
+*/
+class FlightRecorder : public RefObject {
+    NV_DECLARE_NO_COPY(FlightRecorder)
+    NV_DECLARE_NO_MOVE(FlightRecorder)
+
+  public:
+    explicit FlightRecorder(U32 capacity = NV_LOG_FLIGHT_RECORDER_CAPACITY);
+
+    ~FlightRecorder() override;
+
+    /** Store a line made of a prefix and a message (thread-safe). */
+    void record(const char* prefix, size_t prefixSize, const char* msg,
+                size_t size);
+
+    /** Write the recorded lines, oldest first, to a file descriptor. Only
+     * uses async-signal-safe calls, so it can be used from a signal
+     * handler. */
+    void dump_to_fd(int fd) const;
+
+    /** Append the recorded lines to a file, with a header line. */
+    auto dump_to_file(const char* filename, const char* reason) const
+        -> bool;
+
+    /** Collect the recorded lines, oldest first. */
+    [[nodiscard]] auto dump_to_string() const -> String;
+
+    [[nodiscard]] auto get_capacity() const -> U32 { return _capacity; }
+
+    /** Number of lines recorded since construction. */
+    [[nodiscard]] auto get_num_recorded() const -> U64 {
+        return _next.load(std::memory_order_relaxed);
+    }
+
+    /** Dump this recorder (to the given file, or stderr if null) when
+     * receiving SIGSEGV, SIGABRT, SIGFPE, SIGILL or SIGBUS, then re-raise
+     * the signal with its default handler. */
+    void install_signal_handlers(const char* dumpFile);
+
+    /** Restore the previous signal handlers if this recorder installed
+     * them. */
+    void uninstall_signal_handlers();
+
+  protected:
+    struct Slot {
+        // Index of the line + 1 (0 while the slot is being written)
+        std::atomic<U64> seq{0};
+        std::atomic<U32> size{0};
+        std::array<char, NV_LOG_FLIGHT_RECORD_SIZE> data;
+    };
+
+    /** Copy a slot if it still holds the line at index idx. */
+    auto read_slot(U64 idx, char* out) const -> U32;
+
+    template <typename Func> void for_each_line(Func&& func) const {
+        std::array<char, NV_LOG_FLIGHT_RECORD_SIZE + 1> line{};
+        U64 end = _next.load(std::memory_order_acquire);
+        U64 start = end > _capacity ? end - _capacity : 0;
+        for (U64 idx = start; idx < end; ++idx) {
+            U32 size = read_slot(idx, line.data());
+            if (size > 0) {
+                line[size] = '\n';
+                func(line.data(), size + 1);
+            }
+        }
+    }
+
+    U32 _capacity;
+    std::unique_ptr<Slot[]> _slots;
+    std::atomic<U64> _next{0};
+};
+
+} // namespace nv
+
+#endif
@@ -0,0 +1,62 @@
+
+#include <nvk/log/JsonLinesLogger.h>
+
+namespace nv {
+
+JsonLinesLogger::JsonLinesLogger(const char* filename, Traits traits)
+    : BufferedFileLogger(filename, traits) {}
+
+void JsonLinesLogger::output_record(const LogRecord& rec) {
+    if (_pending.empty()) {
+        _pendingSince = Clock::now();
+    }
+
+    append_record(_pending, rec);
+    check_pending(rec.level);
+}
+
+void JsonLinesLogger::append_record(String& out, const LogRecord& rec) {
+    auto outIt = std::back_inserter(out);
+
+    out += R"({"ts":")";
+    out.append(rec.timestamp);
+    out += R"(","level":")";
+    out += LogManager::get_level_name(rec.level);
+    out += R"(","msg":)";
+    log_fields::append_quoted(out, rec.message);
+
+    LogFieldReader reader(rec.fields);
+    LogField field;
+    while (reader.next(field)) {
+        out += ',';
+        log_fields::append_quoted(out, field.key);
+        out += ':';
+
+        switch (field.type) {
+        case LOG_FIELD_BOOL:
+            out += field.b ? "true" : "false";
+            break;
+        case LOG_FIELD_INT:
+            fmt::format_to(outIt, "{}", field.i);
+            break;
+        case LOG_FIELD_UINT:
+            fmt::format_to(outIt, "{}", field.u);
+            break;
+        case LOG_FIELD_FLOAT:
+            // NaN and infinities have no JSON representation:
+            if (std::isfinite(field.f)) {
+                fmt::format_to(outIt, "{}", field.f);
+            } else {
+                out += "null";
+            }
+            break;
+        case LOG_FIELD_STRING:
+            log_fields::append_quoted(out, field.str);
+            break;
+        }
+    }
+
+    out += "}\n";
+}
+
+} // namespace nv
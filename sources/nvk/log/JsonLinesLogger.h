@@ -0,0 +1,29 @@
+#ifndef NV_JSONLINESLOGGER_H_
+#define NV_JSONLINESLOGGER_H_
+
+#include <nvk/log/BufferedFileLogger.h>
+
+namespace nv {
+
+/**
+Buffered file sink writing one JSON object per message (JSON lines), eg:
+  {"ts":"2024-05-02 10:12:01.123456","level":"info","msg":"tile loaded",
+   "tile":12,"ms":3.5}
+The records are serialized directly from the encoded fields (cf. LogFields.h)
+on the logger thread, without building any Json document.
+*/
+class JsonLinesLogger : public BufferedFileLogger {
+  public:
+    explicit JsonLinesLogger(const char* filename, Traits traits = {});
+
+    [[nodiscard]] auto wants_records() const -> bool override { return true; }
+
+    void output_record(const LogRecord& rec) override;
+
+    /** Append the JSON line for a record (with its newline) to a string */
+    static void append_record(String& out, const LogRecord& rec);
+};
+
+} /* namespace nv*/
+
+#endif /* NV_JSONLINESLOGGER_H_ */
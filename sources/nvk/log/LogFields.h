@@ -0,0 +1,220 @@
+#ifndef NV_LOGFIELDS_H_
+#define NV_LOGFIELDS_H_
+
+#include <nvk_common.h>
+
+#include <fmt/format.h>
+
+namespace nv {
+
+enum LogFieldType : U8 {
+    LOG_FIELD_BOOL,
+    LOG_FIELD_INT,
+    LOG_FIELD_UINT,
+    LOG_FIELD_FLOAT,
+    LOG_FIELD_STRING,
+};
+
+/** Decoded key/value field of a structured log record */
+struct LogField {
+    std::string_view key;
+    LogFieldType type{LOG_FIELD_BOOL};
+    union {
+        bool b;
+        I64 i;
+        U64 u;
+        F64 f;
+    };
+    std::string_view str;
+};
+
+/**
+Structured log records keep their key/value fields in a compact binary
+encoding next to the message text, so that the structured sinks can
+serialize them on the logger thread with their original types:
+    [U8 type][U8 key size][key][value]
+where the value is 1 byte for bools, 8 bytes for numbers, or a U32 size
+followed by the characters for strings. Any other formattable type is
+stored as a string.
+*/
+namespace log_fields {
+
+template <typename T>
+void append_raw(fmt::memory_buffer& out, const T& value) {
+    const auto* ptr = (const char*)&value;
+    out.append(ptr, ptr + sizeof(T));
+}
+
+inline void append_header(fmt::memory_buffer& out, LogFieldType type,
+                          std::string_view key) {
+    U8 keySize = (U8)minimum(key.size(), (size_t)255);
+    out.push_back((char)type);
+    out.push_back((char)keySize);
+    out.append(key.data(), key.data() + keySize);
+}
+
+inline void append_string(fmt::memory_buffer& out, std::string_view key,
+                          std::string_view value) {
+    append_header(out, LOG_FIELD_STRING, key);
+    append_raw(out, (U32)value.size());
+    out.append(value.data(), value.data() + value.size());
+}
+
+/** Append a quoted string, escaped as per the JSON rules. */
+template <typename Out> void append_quoted(Out& out, std::string_view str) {
+    constexpr const char* hexDigits = "0123456789abcdef";
+    out.push_back('"');
+    size_t start = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        auto c = (U8)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        out.append(str.data() + start, str.data() + i);
+        start = i + 1;
+        out.push_back('\\');
+        switch (c) {
+        case '"':
+        case '\\':
+            out.push_back((char)c);
+            break;
+        case '\n':
+            out.push_back('n');
+            break;
+        case '\r':
+            out.push_back('r');
+            break;
+        case '\t':
+            out.push_back('t');
+            break;
+        default:
+            out.push_back('u');
+            out.push_back('0');
+            out.push_back('0');
+            out.push_back(hexDigits[c >> 4]);
+            out.push_back(hexDigits[c & 0xF]);
+        }
+    }
+    out.append(str.data() + start, str.data() + str.size());
+    out.push_back('"');
+}
+
+/** Strings are quoted in the text rendering if needed (logfmt style) */
+inline void render_string(fmt::memory_buffer& text, std::string_view value) {
+    if (!value.empty() &&
+        value.find_first_of(" =\"\t\n") == std::string_view::npos) {
+        text.append(value.data(), value.data() + value.size());
+        return;
+    }
+    append_quoted(text, value);
+}
+
+/** Append a field to both the text rendering (" key=value") and the
+ * binary encoding. */
+template <typename T>
+void append(fmt::memory_buffer& text, fmt::memory_buffer& out,
+            std::string_view key, const T& value) {
+    using V = std::decay_t<T>;
+
+    text.push_back(' ');
+    text.append(key.data(), key.data() + key.size());
+    text.push_back('=');
+
+    if constexpr (std::is_same_v<V, bool>) {
+        append_header(out, LOG_FIELD_BOOL, key);
+        out.push_back(value ? 1 : 0);
+        fmt::format_to(std::back_inserter(text), "{}", value);
+    } else if constexpr (std::is_enum_v<V> ||
+                         (std::is_integral_v<V> && std::is_signed_v<V>)) {
+        append_header(out, LOG_FIELD_INT, key);
+        append_raw(out, (I64)value);
+        fmt::format_to(std::back_inserter(text), "{}", (I64)value);
+    } else if constexpr (std::is_integral_v<V>) {
+        append_header(out, LOG_FIELD_UINT, key);
+        append_raw(out, (U64)value);
+        fmt::format_to(std::back_inserter(text), "{}", value);
+    } else if constexpr (std::is_floating_point_v<V>) {
+        append_header(out, LOG_FIELD_FLOAT, key);
+        append_raw(out, (F64)value);
+        fmt::format_to(std::back_inserter(text), "{}", value);
+    } else if constexpr (std::is_convertible_v<const V&, std::string_view>) {
+        std::string_view str(value);
+        append_string(out, key, str);
+        render_string(text, str);
+    } else {
+        auto str = fmt::format("{}", value);
+        append_string(out, key, str);
+        render_string(text, str);
+    }
+}
+
+inline void append_all(fmt::memory_buffer& /*text*/,
+                       fmt::memory_buffer& /*out*/) {}
+
+template <typename T, typename... Rest>
+void append_all(fmt::memory_buffer& text, fmt::memory_buffer& out,
+                std::string_view key, const T& value, Rest&&... rest) {
+    append(text, out, key, value);
+    append_all(text, out, std::forward<Rest>(rest)...);
+}
+
+} // namespace log_fields
+
+/** Iterate over the fields of an encoded block. */
+class LogFieldReader {
+  public:
+    explicit LogFieldReader(std::string_view data) : _data(data) {}
+
+    /** Decode the next field, returns false at the end of the block. */
+    auto next(LogField& field) -> bool {
+        if (_pos + 2 > _data.size()) {
+            return false;
+        }
+
+        field.type = (LogFieldType)_data[_pos];
+        U8 keySize = (U8)_data[_pos + 1];
+        field.key = _data.substr(_pos + 2, keySize);
+        _pos += 2 + keySize;
+
+        switch (field.type) {
+        case LOG_FIELD_BOOL:
+            field.b = _data[_pos++] != 0;
+            break;
+        case LOG_FIELD_INT:
+            read_raw(field.i);
+            break;
+        case LOG_FIELD_UINT:
+            read_raw(field.u);
+            break;
+        case LOG_FIELD_FLOAT:
+            read_raw(field.f);
+            break;
+        case LOG_FIELD_STRING: {
+            U32 size = 0;
+            read_raw(size);
+            field.str = _data.substr(_pos, size);
+            _pos += size;
+            break;
+        }
+        default:
+            // Invalid block:
+            _pos = _data.size();
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    template <typename T> void read_raw(T& value) {
+        memcpy((void*)&value, _data.data() + _pos, sizeof(T));
+        _pos += sizeof(T);
+    }
+
+    std::string_view _data;
+    size_t _pos{0};
+};
+
+} // namespace nv
+
+#endif
@@ -1,6 +1,10 @@
 // Implementation for LogManager
 
+#include <nvk/log/BufferedFileLogger.h>
+#include <nvk/log/CompressedFileLogger.h>
 #include <nvk/log/FileLogger.h>
+#include <nvk/log/FlightRecorder.h>
+#include <nvk/log/JsonLinesLogger.h>
 #include <nvk/log/LogManager.h>
 #include <nvk/log/StdLogger.h>
 #include <nvk/utils.h>
@@ -19,8 +23,38 @@ constexpr const char* logLevelStrings[] = {"[FATAL] ", "[ERROR] ", "[WARN] ",
                                            "[TRACE] ", "[???] "};
 constexpr const int logLevelLens[] = {8, 8, 7, 7, 7, 8, 8, 6};
 
+// Level names as used in the configuration files:
+constexpr const char* logLevelNames[] = {"fatal", "error", "warn", "note",
+                                         "info",  "debug", "trace"};
+
+// Names of the backpressure policies as used in the configuration files:
+constexpr const char* backpressureNames[] = {"block", "drop_newest",
+                                             "drop_low_levels",
+                                             "drop_queued"};
+
+// Names of the built-in categories (cf. nv::LogCat):
+constexpr const char* builtinCategoryNames[] = {
+    "core", "resource", "pcg", "ipc", "gltf", "io", "sim", "task", "render"};
+
+static_assert(std::size(builtinCategoryNames) == LogCat::NUM_BUILTIN,
+              "Missing built-in log category name");
+static_assert(LogManager::L_FATAL == NV_LOG_LEVEL_FATAL &&
+                  LogManager::L_INFO == NV_LOG_LEVEL_INFO &&
+                  LogManager::L_TRACE == NV_LOG_LEVEL_TRACE,
+              "Log level macros out of sync with LogManager::Level");
+
+template <typename T>
+static void update_max(std::atomic<T>& target, T value) {
+    T prev = target.load(std::memory_order_relaxed);
+    while (prev < value &&
+           !target.compare_exchange_weak(prev, value,
+                                         std::memory_order_relaxed)) {
+    }
+}
+
 struct ThreadData {
     fmt::memory_buffer buffer;
+    fmt::memory_buffer fields;
     std::string str;
 };
 
@@ -32,9 +66,17 @@ LogManager::LogManager()
 #if NV_USE_LOG_THREAD
     : _msgQueue(NV_LOG_MSG_QUEUE_CAPACITY),
       _msgConsumerToken(moodycamel::ConsumerToken(_msgQueue)),
-      _recycleProducerToken(moodycamel::ProducerToken(_recycleQueue))
+      _recycleProducerToken(moodycamel::ProducerToken(_recycleQueue)),
+      _msgArray(NV_LOG_MSG_QUEUE_CAPACITY)
 #endif
-{};
+{
+    for (auto& lvl : _categoryLevels) {
+        lvl.store(-1, std::memory_order_relaxed);
+    }
+    for (const auto* name : builtinCategoryNames) {
+        get_category_id(name);
+    }
+};
 
 LogManager::~LogManager() = default;
 
@@ -47,7 +89,6 @@ void LogManager::logger_thread() {
     std::vector<MsgTag> mtags(maxNumStrings);
 
     U32 lastNumQueuedStrings = 0;
-    U32 lastMaxCount = 0;
 
     while (true) {
         // if (!_msgQueue.wait_dequeue_timed(_msgConsumerToken, msg, 200)) {
@@ -60,10 +101,12 @@ void LogManager::logger_thread() {
 
         // U32 count = _msgQueue.wait_dequeue_bulk_timed(
         //     _msgConsumerToken, mtags.data(), maxNumStrings, 200);
-        U32 count = _msgQueue.wait_dequeue_bulk(_msgConsumerToken, mtags.data(),
-                                                maxNumStrings);
+        U32 count = _msgQueue.wait_dequeue_bulk_timed(
+            _msgConsumerToken, mtags.data(), maxNumStrings,
+            std::chrono::milliseconds(NV_LOG_IDLE_POLL_PERIOD_MS));
 
         if (count == 0) {
+            poll_sinks();
             continue;
         };
 
@@ -86,17 +129,15 @@ void LogManager::logger_thread() {
         }
 
         // Check if we have increased the count:
-        if (count > lastMaxCount) {
-            lastMaxCount = count;
-            // std::cout << "====> Max dequeue bulk count: " << count <<
-            // std::endl;
-        }
+        update_max(_maxBatchSize, count);
 
-        // Concatenate all the strings in a single large buffer:
+        // Concatenate all the strings in a single large buffer, and keep
+        // track of the most severe level in that batch:
         U32 tsize = 0;
+        U32 batchLevel = L_TRACE;
         for (U32 i = 0; i < count; ++i) {
-            U32 idx = mtags[i].index;
-            tsize += _msgArray[idx].size();
+            tsize += mtags[i].textEnd;
+            batchLevel = minimum(batchLevel, mtags[i].level);
         }
 
         // Add space for the newline character:
@@ -113,18 +154,32 @@ void LogManager::logger_thread() {
         buffer.clear();
         for (U32 i = 0; i < count; ++i) {
             U32 idx = mtags[i].index;
-            buffer += _msgArray[idx];
+            buffer.append(_msgArray[idx].data(), mtags[i].textEnd);
             if (i < (count - 1)) {
                 // Add the newline:
                 buffer += '\n';
             }
         }
 
+        // The structured sinks read the records from the slots directly:
+        if (_numRecordSinks > 0) {
+            WITH_NV_MUTEXLOCK(_logMutex);
+            for (U32 i = 0; i < count; ++i) {
+                const auto& mtag = mtags[i];
+                output_record(mtag.level, _msgArray[mtag.index], mtag.msgEnd,
+                              mtag.textEnd);
+            }
+        }
+
         // recycle the strings:
         _recycleQueue.enqueue_bulk(_recycleProducerToken, mtags.data(), count);
+        _freeSlots.signal((int)count);
 
         // We have a string to output:
-        output_message(0, buffer);
+        {
+            WITH_NV_MUTEXLOCK(_logMutex);
+            output_message(batchLevel, buffer);
+        }
 
         // Update the count of pending messages:
         _numPendingMessages.fetch_sub(count, std::memory_order_release);
@@ -182,6 +237,10 @@ auto LogManager::get_output_string() -> std::string& {
 #endif
 }
 
+auto LogManager::get_fields_buffer() -> fmt::memory_buffer& {
+    return threadData.fields;
+}
+
 auto LogManager::get_mem_buffer() -> fmt::memory_buffer& {
 #if 1
     return threadData.buffer;
@@ -206,17 +265,19 @@ auto LogManager::get_mem_buffer() -> fmt::memory_buffer& {
 #endif
 }
 
-void LogManager::do_log(U32 lvl, const char* data, size_t size) {
+void LogManager::do_log(U32 lvl, const char* data, size_t size, bool emit,
+                        size_t msgSize, std::string_view fields) {
+
+    auto* recorder = (int)lvl <= _recordLevel ? get_flight_recorder() : nullptr;
 
     // Stop processing only if redirect function returns true:
-    if (_redirectFn != nullptr && _redirectFn(lvl, data, size)) {
-        return;
+    if (emit && _redirectFn != nullptr && _redirectFn(lvl, data, size)) {
+        emit = false;
     }
 
-    // Try to send that message to the logger thread:
-#if NV_USE_LOG_THREAD
-    _numPendingMessages.fetch_add(1, std::memory_order_release);
-#endif
+    if (!emit && recorder == nullptr) {
+        return;
+    }
 
     std::array<char, 40> buf = {0};
 
@@ -260,35 +321,33 @@ void LogManager::do_log(U32 lvl, const char* data, size_t size) {
 
     lvl = minimum(lvl, 7U);
     memcpy((char*)&buf[27], logLevelStrings[lvl], logLevelLens[lvl]);
+    U32 prefixSize = 27 + logLevelLens[lvl];
+
+    if (recorder != nullptr) {
+        recorder->record(buf.data(), prefixSize, data, size);
+    }
+
+    if (!emit) {
+        return;
+    }
+
+    U32 msgEnd = prefixSize + (U32)minimum(msgSize, size);
+    U32 textEnd = prefixSize + (U32)size;
 
 #if NV_USE_LOG_THREAD
     // If using the log thread we first try to recycle the memory from a
     // previously used string:
     MsgTag mtag{};
+    if (!acquire_slot(lvl, mtag)) {
+        return; // Dropped.
+    }
 
-    if (!_recycleQueue.try_dequeue_from_producer(_recycleProducerToken, mtag)) {
-        // There is no MsgTag ready for dequeueing yet, so we check if we are
-        // already at full capacity, or if we can start using a remaining unused
-        // slot:
-        if (_numQueuedStrings.load() == NV_LOG_MSG_QUEUE_CAPACITY) {
-            // All slots are used so we must really wait until one becomes free:
-            std::cout
-                << "LogManager: =========> All string slots in use, waiting."
-                << std::endl;
-            while (!_recycleQueue.try_dequeue_from_producer(
-                _recycleProducerToken, mtag))
-                ;
+    _numPendingMessages.fetch_add(1, std::memory_order_release);
 
-        } else {
-            // We can start using an unused slot increasing the count of "in
-            // flight strings"
-            mtag.index = _numQueuedStrings.fetch_add(1);
-            // std::cout << "==========> Num queued strings: "
-            //           << _numQueuedStrings.load(std::memory_order_acquire)
-            //           << std::endl;
-            // std::cout.flush();
-        }
-    }
+    // Track the queue occupancy (slots used so far minus released ones):
+    U32 numUsed = _numQueuedStrings.load(std::memory_order_relaxed);
+    update_max(_highWaterMark,
+               numUsed - minimum(numUsed, (U32)_freeSlots.availableApprox()));
 
     auto& str = _msgArray[mtag.index];
 
@@ -301,7 +360,7 @@ void LogManager::do_log(U32 lvl, const char* data, size_t size) {
     // Note: whether the dequeue operation was successfull or not should not be
     // relevant here: if there is nothing to dequeue, we just use the string as
     // is (eg. allocating some additional memory for it)
-    U32 tsize = strlen(buf.data()) + size;
+    U32 tsize = textEnd + fields.size();
     if (str.capacity() < tsize) {
         // std::cout << "==========> Increasing string capacity to " << tsize
         //           << std::endl;
@@ -315,16 +374,20 @@ void LogManager::do_log(U32 lvl, const char* data, size_t size) {
     str.clear();
     str += buf.data();
     str.append(data, size);
+    str.append(fields.data(), fields.size());
 
     // Update the timetag:
     mtag.timetag = _timeTag.fetch_add(1);
+    mtag.level = lvl;
+    mtag.msgEnd = msgEnd;
+    mtag.textEnd = textEnd;
 
     while (!_msgQueue.enqueue(mtag))
         ;
 
 #else
     auto& str = get_output_string();
-    str.reserve(strlen(buf.data()) + size);
+    str.reserve(textEnd + fields.size());
     str.clear();
     str += buf.data();
     str.append(data, size);
@@ -333,12 +396,70 @@ void LogManager::do_log(U32 lvl, const char* data, size_t size) {
     // Note: on emscripten it seems preferable to use a regular mutex instead of
     // a spinlock. WITH_NV_SPINLOCK(_logSP);
     WITH_NV_MUTEXLOCK(_logMutex);
+    if (_numRecordSinks > 0) {
+        str.append(fields.data(), fields.size());
+        output_record(lvl, str, msgEnd, textEnd);
+        str.resize(textEnd);
+    }
     output_message(lvl, str);
 #endif
 
     // std::cout.write(data, (std::streamsize)size) << std::endl;
 }
 
+#if NV_USE_LOG_THREAD
+void LogManager::take_recycled_slot(MsgTag& mtag) {
+    // The slot was enqueued before the permit was signaled, so this can only
+    // fail transiently:
+    while (!_recycleQueue.try_dequeue_from_producer(_recycleProducerToken,
+                                                    mtag))
+        ;
+}
+
+auto LogManager::acquire_slot(U32 lvl, MsgTag& mtag) -> bool {
+    if (_freeSlots.tryWait()) {
+        take_recycled_slot(mtag);
+        return true;
+    }
+
+    // Start using one of the slots never used so far:
+    U32 num = _numQueuedStrings.load(std::memory_order_relaxed);
+    while (num < _queueCapacity) {
+        if (_numQueuedStrings.compare_exchange_weak(num, num + 1)) {
+            mtag.index = num;
+            return true;
+        }
+    }
+
+    // All the slots are in flight:
+    switch (_backpressure) {
+    case BP_DROP_NEWEST:
+        _numDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    case BP_DROP_LOW_LEVELS:
+        if ((int)lvl > _backpressureLevel) {
+            _numDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        break;
+    case BP_DROP_QUEUED:
+        if (_msgQueue.try_dequeue(mtag)) {
+            _numPendingMessages.fetch_sub(1, std::memory_order_release);
+            _numDropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    _numBlocked.fetch_add(1, std::memory_order_relaxed);
+    _freeSlots.wait();
+    take_recycled_slot(mtag);
+    return true;
+}
+#endif
+
 void LogManager::output_message(U32 lvl, const std::string& msg) {
 
     if (_sinks.empty()) {
@@ -347,13 +468,272 @@ void LogManager::output_message(U32 lvl, const std::string& msg) {
 
     for (auto& sink : _sinks) {
         // sink->output(lvl, buf.data(), data, size);
-        sink->output((I32)lvl, nullptr, msg.data(), msg.size());
+        if (!sink->wants_records()) {
+            sink->output((I32)lvl, nullptr, msg.data(), msg.size());
+        }
+    }
+}
+
+void LogManager::output_record(U32 lvl, const std::string& str, U32 msgEnd,
+                               U32 textEnd) {
+    U32 prefixSize = 27 + logLevelLens[lvl];
+    std::string_view view(str);
+
+    LogRecord rec;
+    rec.level = (int)lvl;
+    rec.timestamp = view.substr(0, 26);
+    rec.message = view.substr(prefixSize, msgEnd - prefixSize);
+    rec.fields = view.substr(textEnd);
+
+    for (auto& sink : _sinks) {
+        if (sink->wants_records()) {
+            sink->output_record(rec);
+        }
+    }
+}
+
+void LogManager::poll_sinks() {
+    WITH_NV_MUTEXLOCK(_logMutex);
+    for (auto& sink : _sinks) {
+        sink->poll();
+    }
+}
+
+void LogManager::flush() {
+    while (!is_idle()) {
+        sleep_ms(1);
+    }
+
+    WITH_NV_MUTEXLOCK(_logMutex);
+    for (auto& sink : _sinks) {
+        sink->flush();
+    }
+}
+
+void LogManager::set_category_level(U32 cat, int lvl) {
+    NVCHK(cat < NV_LOG_MAX_CATEGORIES, "Invalid log category {}", cat);
+    _categoryLevels[cat].store(lvl, std::memory_order_relaxed);
+}
+
+auto LogManager::get_category_id(const String& name) -> U32 {
+    WITH_NV_MUTEXLOCK(_categoryMutex);
+    for (U32 i = 0; i < _numCategories; ++i) {
+        if (_categoryNames[i] == name) {
+            return i;
+        }
+    }
+
+    NVCHK(_numCategories < NV_LOG_MAX_CATEGORIES,
+          "Cannot register log category {}: too many categories.", name);
+    U32 cat = _numCategories++;
+    _categoryNames[cat] = name;
+    _categoryTags[cat] = format_msg("[{}] ", name);
+    return cat;
+}
+
+auto LogManager::get_category_name(U32 cat) const -> const String& {
+    NVCHK(cat < _numCategories, "Invalid log category {}", cat);
+    return _categoryNames[cat];
+}
+
+auto LogManager::parse_level(const Json& value) -> int {
+    if (value.is_number_integer()) {
+        return clamp(value.get<int>(), (int)L_FATAL, (int)L_TRACE);
+    }
+
+    NVCHK(value.is_string(), "Invalid log level: {}", value.dump());
+    auto name = to_lower(value.get<String>());
+    for (int i = 0; i <= L_TRACE; ++i) {
+        if (name == logLevelNames[i]) {
+            return i;
+        }
+    }
+    if (name == "default" || name == "inherit") {
+        return -1;
+    }
+
+    THROW_MSG("Invalid log level name: {}", name);
+    return L_INFO;
+}
+
+auto LogManager::get_level_name(int lvl) -> const char* {
+    return lvl >= 0 && lvl <= L_TRACE ? logLevelNames[lvl] : "unknown";
+}
+
+void LogManager::configure(const Json& config) {
+    // Accept either the log section itself or a document containing it:
+    const Json& cfg = config.contains("log") ? config["log"] : config;
+
+    if (cfg.contains("level")) {
+        int lvl = parse_level(cfg["level"]);
+        NVCHK(lvl >= 0, "Invalid global log level.");
+        set_notify_level((Level)lvl);
     }
+
+    if (cfg.contains("queue_capacity")) {
+        auto capacity = cfg["queue_capacity"].get<U32>();
+#if NV_USE_LOG_THREAD
+        if (capacity != _queueCapacity &&
+            _numQueuedStrings.load(std::memory_order_acquire) > 0) {
+            logWARN("Ignoring log queue_capacity {}: logging already started.",
+                    capacity);
+        } else {
+            set_queue_capacity(capacity);
+        }
+#else
+        set_queue_capacity(capacity);
+#endif
+    }
+
+    if (cfg.contains("backpressure")) {
+        auto name = to_lower(cfg["backpressure"].get<String>());
+        auto it = std::find(std::begin(backpressureNames),
+                            std::end(backpressureNames), name);
+        NVCHK(it != std::end(backpressureNames),
+              "Invalid log backpressure policy: {}", name);
+        int keepLevel = cfg.contains("backpressure_level")
+                            ? parse_level(cfg["backpressure_level"])
+                            : (int)L_WARN;
+        set_backpressure(
+            (Backpressure)std::distance(std::begin(backpressureNames), it),
+            keepLevel);
+    }
+
+    if (cfg.contains("flight_recorder") && get_flight_recorder() == nullptr) {
+        const auto& rec = cfg["flight_recorder"];
+        enable_flight_recorder(
+            rec.value("capacity", (U32)NV_LOG_FLIGHT_RECORDER_CAPACITY),
+            rec.contains("level") ? parse_level(rec["level"]) : (int)L_DEBUG,
+            rec.value("file", String()), rec.value("dump_on_error", true),
+            rec.value("handle_signals", true));
+    }
+
+    if (cfg.contains("categories")) {
+        for (const auto& [name, lvl] : cfg["categories"].items()) {
+            set_category_level(get_category_id(name), parse_level(lvl));
+        }
+    }
+}
+
+void LogManager::configure_from_file(const String& fname) {
+    configure(read_config_file(fname, true));
+}
+
+auto LogManager::get_rate_limiter(StringID logId,
+                                  std::chrono::milliseconds period)
+    -> LogRateLimiter& {
+    WITH_NV_MUTEXLOCK(_rateLimitersMutex);
+    auto& limiter = _rateLimiters[logId];
+    if (limiter == nullptr) {
+        limiter = std::make_unique<LogRateLimiter>(period);
+    }
+    return *limiter;
+}
+
+void LogManager::enable_flight_recorder(U32 capacity, int level,
+                                        const String& dumpFile,
+                                        bool dumpOnError, bool handleSignals) {
+    NVCHK(get_flight_recorder() == nullptr,
+          "Flight recorder already enabled.");
+
+    _flightRecorderRef = new FlightRecorder(capacity);
+    _flightRecorderFile = dumpFile;
+    _dumpOnError = dumpOnError;
+    if (handleSignals) {
+        _flightRecorderRef->install_signal_handlers(dumpFile.c_str());
+    }
+
+    _flightRecorder.store(_flightRecorderRef.get(), std::memory_order_release);
+    _recordLevel = level;
+    update_capture_level();
+}
+
+void LogManager::disable_flight_recorder() {
+    _recordLevel = -1;
+    update_capture_level();
+    _dumpOnError = false;
+    if (_flightRecorderRef != nullptr) {
+        _flightRecorderRef->uninstall_signal_handlers();
+    }
+}
+
+void LogManager::dump_flight_recorder(const char* reason) {
+    auto* recorder = get_flight_recorder();
+    if (recorder == nullptr) {
+        return;
+    }
+
+    if (_flightRecorderFile.empty() ||
+        !recorder->dump_to_file(_flightRecorderFile.c_str(), reason)) {
+        std::cerr << "==== Flight recorder dump (" << reason << ") ====\n"
+                  << recorder->dump_to_string()
+                  << "==== End of flight recorder dump ====" << std::endl;
+    }
+}
+
+void LogManager::on_fatal_error() {
+    if (_dumpOnError) {
+        dump_flight_recorder("fatal error");
+    }
+}
+
+void LogManager::set_backpressure(Backpressure policy, int keepLevel) {
+    _backpressure = policy;
+    _backpressureLevel = keepLevel;
+}
+
+void LogManager::set_queue_capacity(U32 capacity) {
+    NVCHK(capacity > 0, "Invalid log queue capacity.");
+#if NV_USE_LOG_THREAD
+    if (capacity == _queueCapacity) {
+        return;
+    }
+
+    // The producers access the slots without locking: the storage can only be
+    // replaced before the first slot is taken.
+    NVCHK(_numQueuedStrings.load(std::memory_order_acquire) == 0,
+          "The log queue capacity cannot change once logging has started.");
+
+    _msgArray.clear();
+    _msgArray.resize(capacity);
+    _msgArray.shrink_to_fit();
+    _queueCapacity = capacity;
+#endif
+}
+
+auto LogManager::get_queue_stats() const -> QueueStats {
+    QueueStats stats;
+#if NV_USE_LOG_THREAD
+    stats.capacity = _queueCapacity;
+    stats.numPending = _numPendingMessages.load(std::memory_order_acquire);
+    stats.highWaterMark = _highWaterMark.load(std::memory_order_relaxed);
+    stats.maxBatchSize = _maxBatchSize.load(std::memory_order_relaxed);
+    stats.numDropped = _numDropped.load(std::memory_order_relaxed);
+    stats.numBlocked = _numBlocked.load(std::memory_order_relaxed);
+#endif
+    return stats;
+}
+
+void LogManager::reset_queue_stats() {
+#if NV_USE_LOG_THREAD
+    _highWaterMark.store(0, std::memory_order_relaxed);
+    _maxBatchSize.store(0, std::memory_order_relaxed);
+    _numDropped.store(0, std::memory_order_relaxed);
+    _numBlocked.store(0, std::memory_order_relaxed);
+#endif
 }
 
 auto LogManager::remove_sink(LogSink* sink) -> bool {
     NVCHK(sink != nullptr, "Invalid log sink");
-    return remove_vector_element(_sinks, sink);
+    // Note: the sink may be destroyed when removed from the list:
+    bool wantsRecords = sink->wants_records();
+    if (!remove_vector_element(_sinks, sink)) {
+        return false;
+    }
+    if (wantsRecords) {
+        --_numRecordSinks;
+    }
+    return true;
 }
 
 void LogManager::set_redirect_func(RedirectFunc func) {
@@ -372,4 +752,22 @@ void LogManager::setup_log_file(const char* filename, bool withStdout,
     add_sink(new FileLogger(filename, append));
 }
 
+void LogManager::setup_buffered_log_file(const char* filename,
+                                         const BufferedFileLoggerTraits& traits,
+                                         bool withStdout) {
+    if (withStdout) {
+        add_sink(new StdLogger());
+    }
+    // Use a compressed sink for gzip outputs, and a structured sink for
+    // JSON lines outputs:
+    auto ext = get_file_extension(filename);
+    if (ext == ".gz") {
+        add_sink(new CompressedFileLogger(filename, traits));
+    } else if (ext == ".jsonl") {
+        add_sink(new JsonLinesLogger(filename, traits));
+    } else {
+        add_sink(new BufferedFileLogger(filename, traits));
+    }
+}
+
 } // namespace nv
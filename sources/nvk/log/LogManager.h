@@ -10,18 +10,54 @@
 #include <nvk/base/RefPtr.h>
 #include <nvk/base/SpinLock.h>
 #include <nvk/base/std_containers.h>
+#include <nvk/log/LogFields.h>
+#include <nvk/log/LogRateLimiter.h>
 #include <nvk/log/LogSink.h>
 
+// Default number of message slots in flight between the logging threads and
+// the logger thread (cf. LogManager::set_queue_capacity()):
 #define NV_LOG_MSG_QUEUE_CAPACITY 1024
 
+// Period (in ms) at which the sinks are polled when no message is pending:
+#define NV_LOG_IDLE_POLL_PERIOD_MS 100
+
+// Max number of log categories (built-in + registered ones):
+#define NV_LOG_MAX_CATEGORIES 64
+
+// Default number of lines kept by the flight recorder:
+#define NV_LOG_FLIGHT_RECORDER_CAPACITY 4096
+
 namespace nv {
 
+struct BufferedFileLoggerTraits;
+class FlightRecorder;
+
 template <typename T> struct is_vector : std::false_type {};
 
 template <typename U> struct is_vector<Vector<U>> : std::true_type {};
 
 template <typename T> inline constexpr bool is_vector_v = is_vector<T>::value;
 
+// Built-in log categories, used with the logXXX_CAT() macros. Applications
+// can add their own categories with LogManager::get_category_id(), eg:
+//   namespace nv::LogCat {
+//   inline const U32 myapp = LogManager::instance().get_category_id("myapp");
+//   }
+namespace LogCat {
+enum : U32 {
+    core,
+    resource,
+    pcg,
+    ipc,
+    gltf,
+    io,
+    sim,
+    task,
+    render,
+    NUM_BUILTIN,
+};
+} // namespace LogCat
+
 class LogManager {
     NV_DECLARE_RAW_INSTANCE(LogManager)
 
@@ -40,19 +76,164 @@ class LogManager {
         L_TRACE,
     };
 
-    void set_notify_level(Level lvl) { _notifyLevel = lvl; }
+    /** What to do when all the message slots are in flight */
+    enum Backpressure : U8 {
+        // Wait until the logger thread releases a slot.
+        BP_BLOCK,
+        // Discard the message being logged.
+        BP_DROP_NEWEST,
+        // Discard the messages less severe than the backpressure level, and
+        // block for the others.
+        BP_DROP_LOW_LEVELS,
+        // Discard a queued message (not yet picked up by the logger thread)
+        // and reuse its slot, blocking if there is none. The queue is only
+        // ordered per producer thread: the discarded message is the oldest one
+        // of some producer, not necessarily the oldest overall.
+        BP_DROP_QUEUED,
+    };
+
+    struct QueueStats {
+        // Number of message slots.
+        U32 capacity{0};
+        // Messages currently queued or being written.
+        U32 numPending{0};
+        // Max number of message slots in use observed.
+        U32 highWaterMark{0};
+        // Max number of messages written in a single batch.
+        U32 maxBatchSize{0};
+        // Messages discarded by the backpressure policy.
+        U64 numDropped{0};
+        // Messages that had to wait for a free slot.
+        U64 numBlocked{0};
+    };
+
+    void set_notify_level(Level lvl) {
+        _notifyLevel = lvl;
+        update_capture_level();
+    }
+
+    /** Check if a message at the given level should be emitted */
+    auto is_enabled(int lvl) const -> bool { return lvl <= _notifyLevel; }
+
+    /** Check if a message at the given level reaches the sinks or the flight
+     * recorder. */
+    auto is_captured(int lvl) const -> bool { return lvl <= _captureLevel; }
+
+    /** Check if a message at the given level should be formatted for a
+     * category: categories without a specific level follow the global notify
+     * level, and the flight recorder may capture more verbose messages. */
+    auto is_enabled(int lvl, U32 cat) const -> bool {
+        return lvl <= get_category_level(cat) || lvl <= _recordLevel;
+    }
+
+    /** Effective notify level of a category */
+    auto get_category_level(U32 cat) const -> int {
+        int catLevel = _categoryLevels[cat].load(std::memory_order_relaxed);
+        return catLevel >= 0 ? catLevel : _notifyLevel;
+    }
+
+    /** Assign a specific level to a category (or -1 to follow the global
+     * notify level again) */
+    void set_category_level(U32 cat, int lvl);
+
+    /** Find a category by name, registering it if needed. */
+    auto get_category_id(const String& name) -> U32;
+
+    auto get_category_name(U32 cat) const -> const String&;
+
+    /** Apply a logging configuration, such as:
+        log:
+          level: info
+          categories:
+            pcg: debug
+            ipc: warn
+          queue_capacity: 4096
+          backpressure: drop_low_levels # or block, drop_newest,
+                                        # drop_queued
+          backpressure_level: warn
+          flight_recorder:
+            capacity: 4096
+            level: debug
+            file: crash_context.log
+    */
+    void configure(const Json& config);
+
+    /** Load a logging configuration from a yaml/json file. */
+    void configure_from_file(const String& fname);
+
+    /** Convert a level name ("debug", "WARN", ...) or number to a level. */
+    static auto parse_level(const Json& value) -> int;
+
+    /** Lower case name of a level ("info", "debug", ...) */
+    static auto get_level_name(int lvl) -> const char*;
+
+    template <typename... Args>
+    void log_cat(int lvl, U32 cat, fmt::format_string<Args...> fmt_str,
+                 Args&&... args) {
+        auto& buf = get_mem_buffer();
+        buf.clear();
+        const auto& tag = _categoryTags[cat];
+        buf.append(tag.data(), tag.data() + tag.size());
+        fmt::format_to(std::back_inserter(buf), fmt_str,
+                       std::forward<Args>(args)...);
+        do_log(lvl, buf.data(), buf.size(), lvl <= get_category_level(cat));
+    }
+
+    /** Structured message with key/value fields, eg:
+     *   log_kv(L_INFO, "tile loaded", "tile", id, "ms", elapsed);
+     * Text sinks receive "tile loaded tile=12 ms=3.5", while the structured
+     * sinks get the fields with their original types. */
+    template <typename... Args>
+    void log_kv(int lvl, std::string_view msg, Args&&... kvs) {
+        static_assert(sizeof...(Args) % 2 == 0,
+                      "log_kv() expects key/value pairs");
+        if (lvl > _captureLevel) {
+            return; // Discarding.
+        }
+
+        auto& buf = get_mem_buffer();
+        buf.clear();
+        buf.append(msg.data(), msg.data() + msg.size());
+        auto& fields = get_fields_buffer();
+        fields.clear();
+        log_fields::append_all(buf, fields, std::forward<Args>(kvs)...);
+        do_log(lvl, buf.data(), buf.size(), lvl <= _notifyLevel, msg.size(),
+               {fields.data(), fields.size()});
+    }
+
+    /** Emit a message if the limiter allows it, appending the number of
+     * messages suppressed since the previous one. Disabled levels don't
+     * consume any token. */
+    template <typename... Args>
+    void log_limited(LogRateLimiter& limiter, int lvl,
+                     fmt::format_string<Args...> fmt_str, Args&&... args) {
+        U64 suppressed = 0;
+        if (lvl > _captureLevel || !limiter.try_acquire(suppressed)) {
+            return; // Discarding.
+        }
+
+        auto& buf = get_mem_buffer();
+        buf.clear();
+        fmt::format_to(std::back_inserter(buf), fmt_str,
+                       std::forward<Args>(args)...);
+        if (suppressed > 0) {
+            fmt::format_to(std::back_inserter(buf), " (x {} suppressed)",
+                           suppressed);
+        }
+        do_log(lvl, buf.data(), buf.size(), lvl <= _notifyLevel);
+    }
 
     void log_message(int lvl, const char* data) {
-        if (lvl > _notifyLevel) {
+        if (lvl > _captureLevel) {
             return; // Discarding.
         }
 
-        do_log(lvl, data, strlen(data));
+        do_log(lvl, data, strlen(data), lvl <= _notifyLevel);
     }
 
     template <typename... Args>
     void log(int lvl, fmt::format_string<Args...> fmt_str, Args&&... args) {
-        if (lvl > _notifyLevel) {
+        if (lvl > _captureLevel) {
             return; // Discarding.
         }
         // std::cout << "Formatting with: " << fmt_str << std::endl;
@@ -76,7 +257,7 @@ class LogManager {
                        std::forward<Args>(args)...);
         auto* data = buf.data(); // pointer to the formatted data
         auto size = buf.size();  // size of the formatted data
-        do_log(lvl, data, size);
+        do_log(lvl, data, size, lvl <= _notifyLevel);
     }
 
     static void debug(const char* msg) {
@@ -114,9 +295,10 @@ class LogManager {
     static void debug_1s(StringID logId, fmt::format_string<Args...> fmt,
                          Args&&... args) {
         auto& lman = LogManager::instance();
-        if (lman.should_log(logId, std::chrono::seconds(1))) {
-            LogManager::instance().log(L_DEBUG, fmt,
-                                       std::forward<Args>(args)...);
+        if (lman.is_captured(L_DEBUG)) {
+            lman.log_limited(
+                lman.get_rate_limiter(logId, std::chrono::seconds(1)),
+                L_DEBUG, fmt, std::forward<Args>(args)...);
         }
     }
 
@@ -145,7 +327,12 @@ class LogManager {
         LogManager::instance().log(L_FATAL, fmt, std::forward<Args>(args)...);
     }
 
-    void add_sink(LogSink* sink) { _sinks.emplace_back(sink); }
+    void add_sink(LogSink* sink) {
+        if (sink->wants_records()) {
+            ++_numRecordSinks;
+        }
+        _sinks.emplace_back(sink);
+    }
 
     /** Remove a log sink */
     auto remove_sink(LogSink* sink) -> bool;
@@ -153,6 +340,16 @@ class LogManager {
     void setup_log_file(const char* filename, bool withStdout = true,
                         bool append = false);
 
+    /** Same as setup_log_file() but using a BufferedFileLogger sink (or a
+    CompressedFileLogger if the filename ends with ".gz", or a JsonLinesLogger
+    if it ends with ".jsonl"). */
+    void setup_buffered_log_file(const char* filename,
+                                 const BufferedFileLoggerTraits& traits,
+                                 bool withStdout = true);
+
+    /** Force all the sinks to write their pending data. */
+    void flush();
+
     auto is_idle() const -> bool {
 #if NV_USE_LOG_THREAD
         return _numPendingMessages.load(std::memory_order_acquire) == 0;
@@ -162,24 +359,104 @@ class LogManager {
 #endif
     }
 
+    /** Get the rate limiter shared by all the messages using the given id
+     * (created with the given period on first use). Prefer the per call site
+     * logXXX_every() macros which don't need any lookup. */
+    auto get_rate_limiter(StringID logId, std::chrono::milliseconds period)
+        -> LogRateLimiter&;
+
     // Assign redirect function:
     void set_redirect_func(RedirectFunc func);
 
+    /** Keep the last messages up to the given level in memory, even if they
+     * are not emitted, so they can be dumped when the process fails: on
+     * THROW_MSG/NVCHK failures (if dumpOnError is true), on fatal signals
+     * (if handleSignals is true), or with dump_flight_recorder(). The dumps
+     * are appended to dumpFile, or written to stderr if it is empty. */
+    void
+    enable_flight_recorder(U32 capacity = NV_LOG_FLIGHT_RECORDER_CAPACITY,
+                           int level = L_DEBUG, const String& dumpFile = {},
+                           bool dumpOnError = true, bool handleSignals = true);
+
+    /** Stop recording messages (the recorded ones are kept) */
+    void disable_flight_recorder();
+
+    [[nodiscard]] auto get_flight_recorder() const -> FlightRecorder* {
+        return _flightRecorder.load(std::memory_order_acquire);
+    }
+
+    /** Dump the flight recorder content, if enabled. */
+    void dump_flight_recorder(const char* reason = "user request");
+
+    /** Called by throw_msg() when a fatal error is reported. */
+    void on_fatal_error();
+
+    /** Select the behavior when the message queue is full. With
+     * BP_DROP_LOW_LEVELS, messages at keepLevel or more severe are never
+     * dropped. */
+    void set_backpressure(Backpressure policy, int keepLevel = L_WARN);
+
+    [[nodiscard]] auto get_backpressure() const -> Backpressure {
+        return _backpressure;
+    }
+
+    /** Change the number of message slots. Must be called before any message
+     * is logged: throws once the queue is in use. */
+    void set_queue_capacity(U32 capacity);
+
+    [[nodiscard]] auto get_queue_stats() const -> QueueStats;
+
+    /** Reset the dropped/blocked counters and the high-water marks */
+    void reset_queue_stats();
+
   protected:
     struct MsgTag {
         U32 index{0};
+        U32 level{0};
         U64 timetag{0};
+        // Layout of the message string: prefix, message, rendered fields
+        // (up to textEnd), encoded fields.
+        U32 msgEnd{0};
+        U32 textEnd{0};
     };
 
-    void do_log(U32 lvl, const char* data, size_t size);
+    /** Process a message: the flight recorder may capture messages that
+     * are not emitted to the sinks. For structured messages, only the first
+     * msgSize bytes of data are the message itself, followed by the text
+     * rendering of the encoded fields. */
+    void do_log(U32 lvl, const char* data, size_t size, bool emit = true,
+                size_t msgSize = std::string::npos,
+                std::string_view fields = {});
+
+    void update_capture_level() {
+        _captureLevel = maximum(_notifyLevel, _recordLevel);
+    }
+
+#if NV_USE_LOG_THREAD
+    /** Get a free message slot, applying the backpressure policy when the
+     * queue is full. Returns false if the message must be dropped. */
+    auto acquire_slot(U32 lvl, MsgTag& mtag) -> bool;
+
+    /** Take a slot released by the logger thread (one permit acquired) */
+    void take_recycled_slot(MsgTag& mtag);
+#endif
 
     auto get_mem_buffer() -> fmt::memory_buffer&;
 
     auto get_output_string() -> std::string&;
 
+    auto get_fields_buffer() -> fmt::memory_buffer&;
+
+    /** Send a message to the structured sinks */
+    void output_record(U32 lvl, const std::string& str, U32 msgEnd,
+                       U32 textEnd);
+
     /** Output a message */
     void output_message(U32 lvl, const std::string& msg);
 
+    /** Give the sinks a chance to flush their buffers while idle */
+    void poll_sinks();
+
     void clear_buffer() { get_mem_buffer().clear(); };
 
 #if 0
@@ -195,8 +472,32 @@ class LogManager {
   private:
     int _notifyLevel = L_INFO;
 
+    /** Max level captured by the flight recorder (-1 = disabled) */
+    int _recordLevel{-1};
+
+    /** Max level that must be formatted (emitted or recorded) */
+    int _captureLevel = L_INFO;
+
+    /** Flight recorder, allocated once and kept until destruction */
+    RefPtr<FlightRecorder> _flightRecorderRef;
+    std::atomic<FlightRecorder*> _flightRecorder{nullptr};
+    String _flightRecorderFile;
+    bool _dumpOnError{false};
+
+    /** Per category levels (-1 = use _notifyLevel) */
+    std::array<std::atomic<I32>, NV_LOG_MAX_CATEGORIES> _categoryLevels;
+
+    /** Category names and "[name] " tags */
+    std::array<String, NV_LOG_MAX_CATEGORIES> _categoryNames;
+    std::array<String, NV_LOG_MAX_CATEGORIES> _categoryTags;
+    U32 _numCategories{0};
+    std::mutex _categoryMutex;
+
     RedirectFunc _redirectFn{nullptr};
 
+    Backpressure _backpressure{BP_BLOCK};
+    int _backpressureLevel{L_WARN};
+
     SpinLock _logSP;
     std::mutex _logMutex;
 
@@ -204,27 +505,14 @@ class LogManager {
     or we will get a memory lead on close: */
     std::vector<RefPtr<LogSink>> _sinks;
 
-    /** throtlling data */
-    std::unordered_map<StringID, std::chrono::steady_clock::time_point>
-        _lastLogTimeMap;
-
-    auto should_log(StringID logId, std::chrono::milliseconds throttle_period =
-                                        std::chrono::seconds(1)) -> bool {
-        auto now = std::chrono::steady_clock::now();
-        auto it = _lastLogTimeMap.find(logId);
-
-        if (it == _lastLogTimeMap.end()) {
-            _lastLogTimeMap.insert(std::make_pair(logId, now));
-            return true;
-        }
-
-        if ((now - it->second) >= throttle_period) {
-            it->second = now;
-            return true;
-        }
+    /** Number of sinks receiving the structured records (read by the logger
+     * thread outside of _logMutex) */
+    std::atomic<U32> _numRecordSinks{0};
 
-        return false;
-    }
+    /** Rate limiters used with debug_1s() */
+    std::unordered_map<StringID, std::unique_ptr<LogRateLimiter>>
+        _rateLimiters;
+    std::mutex _rateLimitersMutex;
 
 #if NV_USE_LOG_THREAD
     /** The thread object */
@@ -236,8 +524,20 @@ class LogManager {
     /** log thread entrypoint */
     void logger_thread();
 
-    /** Count of pending log messages */
-    std::atomic<U32> _numQueuedStrings;
+    /** Count of slots used so far (up to _queueCapacity) */
+    std::atomic<U32> _numQueuedStrings{0};
+
+    /** Number of message slots */
+    U32 _queueCapacity{NV_LOG_MSG_QUEUE_CAPACITY};
+
+    /** Counts the slots available in the recycle queue */
+    moodycamel::LightweightSemaphore _freeSlots;
+
+    /** Backpressure statistics */
+    std::atomic<U64> _numDropped{0};
+    std::atomic<U64> _numBlocked{0};
+    std::atomic<U32> _highWaterMark{0};
+    std::atomic<U32> _maxBatchSize{0};
 
     /** Number of pending messages */
     std::atomic<U32> _numPendingMessages{0};
@@ -261,7 +561,7 @@ class LogManager {
     moodycamel::ProducerToken _recycleProducerToken;
 
     /** Storage for the messages */
-    std::array<std::string, NV_LOG_MSG_QUEUE_CAPACITY> _msgArray;
+    std::vector<std::string> _msgArray;
 
 #endif
 };
@@ -288,6 +588,7 @@ inline void throw_msg(fmt::format_string<Args...> msg_format, Args&&... args) {
     logFATAL(str.c_str());
     // Wait until the LogManager is done.
     auto& lman = LogManager::instance();
+    lman.on_fatal_error();
     I32 count = 0;
     while (!lman.is_idle()) {
         if ((++count % 100) == 0) {
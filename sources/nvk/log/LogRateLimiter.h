@@ -0,0 +1,60 @@
+#ifndef NV_LOGRATELIMITER_H_
+#define NV_LOGRATELIMITER_H_
+
+#include <nvk_common.h>
+
+namespace nv {
+
+/**
+Lock-free token bucket used to throttle a log statement: up to 'burst'
+messages can be emitted at once, then one message per period. The state is a
+single atomic "theoretical arrival time" (GCRA formulation of the token
+bucket) plus a counter of the messages suppressed since the last emitted one,
+so it can be shared by any number of threads without locking.
+*/
+class LogRateLimiter {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    template <typename Rep, typename Period>
+    explicit LogRateLimiter(std::chrono::duration<Rep, Period> period,
+                            U32 burst = 1)
+        : _periodNs(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(period)
+                  .count()),
+          _toleranceNs(_periodNs * (I64)(burst > 0 ? burst - 1 : 0)) {}
+
+    /** Check if a message can be emitted now. On success, suppressed
+     * receives the number of messages rejected since the previous emitted
+     * one. */
+    auto try_acquire(U64& suppressed) -> bool {
+        I64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now().time_since_epoch())
+                      .count();
+        I64 tat = _tat.load(std::memory_order_relaxed);
+        while (true) {
+            I64 start = tat > now ? tat : now;
+            if (start - now > _toleranceNs) {
+                _suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (_tat.compare_exchange_weak(tat, start + _periodNs,
+                                           std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+  private:
+    I64 _periodNs;
+    I64 _toleranceNs;
+    std::atomic<I64> _tat{0};
+    std::atomic<U64> _suppressed{0};
+};
+
+} // namespace nv
+
+#endif
@@ -7,10 +7,34 @@
 
 namespace nv {
 
+/** Single log message, as received by the structured sinks */
+struct LogRecord {
+    int level{0};
+    // "YYYY-MM-DD HH:MM:SS.uuuuuu" local time
+    std::string_view timestamp;
+    // Message text (without the timestamp/level prefix or the fields)
+    std::string_view message;
+    // Encoded key/value fields (cf. LogFieldReader)
+    std::string_view fields;
+};
+
 class LogSink : public nv::RefObject {
   public:
     virtual void output(int level, const char* prefix, const char* msg,
                         size_t size) = 0;
+
+    /** Structured sinks receive each message with its fields through
+     * output_record() instead of the text batches sent to output(). */
+    [[nodiscard]] virtual auto wants_records() const -> bool { return false; }
+
+    virtual void output_record(const LogRecord& /*rec*/) {}
+
+    /** Write any data still held by the sink to its final destination. */
+    virtual void flush() {}
+
+    /** Called periodically by the LogManager while no message is pending, so
+    that time based sinks get a chance to flush their buffers. */
+    virtual void poll() {}
 };
 
 } // namespace nv
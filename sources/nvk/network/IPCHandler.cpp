@@ -1,7 +1,482 @@
-#ifdef _WIN32
-
 #include <nvk/network/IPCHandler.h>
 
+#include <cstring>
+
+namespace nv {
+
+// Max payload of a frame, so that the messages of the other channels can be
+// interleaved with a large message:
+static constexpr U64 kChunkSize = 64 * 1024;
+// Max bytes written per batch, bounding the delay of a high priority
+// message queued during a write:
+static constexpr U64 kBatchSize = 256 * 1024;
+// The receiver returns flow control credit by steps of this size:
+static constexpr U64 kCreditStep = 64 * 1024;
+static constexpr U64 kMinWindow = 4 * kCreditStep;
+
+// ============================================================================
+// IPCChannel
+// ============================================================================
+
+IPCChannel::IPCChannel(IPCBase* owner, U16 id, I32 priority, U64 window)
+    : _owner(owner), _id(id), _priority(priority),
+      _window(maximum(window, kMinWindow)), _credit(_window) {}
+
+auto IPCChannel::send(const String& data) -> bool {
+    if (data.size() > IPCBase::MAX_MESSAGE_SIZE) {
+        logERROR("IPC message too large: {} bytes", data.size());
+        return false;
+    }
+
+    return send_in_place(static_cast<U32>(data.size()),
+                         [&data](std::span<U8> buf) {
+                             memcpy(buf.data(), data.data(), buf.size());
+                         });
+}
+
+auto IPCChannel::send_in_place(
+    U32 size, const std::function<void(std::span<U8>)>& writer) -> bool {
+    if (!_owner->_connected) {
+        logWARN("Not connected to send message.");
+        return false;
+    }
+
+#ifndef _WIN32
+    if (_id == 0) {
+        if (auto sent = _owner->send_to_ring(size, writer)) {
+            return *sent;
+        }
+    }
+#endif
+
+    return _owner->queue_message(*this, size, writer);
+}
+
+// ============================================================================
+// IPCBase - Framing and Send Queue
+// ============================================================================
+
+auto IPCBase::add_channel(U16 id, I32 priority, U64 window) -> IPCChannel& {
+    NVCHK(!_running, "IPC channels must be added before start().");
+
+    auto* channel = get_channel(id);
+    if (channel != nullptr) {
+        channel->_priority = priority;
+        channel->_window = maximum(window, kMinWindow);
+        channel->_credit = channel->_window;
+    } else {
+        _channels.push_back(
+            std::make_unique<IPCChannel>(this, id, priority, window));
+        channel = _channels.back().get();
+        _channelMap[id] = channel;
+    }
+
+    std::stable_sort(_channels.begin(), _channels.end(),
+                     [](const auto& a, const auto& b) {
+                         return a->_priority > b->_priority;
+                     });
+    return *channel;
+}
+
+auto IPCBase::get_channel(U16 id) -> IPCChannel* {
+    auto it = _channelMap.find(id);
+    return it != _channelMap.end() ? it->second : nullptr;
+}
+
+auto IPCBase::send(const String& data) -> bool {
+    return _defaultChannel->send(data);
+}
+
+auto IPCBase::send_in_place(U32 size,
+                            const std::function<void(std::span<U8>)>& writer)
+    -> bool {
+    return _defaultChannel->send_in_place(size, writer);
+}
+
+auto IPCBase::queue_message(IPCChannel& channel, U32 size,
+                            const std::function<void(std::span<U8>)>& writer)
+    -> bool {
+    if (size > MAX_MESSAGE_SIZE) {
+        logERROR("IPC message too large: {} bytes", size);
+        return false;
+    }
+
+    U8Vector message(size);
+    writer(message);
+
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    auto hasRoom = [this, &channel, size] {
+        return channel._queuedBytes == 0 ||
+               channel._queuedBytes + size <= _maxQueueSize || !_connected;
+    };
+    if (!_queueCondition.wait_for(lock, std::chrono::milliseconds(_timeout),
+                                  hasRoom)) {
+        logERROR("IPC send queue full, message dropped.");
+        return false;
+    }
+    if (!_connected) {
+        logWARN("Not connected to send message.");
+        return false;
+    }
+
+    channel._queuedBytes += size;
+    _queuedBytes += size;
+    channel._pending.push_back(std::move(message));
+    _queueCondition.notify_all();
+    return true;
+}
+
+void IPCBase::queue_control_frame(U32 flags, U64 value) {
+    U8Vector frame(sizeof(FrameHeader) + sizeof(value));
+    FrameHeader header{sizeof(value), flags};
+    memcpy(frame.data(), &header, sizeof(header));
+    memcpy(frame.data() + sizeof(header), &value, sizeof(value));
+
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _controlFrames.push_back(std::move(frame));
+    }
+    _queueCondition.notify_all();
+}
+
+auto IPCBase::next_channel() -> IPCChannel* {
+    // The channels are sorted by priority: find the first group with
+    // something to send, and start after the last channel served in it.
+    size_t count = _channels.size();
+    for (size_t first = 0; first < count;) {
+        size_t last = first + 1;
+        while (last < count &&
+               _channels[last]->_priority == _channels[first]->_priority) {
+            ++last;
+        }
+
+        size_t size = last - first;
+        size_t start = _lastChannel >= first && _lastChannel < last
+                           ? _lastChannel + 1 - first
+                           : 0;
+        for (size_t i = 0; i < size; ++i) {
+            size_t idx = first + (start + i) % size;
+            auto& channel = *_channels[idx];
+            if (channel._pending.empty()) {
+                continue;
+            }
+            // Empty messages don't need credit:
+            if (channel._credit > 0 || channel._pending.front().empty()) {
+                _lastChannel = idx;
+                return &channel;
+            }
+        }
+
+        first = last;
+    }
+
+    return nullptr;
+}
+
+auto IPCBase::has_pending() const -> bool {
+    if (!_controlFrames.empty()) {
+        return true;
+    }
+    for (const auto& channel : _channels) {
+        if (!channel->_pending.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto IPCBase::flush() -> bool {
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    _flushRequested = true;
+    _queueCondition.notify_all();
+    _queueCondition.wait_for(
+        lock, std::chrono::milliseconds(_timeout),
+        [this] { return (!has_pending() && !_writing) || !_running; });
+    return !has_pending() && !_writing;
+}
+
+void IPCBase::send_loop() {
+    logDEBUG_CAT(ipc, "Entering IPC sender thread.");
+
+    Vector<std::span<const U8>> buffers;
+    Vector<FrameHeader> headers;
+    // Messages (and control frames) being written:
+    Vector<U8Vector> written;
+    // Connection on which a write failed: its transport is shut down, and
+    // the reader thread will call disconnect() to drop its queue.
+    U32 failedGeneration = ~0U;
+
+    std::unique_lock<std::mutex> lock(_queueMutex);
+
+    while (true) {
+        _queueCondition.wait(lock, [this] {
+            return !_running || !_controlFrames.empty() ||
+                   next_channel() != nullptr;
+        });
+        if (!_running) {
+            break;
+        }
+
+        // Give the callers a chance to add more messages to a small batch:
+        if (_flushDelay > 0 && !_flushRequested &&
+            _controlFrames.empty() && _queuedBytes < BUFFER_SIZE) {
+            _queueCondition.wait_for(
+                lock, std::chrono::microseconds(_flushDelay), [this] {
+                    return _queuedBytes >= BUFFER_SIZE || _flushRequested ||
+                           !_running;
+                });
+        }
+
+        for (auto& frame : _controlFrames) {
+            written.push_back(std::move(frame));
+            buffers.emplace_back(written.back());
+        }
+        _controlFrames.clear();
+
+        // Chunks of the channels by priority, up to the batch size (the
+        // headers must not move once referenced):
+        headers.reserve(kBatchSize / sizeof(FrameHeader));
+        U64 batchSize = 0;
+        while (batchSize < kBatchSize &&
+               headers.size() < headers.capacity()) {
+            auto* channel = next_channel();
+            if (channel == nullptr) {
+                break;
+            }
+
+            auto& message = channel->_pending.front();
+            U64 remaining = message.size() - channel->_sentOffset;
+            U64 chunk =
+                minimum(minimum(remaining, kChunkSize), channel->_credit);
+            bool last = chunk == remaining;
+
+            U32 flags =
+                (U32(channel->_id) << 16) | (last ? U32(FRAME_LAST) : 0U);
+            headers.push_back({static_cast<U32>(chunk), flags});
+            buffers.emplace_back(
+                reinterpret_cast<const U8*>(&headers.back()),
+                sizeof(FrameHeader));
+            if (chunk > 0) {
+                buffers.emplace_back(message.data() + channel->_sentOffset,
+                                     chunk);
+            }
+
+            channel->_sentOffset += chunk;
+            channel->_credit -= chunk;
+            channel->_queuedBytes -= chunk;
+            _queuedBytes -= chunk;
+            batchSize += sizeof(FrameHeader) + chunk;
+
+            if (last) {
+                // Moving the vector keeps its data in place:
+                written.push_back(std::move(message));
+                channel->_pending.pop_front();
+                channel->_sentOffset = 0;
+            }
+        }
+
+        _flushRequested = _flushRequested && has_pending();
+        _writing = true;
+        U32 generation = _generation;
+        lock.unlock();
+        _queueCondition.notify_all();
+
+        if (generation != failedGeneration &&
+            !write_frames(buffers, generation)) {
+            failedGeneration = generation;
+        }
+
+        buffers.clear();
+        headers.clear();
+        written.clear();
+
+        lock.lock();
+        _writing = false;
+        _retiredMessages.clear();
+        _queueCondition.notify_all();
+    }
+
+    logDEBUG_CAT(ipc, "Exiting IPC sender thread.");
+}
+
+void IPCBase::disconnect() {
+    bool wasConnected = _connected.exchange(false);
+
+    // The queued messages were meant for this connection:
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        for (auto& channel : _channels) {
+            // The batch being written may point into the message in
+            // progress (moving the vector keeps its data in place):
+            if (_writing && channel->_sentOffset > 0) {
+                _retiredMessages.push_back(
+                    std::move(channel->_pending.front()));
+            }
+            channel->_pending.clear();
+            channel->_sentOffset = 0;
+            channel->_queuedBytes = 0;
+            channel->_credit = channel->_window;
+            channel->_partial.clear();
+            channel->_consumed = 0;
+        }
+        _controlFrames.clear();
+        _queuedBytes = 0;
+        ++_generation;
+    }
+    _queueCondition.notify_all();
+    _recvSize = 0;
+
+    if (wasConnected) {
+        disconnected.emit();
+        logNOTE("IPC disconnected.");
+    }
+}
+
+auto IPCBase::recv_space() -> std::span<U8> {
+    size_t needed = _recvSize + BUFFER_SIZE;
+    if (_recvSize >= sizeof(FrameHeader)) {
+        // Make room for the whole pending frame:
+        FrameHeader header{};
+        memcpy(&header, _recvBuffer.data(), sizeof(header));
+        needed = maximum<size_t>(needed, sizeof(header) + header.size);
+    }
+
+    if (_recvBuffer.size() < needed) {
+        _recvBuffer.resize(needed);
+    }
+    return {_recvBuffer.data() + _recvSize, _recvBuffer.size() - _recvSize};
+}
+
+auto IPCBase::process_frames(size_t count) -> bool {
+    _recvSize += count;
+
+    size_t pos = 0;
+    while (_recvSize - pos >= sizeof(FrameHeader)) {
+        FrameHeader header{};
+        memcpy(&header, _recvBuffer.data() + pos, sizeof(header));
+        if (header.size > MAX_MESSAGE_SIZE) {
+            logERROR("Invalid IPC frame of {} bytes.", header.size);
+            return false;
+        }
+
+        size_t frameSize = sizeof(header) + header.size;
+        if (_recvSize - pos < frameSize) {
+            break;
+        }
+
+        std::span<const U8> payload{
+            _recvBuffer.data() + pos + sizeof(header), header.size};
+        if ((header.flags & FRAME_WINDOW) != 0) {
+            handle_window_frame(header, payload);
+        } else if ((header.flags & FRAME_SHM_RING) != 0) {
+            handle_control_frame(header, payload);
+        } else if (!handle_chunk(header, payload)) {
+            return false;
+        }
+        pos += frameSize;
+    }
+
+    if (pos > 0) {
+        _recvSize -= pos;
+        memmove(_recvBuffer.data(), _recvBuffer.data() + pos, _recvSize);
+    }
+
+    // Release the memory used by a large message:
+    if (_recvBuffer.size() > 16 * BUFFER_SIZE && _recvSize <= BUFFER_SIZE) {
+        _recvBuffer.resize(BUFFER_SIZE);
+        _recvBuffer.shrink_to_fit();
+    }
+
+    return true;
+}
+
+auto IPCBase::handle_chunk(const FrameHeader& header,
+                           std::span<const U8> payload) -> bool {
+    U16 id = header.flags >> 16;
+    auto* channel = get_channel(id);
+    if (channel == nullptr) {
+        logWARN("Dropping IPC data on unknown channel {}.", id);
+        if (!payload.empty()) {
+            queue_control_frame(FRAME_WINDOW | (U32(id) << 16),
+                                payload.size());
+        }
+        return true;
+    }
+
+    bool last = (header.flags & FRAME_LAST) != 0;
+    if (last && channel->_partial.empty()) {
+        emit_message(*channel, payload.data(), payload.size());
+    } else {
+        // The credit is returned as the chunks arrive, so it doesn't bound
+        // the size of a message:
+        if (channel->_partial.size() + payload.size() > MAX_MESSAGE_SIZE) {
+            logERROR("IPC message on channel {} exceeds {} bytes.", id,
+                     MAX_MESSAGE_SIZE);
+            return false;
+        }
+        channel->_partial.insert(channel->_partial.end(), payload.begin(),
+                                 payload.end());
+        if (last) {
+            emit_message(*channel, channel->_partial.data(),
+                         channel->_partial.size());
+            channel->_partial.clear();
+            if (channel->_partial.capacity() > 16 * BUFFER_SIZE) {
+                channel->_partial.shrink_to_fit();
+            }
+        }
+    }
+
+    // Return the credit once the data is delivered:
+    channel->_consumed += payload.size();
+    if (channel->_consumed >= kCreditStep) {
+        queue_control_frame(FRAME_WINDOW | (U32(id) << 16),
+                            channel->_consumed);
+        channel->_consumed = 0;
+    }
+    return true;
+}
+
+void IPCBase::handle_window_frame(const FrameHeader& header,
+                                  std::span<const U8> payload) {
+    auto* channel = get_channel(header.flags >> 16);
+    U64 credit = 0;
+    if (channel == nullptr || payload.size() != sizeof(credit)) {
+        return;
+    }
+    memcpy(&credit, payload.data(), sizeof(credit));
+
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        channel->_credit = minimum(channel->_credit + credit, channel->_window);
+    }
+    _queueCondition.notify_all();
+}
+
+void IPCBase::emit_message(IPCChannel& channel, const U8* data,
+                           size_t size) {
+    if (channel._id == 0) {
+        if (bufferReceived.size() > 0) {
+            bufferReceived.emit({data, size});
+        }
+        if (dataReceived.size() > 0) {
+            dataReceived.emit(
+                String(reinterpret_cast<const char*>(data), size));
+        }
+    }
+
+    if (channel.bufferReceived.size() > 0) {
+        channel.bufferReceived.emit({data, size});
+    }
+    if (channel.dataReceived.size() > 0) {
+        channel.dataReceived.emit(
+            String(reinterpret_cast<const char*>(data), size));
+    }
+}
+
+} // namespace nv
+
+#ifdef _WIN32
+
 namespace nv {
 
 // ============================================================================
@@ -23,6 +498,8 @@ IPCBase::IPCBase(const String& pipeName)
             CloseHandle(_writeEvent);
         THROW_MSG("Failed to create IPC events");
     }
+
+    _defaultChannel = &add_channel(0);
 }
 
 IPCBase::~IPCBase() {
@@ -41,6 +518,7 @@ IPCBase::~IPCBase() {
 void IPCBase::start() {
     _running = true;
     _readerThread = std::thread(&IPCBase::run, this);
+    _senderThread = std::thread(&IPCBase::send_loop, this);
 }
 
 void IPCBase::stop() {
@@ -49,35 +527,53 @@ void IPCBase::stop() {
 
         // Interrupt any sleeping threads
         _stopCondition.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+        }
+        _queueCondition.notify_all();
 
-        logDEBUG("Waiting for IPC Thread...");
+        logDEBUG_CAT(ipc, "Waiting for IPC Thread...");
         NVCHK(_readerThread.joinable(), "Reader thread is not joinable.");
         _readerThread.join();
-        logDEBUG("IPC Thread finished.");
+        _senderThread.join();
+        logDEBUG_CAT(ipc, "IPC Thread finished.");
     }
 }
 
-void IPCBase::disconnect() {
-    if (_connected) {
-        _connected = false;
-        disconnected.emit();
-        logNOTE("IPC disconnected.");
+auto IPCBase::write_frames(const Vector<std::span<const U8>>& buffers,
+                           U32 generation) -> bool {
+    if (!_connected || _pipeHandle == INVALID_HANDLE_VALUE ||
+        generation != _generation) {
+        return false;
     }
-}
 
-auto IPCBase::send(const String& data) -> bool {
-    if (!_connected || _pipeHandle == INVALID_HANDLE_VALUE) {
-        logWARN("Not connected to send message.");
-        return false;
+    // Gather the batch in a single write:
+    U8Vector data;
+    size_t total = 0;
+    for (const auto& buf : buffers) {
+        total += buf.size();
+    }
+    data.reserve(total);
+    for (const auto& buf : buffers) {
+        data.insert(data.end(), buf.begin(), buf.end());
     }
 
+    // A partial batch may have been written, so the connection can't be used
+    // anymore after a failure: cancelling all the pending I/O also aborts the
+    // read in run(), which then closes the pipe.
+    auto fail = [this]() {
+        _writeFailed = true;
+        CancelIoEx(_pipeHandle, nullptr);
+        return false;
+    };
+
     OVERLAPPED overlap = {};
     overlap.hEvent = _writeEvent; // Use member variable
     ResetEvent(_writeEvent);      // Reset before use
 
     if (overlap.hEvent == nullptr) {
         logERROR("Failed to create event for WriteFile");
-        return false;
+        return fail();
     }
 
     DWORD bytesWritten = 0;
@@ -105,43 +601,53 @@ auto IPCBase::send(const String& data) -> bool {
                                  "error code: {}",
                                  err);
                     }
-                    return false;
+                    return fail();
                 }
-            } else if (waitResult == WAIT_TIMEOUT) {
-                logERROR("WriteFile timed out after {}ms", _timeout);
-                CancelIoEx(_pipeHandle, &overlap);
-                return false;
             } else {
-                logERROR("WaitForSingleObject failed for WriteFile");
-                CancelIoEx(_pipeHandle, &overlap);
+                if (waitResult == WAIT_TIMEOUT) {
+                    logERROR("WriteFile timed out after {}ms, closing the "
+                             "connection.",
+                             _timeout);
+                } else {
+                    logERROR("WaitForSingleObject failed for WriteFile");
+                }
+                fail();
+                // The buffers must outlive the cancelled write:
+                GetOverlappedResult(_pipeHandle, &overlap, &bytesWritten,
+                                    TRUE);
                 return false;
             }
         } else if (err == ERROR_NO_DATA || err == ERROR_BROKEN_PIPE) {
             logERROR("WriteFile failed: pipe closed at the other end.");
-            return false;
+            return fail();
         } else {
             logERROR("WriteFile failed, error code: {}", err);
-            return false;
+            return fail();
         }
     }
 
     if (bytesWritten != data.size()) {
         logERROR("WriteFile incomplete: wrote {} of {} bytes", bytesWritten,
                  data.size());
-        return false;
+        return fail();
     }
 
-    FlushFileBuffers(_pipeHandle);
+    // Note: no FlushFileBuffers() here, it would wait until the client has
+    // read everything.
     // logDEBUG("Sent {} bytes via IPC.", bytesWritten);
     return true;
 }
 
-void IPCBase::run() {
-    logDEBUG("Entering IPC thread.");
+void IPCBase::handle_control_frame(const FrameHeader& header,
+                                   std::span<const U8> /*payload*/) {
+    logWARN("Ignoring IPC control frame {}.", header.flags);
+}
 
-    char buffer[BUFFER_SIZE];
+void IPCBase::run() {
+    logDEBUG_CAT(ipc, "Entering IPC thread.");
 
     while (_running) {
+        _writeFailed = false;
         if (!establish_connection()) {
             if (_running) {
                 std::unique_lock<std::mutex> lock(_stopMutex);
@@ -155,19 +661,23 @@ void IPCBase::run() {
         OVERLAPPED overlap = {};
         overlap.hEvent = _readEvent;
 
-        while (_running && _connected && _pipeHandle != INVALID_HANDLE_VALUE) {
+        while (_running && _connected && !_writeFailed &&
+               _pipeHandle != INVALID_HANDLE_VALUE) {
             DWORD bytesRead = 0;
             ResetEvent(_readEvent); // Reset before each read
 
-            BOOL success = ReadFile(_pipeHandle, buffer, sizeof(buffer) - 1,
-                                    &bytesRead, &overlap);
+            auto space = recv_space();
+            BOOL success = ReadFile(
+                _pipeHandle, space.data(),
+                static_cast<DWORD>(minimum<size_t>(space.size(), 1U << 30)),
+                &bytesRead, &overlap);
 
             if (success == 0) {
                 DWORD err = GetLastError();
 
                 if (err == ERROR_IO_PENDING) {
                     // Wait with timeout so we can check _running
-                    while (_running) {
+                    while (_running && !_writeFailed) {
                         DWORD waitResult = WaitForSingleObject(_readEvent, 100);
                         if (waitResult == WAIT_OBJECT_0) {
                             // Get the result
@@ -176,6 +686,9 @@ void IPCBase::run() {
                                 err = GetLastError();
                                 if (err == ERROR_BROKEN_PIPE) {
                                     logNOTE("Connection broken (broken pipe).");
+                                } else if (err == ERROR_OPERATION_ABORTED) {
+                                    logDEBUG_CAT(ipc,
+                                                 "Read operation cancelled.");
                                 } else {
                                     logERROR("GetOverlappedResult failed: {}",
                                              err);
@@ -196,7 +709,7 @@ void IPCBase::run() {
                         break;
                     }
 
-                    if (!_running) {
+                    if (!_running || _writeFailed) {
                         CancelIoEx(_pipeHandle, &overlap);
                         break;
                     }
@@ -209,7 +722,7 @@ void IPCBase::run() {
                     disconnect();
                     break;
                 } else if (err == ERROR_OPERATION_ABORTED) {
-                    logDEBUG("Read operation cancelled.");
+                    logDEBUG_CAT(ipc, "Read operation cancelled.");
                     disconnect();
                     break;
                 } else {
@@ -220,9 +733,11 @@ void IPCBase::run() {
             }
 
             if (bytesRead > 0) {
-                buffer[bytesRead] = '\0';
                 // logDEBUG("IPC received {} bytes", bytesRead);
-                dataReceived.emit(buffer);
+                if (!process_frames(bytesRead)) {
+                    disconnect();
+                    break;
+                }
             } else if (bytesRead == 0 && (success != 0)) {
                 // Connection closed gracefully
                 logNOTE("Connection closed (0 bytes read).");
@@ -239,10 +754,10 @@ void IPCBase::run() {
         }
     }
 
-    logDEBUG("IPC thread cleaning up...");
+    logDEBUG_CAT(ipc, "IPC thread cleaning up...");
     cleanup_connection();
 
-    logDEBUG("Exiting IPC thread.");
+    logDEBUG_CAT(ipc, "Exiting IPC thread.");
 }
 
 // ============================================================================
@@ -256,7 +771,7 @@ auto IPCServer::create_pipe() -> bool {
 
     _pipeHandle = CreateNamedPipe(
         fullPipeName.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
-        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
         1,           // Max instances
         BUFFER_SIZE, // Output buffer size
         BUFFER_SIZE, // Input buffer size
@@ -268,12 +783,12 @@ auto IPCServer::create_pipe() -> bool {
         return false;
     }
 
-    logDEBUG("Named pipe created: {}", fullPipeName);
+    logDEBUG_CAT(ipc, "Named pipe created: {}", fullPipeName);
     return true;
 }
 
 auto IPCServer::wait_for_connection() -> bool {
-    logDEBUG("Waiting for IPC client connection...");
+    logDEBUG_CAT(ipc, "Waiting for IPC client connection...");
 
     OVERLAPPED overlap = {};
     overlap.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
@@ -344,7 +859,7 @@ IPCClient::IPCClient(const String& pipeName) : IPCBase(pipeName) {}
 auto IPCClient::connect_to_server() -> bool {
     auto fullPipeName = format_string(R"(\\.\pipe\%s)", _pipeName.c_str());
 
-    logDEBUG("Attempting to connect to pipe: {}", fullPipeName);
+    logDEBUG_CAT(ipc, "Attempting to connect to pipe: {}", fullPipeName);
 
     while (_running) {
         _pipeHandle =
@@ -364,8 +879,8 @@ auto IPCClient::connect_to_server() -> bool {
                 }
             }
 
-            logDEBUG("Pipe not available, retrying in {}s...",
-                     _reconnectInterval);
+            logDEBUG_CAT(ipc, "Pipe not available, retrying in {}s...",
+                         _reconnectInterval);
             sleep_s(_reconnectInterval);
             continue;
         }
@@ -379,8 +894,8 @@ auto IPCClient::connect_to_server() -> bool {
         return false;
     }
 
-    // Set pipe to message mode
-    DWORD mode = PIPE_READMODE_MESSAGE | PIPE_WAIT;
+    // Set pipe to byte mode (the messages are framed)
+    DWORD mode = PIPE_READMODE_BYTE | PIPE_WAIT;
     BOOL success =
         SetNamedPipeHandleState(_pipeHandle, &mode, nullptr, nullptr);
 
@@ -410,4 +925,615 @@ void IPCClient::cleanup_connection() {
 
 } // namespace nv
 
+#elif defined(__linux__)
+
+#include <nvk/network/ShmRing.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace nv {
+
+// Names starting with '/' are socket files, others are in the abstract
+// namespace (no file left behind when the process dies).
+static auto get_socket_address(const String& name, sockaddr_un& addr)
+    -> socklen_t {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    size_t offset = name.starts_with('/') ? 0 : 1;
+    NVCHK(name.size() + offset < sizeof(addr.sun_path),
+          "IPC socket name too long: {}", name);
+    memcpy(addr.sun_path + offset, name.data(), name.size());
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + offset +
+                                  name.size());
+}
+
+// Max number of buffers per sendmsg() call (IOV_MAX):
+static constexpr size_t kMaxIovecs = 1024;
+
+// ============================================================================
+// IPCBase - Shared Implementation
+// ============================================================================
+
+IPCBase::IPCBase(const String& pipeName)
+    : _pipeName(pipeName), _epollFd(epoll_create1(EPOLL_CLOEXEC)),
+      _wakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    if (_epollFd < 0 || _wakeFd < 0) {
+        logERROR("Failed to create IPC events");
+        if (_epollFd >= 0)
+            close(_epollFd);
+        if (_wakeFd >= 0)
+            close(_wakeFd);
+        THROW_MSG("Failed to create IPC events");
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = _wakeFd;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeFd, &ev);
+
+    _defaultChannel = &add_channel(0);
+}
+
+IPCBase::~IPCBase() {
+    stop();
+    close(_epollFd);
+    close(_wakeFd);
+}
+
+void IPCBase::start() {
+    // Drop the wake up left by a previous stop():
+    U64 count = 0;
+    while (read(_wakeFd, &count, sizeof(count)) > 0) {
+    }
+
+    _running = true;
+    _readerThread = std::thread(&IPCBase::run, this);
+    _senderThread = std::thread(&IPCBase::send_loop, this);
+}
+
+void IPCBase::stop() {
+    if (_running) {
+        _running = false;
+
+        // Interrupt any sleeping or polling threads
+        {
+            std::lock_guard<std::mutex> lock(_stopMutex);
+        }
+        _stopCondition.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+        }
+        _queueCondition.notify_all();
+        U64 one = 1;
+        (void)!write(_wakeFd, &one, sizeof(one));
+
+        logDEBUG_CAT(ipc, "Waiting for IPC Thread...");
+        NVCHK(_readerThread.joinable(), "Reader thread is not joinable.");
+        _readerThread.join();
+        _senderThread.join();
+        logDEBUG_CAT(ipc, "IPC Thread finished.");
+    }
+}
+
+void IPCBase::attach_socket(int fd) {
+    // The sender thread waits for the socket with poll():
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev);
+
+    std::lock_guard<std::mutex> lock(_sendMutex);
+    _socket = fd;
+    if (_shmRingSize > 0) {
+        open_send_ring();
+    }
+}
+
+void IPCBase::open_send_ring() {
+    auto ring = std::make_unique<ShmRing>();
+    if (!ring->create(_shmRingSize)) {
+        logWARN("Cannot create the IPC shared memory ring, using the socket.");
+        return;
+    }
+
+    // Pass the ring descriptors to the peer with a control frame (the first
+    // one on the connection, so the socket buffer has room for it):
+    auto fds = ring->get_fds();
+    FrameHeader header{0, FRAME_SHM_RING};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    iovec iov{&header, sizeof(header)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(fds));
+
+    if (sendmsg(_socket, &msg, MSG_NOSIGNAL) != sizeof(header)) {
+        logWARN("Cannot send the IPC shared memory ring: {}",
+                strerror(errno));
+        return;
+    }
+
+    logDEBUG_CAT(ipc, "Using a shared memory ring of {} bytes.",
+                 ring->get_capacity());
+    _sendRing = std::move(ring);
+}
+
+void IPCBase::close_socket() {
+    {
+        std::lock_guard<std::mutex> lock(_sendMutex);
+        if (_socket < 0) {
+            return;
+        }
+        // Closing also removes the socket from the epoll set.
+        close(_socket);
+        _socket = -1;
+        _sendRing.reset();
+    }
+    _recvRing.reset();
+    for (int fd : _recvFds) {
+        close(fd);
+    }
+    _recvFds.clear();
+    disconnect();
+}
+
+auto IPCBase::wait_readable(int fd, int fd2) -> int {
+    epoll_event events[4];
+
+    while (_running) {
+        int count = epoll_wait(_epollFd, events, 4, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logERROR("epoll_wait failed: {}", strerror(errno));
+            return -1;
+        }
+
+        int ready = -1;
+        for (int i = 0; i < count; ++i) {
+            int efd = events[i].data.fd;
+            if (efd == _wakeFd) {
+                return -1;
+            }
+            if (efd == fd || (efd == fd2 && ready < 0)) {
+                ready = efd;
+            } else if (efd == _listenSocket) {
+                // Only one client at a time, like a single instance pipe:
+                int client =
+                    accept4(_listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0) {
+                    logWARN("Rejecting IPC client: already connected.");
+                    close(client);
+                }
+            }
+        }
+        if (ready >= 0) {
+            return ready;
+        }
+    }
+
+    return -1;
+}
+
+void IPCBase::wait_stopped(U32 msecs) {
+    std::unique_lock<std::mutex> lock(_stopMutex);
+    _stopCondition.wait_for(lock, std::chrono::milliseconds(msecs),
+                            [this] { return !_running; });
+}
+
+auto IPCBase::send_to_ring(U32 size,
+                           const std::function<void(std::span<U8>)>& writer)
+    -> std::optional<bool> {
+    std::lock_guard<std::mutex> lock(_sendMutex);
+    if (!_sendRing) {
+        return std::nullopt;
+    }
+
+    auto buf = reserve_record(size);
+    if (buf.data() == nullptr) {
+        return false;
+    }
+    writer(buf);
+    _sendRing->commit(size);
+    return true;
+}
+
+auto IPCBase::reserve_record(U64 size) -> std::span<U8> {
+    if (size > _sendRing->get_max_record_size()) {
+        logERROR("IPC message too large: {} bytes (max {})", size,
+                 _sendRing->get_max_record_size());
+        return {};
+    }
+
+    auto recSize = static_cast<U32>(size);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(_timeout);
+
+    while (true) {
+        auto buf = _sendRing->reserve(recSize);
+        if (buf.data() != nullptr) {
+            return buf;
+        }
+
+        if (!_sendRing->prepare_write_wait(recSize)) {
+            continue;
+        }
+
+        // Wait for the reader, or for the peer to close the socket:
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            logERROR("send timed out after {}ms", _timeout);
+            return {};
+        }
+
+        std::array<pollfd, 2> pfds{{{_sendRing->get_write_fd(), POLLIN, 0},
+                                    {_socket, 0, 0}}};
+        int res = poll(pfds.data(), pfds.size(),
+                       static_cast<int>(remaining.count()));
+        if (res < 0 && errno != EINTR) {
+            logERROR("poll failed: {}", strerror(errno));
+            return {};
+        }
+        if ((pfds[1].revents & (POLLHUP | POLLERR)) != 0) {
+            logERROR("send failed: socket closed at the other end.");
+            return {};
+        }
+        if ((pfds[0].revents & POLLIN) != 0) {
+            _sendRing->clear_write_event();
+        }
+    }
+}
+
+auto IPCBase::write_frames(const Vector<std::span<const U8>>& buffers,
+                           U32 generation) -> bool {
+    std::lock_guard<std::mutex> lock(_sendMutex);
+    if (_socket < 0 || generation != _generation) {
+        return false;
+    }
+
+    Vector<iovec> iovs(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        iovs[i] = {const_cast<U8*>(buffers[i].data()), buffers[i].size()};
+    }
+
+    size_t first = 0;
+    while (first < iovs.size()) {
+        msghdr msg{};
+        msg.msg_iov = &iovs[first];
+        msg.msg_iovlen = minimum(iovs.size() - first, kMaxIovecs);
+        ssize_t res = sendmsg(_socket, &msg, MSG_NOSIGNAL);
+
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                if (errno == EPIPE || errno == ECONNRESET) {
+                    logERROR("send failed: socket closed at the other end.");
+                } else {
+                    logERROR("send failed: {}", strerror(errno));
+                }
+                shutdown(_socket, SHUT_RDWR);
+                return false;
+            }
+
+            // The peer is not reading fast enough:
+            std::array<pollfd, 2> pfds{
+                {{_socket, POLLOUT, 0}, {_wakeFd, POLLIN, 0}}};
+            int count = poll(pfds.data(), pfds.size(), I32(_timeout));
+            if (count == 0) {
+                // A partial frame was maybe written, so the connection
+                // can't be used anymore:
+                logERROR("send timed out after {}ms, closing the connection.",
+                         _timeout);
+                shutdown(_socket, SHUT_RDWR);
+                return false;
+            }
+            if (pfds[1].revents != 0) {
+                return false;
+            }
+            continue;
+        }
+
+        // Skip what was written:
+        auto written = static_cast<size_t>(res);
+        while (first < iovs.size() && written >= iovs[first].iov_len) {
+            written -= iovs[first].iov_len;
+            ++first;
+        }
+        if (written > 0) {
+            iovs[first].iov_base = static_cast<U8*>(iovs[first].iov_base) +
+                                   written;
+            iovs[first].iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+void IPCBase::handle_control_frame(const FrameHeader& header,
+                                   std::span<const U8> /*payload*/) {
+    if (header.flags != FRAME_SHM_RING || _recvFds.size() < 3) {
+        logWARN("Ignoring IPC control frame {}.", header.flags);
+        return;
+    }
+
+    auto ring = std::make_unique<ShmRing>();
+    bool attached = ring->attach(_recvFds[0], _recvFds[1], _recvFds[2]);
+    _recvFds.erase(_recvFds.begin(), _recvFds.begin() + 3);
+    if (!attached) {
+        return;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = ring->get_read_fd();
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    _recvRing = std::move(ring);
+    logDEBUG_CAT(ipc, "Receiving through a shared memory ring.");
+}
+
+void IPCBase::read_ring() {
+    while (_recvRing->has_record()) {
+        auto rec = _recvRing->peek();
+        emit_message(*_defaultChannel, rec.data(), rec.size());
+        _recvRing->release();
+    }
+}
+
+auto IPCBase::read_socket() -> bool {
+    auto space = recv_space();
+    alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))] = {};
+    iovec iov{space.data(), space.size()};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t bytesRead =
+        recvmsg(_socket, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+
+    if (bytesRead < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            return true;
+        }
+        if (errno == ECONNRESET) {
+            logNOTE("Connection reset by peer.");
+        } else {
+            logERROR("recv failed: {}", strerror(errno));
+        }
+        return false;
+    }
+
+    if (bytesRead == 0) {
+        // Connection closed gracefully
+        logNOTE("Connection closed (0 bytes read).");
+        return false;
+    }
+
+    // Keep the received descriptors for the control frame using them:
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const auto* fds = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+            _recvFds.insert(_recvFds.end(), fds, fds + count);
+        }
+    }
+
+    return process_frames(bytesRead);
+}
+
+void IPCBase::run() {
+    logDEBUG_CAT(ipc, "Entering IPC thread.");
+
+    while (_running) {
+        if (!establish_connection()) {
+            if (_running) {
+                wait_stopped(1000);
+            }
+            continue;
+        }
+
+        while (_running && _connected) {
+            int ringFd = -1;
+            if (_recvRing) {
+                read_ring();
+                if (!_recvRing->prepare_read_wait()) {
+                    continue;
+                }
+                ringFd = _recvRing->get_read_fd();
+            }
+
+            int fd = wait_readable(_socket, ringFd);
+            if (fd < 0) {
+                break;
+            }
+
+            if (fd == ringFd) {
+                _recvRing->clear_read_event();
+            } else if (!read_socket()) {
+                // Deliver what the peer wrote before closing:
+                if (_recvRing) {
+                    read_ring();
+                }
+                close_socket();
+                break;
+            }
+        }
+
+        cleanup_connection();
+
+        if (_running) {
+            wait_stopped(100);
+        }
+    }
+
+    logDEBUG_CAT(ipc, "IPC thread cleaning up...");
+    cleanup_connection();
+
+    logDEBUG_CAT(ipc, "Exiting IPC thread.");
+}
+
+// ============================================================================
+// IPCServer - Server-Specific Implementation
+// ============================================================================
+
+IPCServer::IPCServer(const String& pipeName) : IPCBase(pipeName) {}
+
+auto IPCServer::create_pipe() -> bool {
+    if (_listenSocket >= 0) {
+        return true;
+    }
+
+    sockaddr_un addr{};
+    socklen_t addrLen = get_socket_address(_pipeName, addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        logERROR("Failed to create IPC socket: {}", strerror(errno));
+        return false;
+    }
+
+    if (_pipeName.starts_with('/')) {
+        // Remove the file left by a previous server:
+        unlink(_pipeName.c_str());
+    }
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), addrLen) != 0 ||
+        listen(fd, 4) != 0) {
+        logERROR("Failed to bind IPC socket: {} ({})", _pipeName,
+                 strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev);
+    _listenSocket = fd;
+
+    logDEBUG_CAT(ipc, "IPC socket created: {}", _pipeName);
+    return true;
+}
+
+auto IPCServer::wait_for_connection() -> bool {
+    logDEBUG_CAT(ipc, "Waiting for IPC client connection...");
+
+    while (_running) {
+        if (wait_readable(_listenSocket) < 0) {
+            return false;
+        }
+
+        int fd = accept4(_listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) {
+                continue;
+            }
+            logERROR("accept failed: {}", strerror(errno));
+            return false;
+        }
+
+        attach_socket(fd);
+        _connected = true;
+        connected.emit();
+        logNOTE("IPC client connected!");
+        return true;
+    }
+
+    return false;
+}
+
+auto IPCServer::establish_connection() -> bool {
+    if (!create_pipe()) {
+        logERROR("Cannot create pipe instance.");
+        return false;
+    }
+
+    return wait_for_connection();
+}
+
+void IPCServer::cleanup_connection() {
+    close_socket();
+
+    // Keep listening between clients, until the server is stopped:
+    if (!_running && _listenSocket >= 0) {
+        close(_listenSocket);
+        _listenSocket = -1;
+        if (_pipeName.starts_with('/')) {
+            unlink(_pipeName.c_str());
+        }
+    }
+}
+
+// ============================================================================
+// IPCClient - Client-Specific Implementation
+// ============================================================================
+
+IPCClient::IPCClient(const String& pipeName) : IPCBase(pipeName) {}
+
+auto IPCClient::connect_to_server() -> bool {
+    sockaddr_un addr{};
+    socklen_t addrLen = get_socket_address(_pipeName, addr);
+
+    logDEBUG_CAT(ipc, "Attempting to connect to socket: {}", _pipeName);
+
+    while (_running) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            logERROR("Failed to create IPC socket: {}", strerror(errno));
+            return false;
+        }
+
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), addrLen) == 0) {
+            attach_socket(fd);
+            _connected = true;
+            connected.emit();
+            logNOTE("IPC connected to server!");
+            return true;
+        }
+
+        int err = errno;
+        close(fd);
+
+        if (err == ENOENT || err == ECONNREFUSED || err == EAGAIN) {
+            logDEBUG_CAT(ipc, "Socket not available, retrying in {}s...",
+                         _reconnectInterval);
+        } else {
+            logERROR("Failed to connect to socket: {} ({})", _pipeName,
+                     strerror(err));
+        }
+        wait_stopped(_reconnectInterval * 1000);
+    }
+
+    return false;
+}
+
+auto IPCClient::establish_connection() -> bool { return connect_to_server(); }
+
+void IPCClient::cleanup_connection() { close_socket(); }
+
+} // namespace nv
+
 #endif
@@ -4,27 +4,129 @@
 #include <nvk_common.h>
 
 #include <nvk/base/Signal.h>
+
+#include <optional>
+#include <span>
+
 namespace nv {
 
-// Base class with shared IPC functionality
+class IPCBase;
+class ShmRing;
+
+// Logical channel multiplexed over an IPC connection. The messages of the
+// channels with the highest priority are sent first, and large messages are
+// split in chunks so that they don't delay the other channels. Each channel
+// has a flow control window: at most that many bytes can be in flight before
+// the peer has received them, so a bulk transfer can't flood the connection
+// ahead of the other channels.
+class IPCChannel {
+    NV_DECLARE_NO_COPY(IPCChannel)
+    NV_DECLARE_NO_MOVE(IPCChannel)
+
+  public:
+    IPCChannel(IPCBase* owner, U16 id, I32 priority, U64 window);
+
+    auto send(const String& data) -> bool;
+    auto send_in_place(U32 size,
+                       const std::function<void(std::span<U8>)>& writer)
+        -> bool;
+
+    [[nodiscard]] auto get_id() const -> U16 { return _id; }
+    [[nodiscard]] auto get_priority() const -> I32 { return _priority; }
+    [[nodiscard]] auto get_window() const -> U64 { return _window; }
+
+    Signal<const String&> dataReceived;
+    Signal<std::span<const U8>> bufferReceived;
+
+  private:
+    friend class IPCBase;
+
+    IPCBase* _owner;
+    U16 _id;
+    I32 _priority;
+    U64 _window;
+
+    // Sender side (protected by the queue mutex of the owner): messages to
+    // send, bytes of the first one already sent, and bytes the peer can
+    // still accept.
+    Deque<U8Vector> _pending;
+    U64 _sentOffset{0};
+    U64 _queuedBytes{0};
+    U64 _credit{0};
+
+    // Receiver side (IPC thread): message being reassembled, and delivered
+    // bytes not acknowledged yet.
+    U8Vector _partial;
+    U64 _consumed{0};
+};
+
+// Base class with shared IPC functionality.
+// On Windows the connection is a named pipe (\\.\pipe\<name>). On Linux it
+// is a Unix domain stream socket (in the abstract namespace, or at the given
+// path if the name starts with '/'). The messages are sent as length
+// prefixed frames and reassembled on reception, so they can have any size.
+// send() only queues the message: a sender thread writes the queued frames
+// in batches (gathered in a single write), so callers don't block on a slow
+// peer.
+// The messages are sent on channel 0 unless add_channel() is used.
+// On Linux, set_shared_memory() sends the messages of channel 0 through a
+// shared memory ring instead (the socket is then only used to set it up and
+// to detect disconnections), to exchange large payloads without copies in
+// the kernel.
 class IPCBase : public RefObject {
   public:
+    static constexpr U64 MAX_MESSAGE_SIZE = 1ULL << 30;
+    static constexpr U64 DEFAULT_WINDOW = 16ULL * 1024 * 1024;
+
     explicit IPCBase(const String& pipeName);
     ~IPCBase() override;
 
-    // Send data
+    // Queue a message (up to MAX_MESSAGE_SIZE bytes). Blocks up to the
+    // timeout if the send queue is full.
     auto send(const String& data) -> bool;
 
+    // Send a message of size bytes written in place by writer (directly in
+    // the shared memory ring when it is used).
+    auto send_in_place(U32 size,
+                       const std::function<void(std::span<U8>)>& writer)
+        -> bool;
+
+    // Use a shared memory ring of ringSize bytes for the messages sent by
+    // this end (0 to use the pipe), applied on the next connection. The
+    // message size is then only limited by the ring size. Linux only.
+    void set_shared_memory(U64 ringSize) { _shmRingSize = ringSize; }
+
+    // Wait until the queued messages are written (up to the timeout).
+    auto flush() -> bool;
+
+    // Nagle-like coalescing: the sender thread waits up to delay
+    // microseconds for more messages before writing a small batch (0 to
+    // write as soon as possible).
+    void set_flush_delay(U32 delay) { _flushDelay = delay; }
+
+    // Size of the send queue (of each channel) above which send() blocks:
+    void set_max_queue_size(U64 size) { _maxQueueSize = size; }
+
+    // Add a logical channel (before start(), on both ends). Higher
+    // priorities are sent first. Channel 0 is the default one, used by
+    // send() and dataReceived.
+    auto add_channel(U16 id, I32 priority = 0, U64 window = DEFAULT_WINDOW)
+        -> IPCChannel&;
+    auto get_channel(U16 id) -> IPCChannel*;
+
     // Connection state
     [[nodiscard]] auto is_connected() const -> bool { return _connected; }
     [[nodiscard]] auto is_running() const -> bool { return _running; }
 
     // Timeout (milliseconds)
-    void set_timeout(DWORD timeout) { _timeout = timeout; }
+    void set_timeout(U32 timeout) { _timeout = timeout; }
 
     Signal<> connected;
     Signal<> disconnected;
     Signal<const String&> dataReceived;
+    // Same message as dataReceived, without copy (only valid during the
+    // call):
+    Signal<std::span<const U8>> bufferReceived;
 
     void start();
     void stop();
@@ -34,21 +136,136 @@ class IPCBase : public RefObject {
     virtual auto establish_connection() -> bool = 0;
     virtual void cleanup_connection() = 0;
 
+    // Header of each message on the wire:
+    struct FrameHeader {
+        U32 size;
+        U32 flags;
+    };
+
+    // The channel of a frame is in the 16 high bits of its flags.
+    enum FrameFlags : U32 {
+        // Last chunk of a message:
+        FRAME_LAST = 1,
+        // Control frame carrying the descriptors of a shared memory ring:
+        FRAME_SHM_RING = 2,
+        // Control frame returning flow control credit (U64 payload):
+        FRAME_WINDOW = 4,
+    };
+
+    friend class IPCChannel;
+
     // Shared helper methods
     void disconnect();
     void run();
+    void send_loop();
+
+    auto queue_message(IPCChannel& channel, U32 size,
+                       const std::function<void(std::span<U8>)>& writer)
+        -> bool;
+    void queue_control_frame(U32 flags, U64 value);
+    // Pick the next channel to send from (with the queue mutex locked):
+    auto next_channel() -> IPCChannel*;
+    [[nodiscard]] auto has_pending() const -> bool;
+    // Write a batch of frames (unless the connection they were queued for
+    // is gone), returns false if the connection failed (it is then shut
+    // down, as a partial frame may have been written, and the reader thread
+    // disconnects):
+    auto write_frames(const Vector<std::span<const U8>>& buffers,
+                      U32 generation) -> bool;
+
+    // Free space of the receive buffer, large enough for the pending frame:
+    auto recv_space() -> std::span<U8>;
+    // Dispatch the complete frames after reading count bytes, returns false
+    // on a protocol error:
+    auto process_frames(size_t count) -> bool;
+    void handle_control_frame(const FrameHeader& header,
+                              std::span<const U8> payload);
+    void handle_window_frame(const FrameHeader& header,
+                             std::span<const U8> payload);
+    // Returns false if the peer sent a message larger than MAX_MESSAGE_SIZE:
+    auto handle_chunk(const FrameHeader& header, std::span<const U8> payload)
+        -> bool;
+    void emit_message(IPCChannel& channel, const U8* data, size_t size);
 
     String _pipeName;
+#ifdef _WIN32
     HANDLE _pipeHandle{INVALID_HANDLE_VALUE};
     HANDLE _readEvent{INVALID_HANDLE_VALUE};  // Add this
     HANDLE _writeEvent{INVALID_HANDLE_VALUE}; // Add this
-    DWORD _timeout{5000};
+    // Set by the sender thread when a write failed, to have the reader
+    // thread close the connection:
+    std::atomic<bool> _writeFailed{false};
+#else
+    // Use fd as the connection socket:
+    void attach_socket(int fd);
+    void close_socket();
+    // Wait until fd or fd2 is readable, returns the ready descriptor or -1
+    // if woken up by stop():
+    auto wait_readable(int fd, int fd2 = -1) -> int;
+    // Sleep until stop() is called or the delay elapses:
+    void wait_stopped(U32 msecs);
+    void open_send_ring();
+    // Reserve a record in the send ring, waiting for space if needed:
+    auto reserve_record(U64 size) -> std::span<U8>;
+    // Send through the shared memory ring if there is one:
+    auto send_to_ring(U32 size,
+                      const std::function<void(std::span<U8>)>& writer)
+        -> std::optional<bool>;
+    // Read from the socket, returns false on disconnection:
+    auto read_socket() -> bool;
+    void read_ring();
+
+    int _socket{-1};
+    // Listening socket (server side only):
+    int _listenSocket{-1};
+    int _epollFd{-1};
+    // eventfd used to wake up the IPC thread on stop():
+    int _wakeFd{-1};
+    std::mutex _sendMutex;
+    // Ring written by this end, and ring written by the peer:
+    std::unique_ptr<ShmRing> _sendRing;
+    std::unique_ptr<ShmRing> _recvRing;
+    // Descriptors received with the socket data:
+    Vector<int> _recvFds;
+#endif
+    U64 _shmRingSize{0};
+    U32 _timeout{5000};
 
     std::atomic<bool> _connected{false};
     std::atomic<bool> _running{false};
 
     std::thread _readerThread;
+    std::thread _senderThread;
+
+    // Channels sorted by decreasing priority, and by id:
+    Vector<std::unique_ptr<IPCChannel>> _channels;
+    UnorderedMap<U16, IPCChannel*> _channelMap;
+    IPCChannel* _defaultChannel{nullptr};
+
+    // Send queues, shared with the sender thread:
+    std::mutex _queueMutex;
+    std::condition_variable _queueCondition;
+    Vector<U8Vector> _controlFrames;
+    U64 _queuedBytes{0};
+    // Last channel sent from, to serve the channels of the same priority in
+    // turn:
+    size_t _lastChannel{0};
+    U64 _maxQueueSize{64ULL * 1024 * 1024};
+    U32 _flushDelay{0};
+    bool _flushRequested{false};
+    bool _writing{false};
+    // Partially sent messages dropped by disconnect() while a batch still
+    // references them, released by the sender thread after the write:
+    Vector<U8Vector> _retiredMessages;
+    // Incremented on each disconnection, to drop the batches of a previous
+    // connection:
+    std::atomic<U32> _generation{0};
+
+    // Received bytes, starting at a frame boundary:
+    U8Vector _recvBuffer;
+    size_t _recvSize{0};
 
+    // Size of the reads from the connection:
     static constexpr size_t BUFFER_SIZE = 65536;
 
   private:
@@ -0,0 +1,305 @@
+// file: sources/nvk/network/ShmRing.cpp
+
+#include <nvk/network/ShmRing.h>
+
+#ifdef __linux__
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace nv {
+
+static constexpr U32 kShmRingMagic = 0x4E565352; // "NVSR"
+// Smallest page size on the supported platforms:
+static constexpr U64 kMinPageSize = 4096;
+static constexpr U64 kShmRecordHeader = 8;
+
+// Shared by both processes. The positions only grow, and the write (resp.
+// read) position is only modified by the producer (resp. consumer).
+struct ShmRing::Header {
+    U32 magic;
+    U32 headerSize;
+    U64 capacity;
+
+    alignas(64) std::atomic<U64> writePos;
+    std::atomic<U32> readerWaiting;
+
+    alignas(64) std::atomic<U64> readPos;
+    std::atomic<U32> writerWaiting;
+};
+
+static_assert(std::atomic<U64>::is_always_lock_free);
+static_assert(sizeof(ShmRing::Header) <= kMinPageSize);
+
+// The header takes a whole page so that the data area mappings are page
+// aligned:
+static auto get_header_size() -> U64 {
+    static const U64 pageSize = [] {
+        long size = sysconf(_SC_PAGESIZE);
+        return size > 0 ? U64(size) : kMinPageSize;
+    }();
+    return pageSize;
+}
+
+static auto record_span(U32 size) -> U64 {
+    return kShmRecordHeader + ((U64(size) + 7) & ~U64(7));
+}
+
+static void signal_event(int fd) {
+    U64 one = 1;
+    (void)!write(fd, &one, sizeof(one));
+}
+
+static void clear_event(int fd) {
+    U64 count = 0;
+    (void)!read(fd, &count, sizeof(count));
+}
+
+static auto poll_event(int fd, I32 timeoutMs) -> bool {
+    pollfd pfd{fd, POLLIN, 0};
+    int res = 0;
+    do {
+        res = poll(&pfd, 1, timeoutMs);
+    } while (res < 0 && errno == EINTR);
+    return res > 0;
+}
+
+ShmRing::~ShmRing() { close(); }
+
+auto ShmRing::create(U64 capacity) -> bool {
+    close();
+
+    // A power of two multiple of the page size:
+    U64 headerSize = get_header_size();
+    U64 cap = headerSize;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+
+    _memFd = memfd_create("nv_shm_ring", MFD_CLOEXEC);
+    _readFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    _writeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_memFd < 0 || _readFd < 0 || _writeFd < 0 ||
+        ftruncate(_memFd, static_cast<off_t>(headerSize + cap)) != 0) {
+        logERROR("Cannot create shared memory ring: {}", strerror(errno));
+        close();
+        return false;
+    }
+
+    if (!map(_memFd, cap)) {
+        close();
+        return false;
+    }
+
+    _header->magic = kShmRingMagic;
+    _header->headerSize = headerSize;
+    _header->capacity = cap;
+    return true;
+}
+
+auto ShmRing::attach(int memFd, int readFd, int writeFd) -> bool {
+    close();
+    _memFd = memFd;
+    _readFd = readFd;
+    _writeFd = writeFd;
+
+    // Read the capacity from the header first:
+    U64 headerSize = get_header_size();
+    void* ptr = mmap(nullptr, headerSize, PROT_READ, MAP_SHARED, memFd, 0);
+    if (ptr == MAP_FAILED) {
+        logERROR("Cannot map shared memory ring: {}", strerror(errno));
+        close();
+        return false;
+    }
+    const auto* header = static_cast<const Header*>(ptr);
+    U32 magic = header->magic;
+    U64 cap = header->capacity;
+    bool samePageSize = header->headerSize == headerSize;
+    munmap(ptr, headerSize);
+
+    if (magic != kShmRingMagic || !samePageSize || cap < headerSize ||
+        (cap & (cap - 1)) != 0) {
+        logERROR("Invalid shared memory ring.");
+        close();
+        return false;
+    }
+
+    if (!map(memFd, cap)) {
+        close();
+        return false;
+    }
+
+    _writePos = _header->writePos.load();
+    _readPos = _header->readPos.load();
+    return true;
+}
+
+auto ShmRing::map(int memFd, U64 capacity) -> bool {
+    // Reserve the address range, then map the data area twice after the
+    // header so that records wrapping around the end stay contiguous:
+    U64 headerSize = get_header_size();
+    U64 size = headerSize + 2 * capacity;
+    void* base =
+        mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        logERROR("Cannot reserve shared memory ring: {}", strerror(errno));
+        return false;
+    }
+
+    auto* ptr = static_cast<U8*>(base);
+    if (mmap(ptr, headerSize + capacity, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, memFd, 0) == MAP_FAILED ||
+        mmap(ptr + headerSize + capacity, capacity,
+             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memFd,
+             static_cast<off_t>(headerSize)) == MAP_FAILED) {
+        logERROR("Cannot map shared memory ring: {}", strerror(errno));
+        munmap(base, size);
+        return false;
+    }
+
+    _header = reinterpret_cast<Header*>(ptr);
+    _data = ptr + headerSize;
+    _capacity = capacity;
+    _mapSize = size;
+    return true;
+}
+
+void ShmRing::close() {
+    if (_header != nullptr) {
+        munmap(_header, _mapSize);
+        _header = nullptr;
+        _data = nullptr;
+    }
+    for (int* fd : {&_memFd, &_readFd, &_writeFd}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    _capacity = 0;
+    _mapSize = 0;
+    _writePos = 0;
+    _readPos = 0;
+    _recordSize = 0;
+}
+
+auto ShmRing::get_max_record_size() const -> U64 {
+    return _capacity - kShmRecordHeader;
+}
+
+auto ShmRing::free_space() -> U64 {
+    return _capacity - (_writePos - _readPos);
+}
+
+auto ShmRing::reserve(U32 size) -> std::span<U8> {
+    U64 needed = record_span(size);
+    if (needed > _capacity) {
+        return {};
+    }
+
+    if (free_space() < needed) {
+        _readPos = _header->readPos.load(std::memory_order_acquire);
+        if (free_space() < needed) {
+            return {};
+        }
+    }
+
+    _recordSize = size;
+    U8* rec = _data + (_writePos & (_capacity - 1));
+    return {rec + kShmRecordHeader, size};
+}
+
+void ShmRing::commit(U32 size) {
+    NVCHK(size <= _recordSize, "ShmRing: committing more than reserved.");
+    U8* rec = _data + (_writePos & (_capacity - 1));
+    memcpy(rec, &size, sizeof(size));
+
+    _writePos += record_span(size);
+    _header->writePos.store(_writePos);
+    if (_header->readerWaiting.load() != 0 &&
+        _header->readerWaiting.exchange(0) != 0) {
+        signal_event(_readFd);
+    }
+}
+
+auto ShmRing::has_record() -> bool {
+    if (_writePos == _readPos) {
+        _writePos = _header->writePos.load(std::memory_order_acquire);
+    }
+    return _writePos != _readPos;
+}
+
+auto ShmRing::peek() -> std::span<const U8> {
+    if (!has_record()) {
+        return {};
+    }
+
+    const U8* rec = _data + (_readPos & (_capacity - 1));
+    memcpy(&_recordSize, rec, sizeof(_recordSize));
+    NVCHK(record_span(_recordSize) <= _writePos - _readPos,
+          "ShmRing: corrupted record.");
+    return {rec + kShmRecordHeader, _recordSize};
+}
+
+void ShmRing::release() {
+    _readPos += record_span(_recordSize);
+    _recordSize = 0;
+    _header->readPos.store(_readPos);
+    if (_header->writerWaiting.load() != 0 &&
+        _header->writerWaiting.exchange(0) != 0) {
+        signal_event(_writeFd);
+    }
+}
+
+auto ShmRing::prepare_read_wait() -> bool {
+    // Announce the waiter before checking again, the producer checks in the
+    // opposite order after publishing:
+    _header->readerWaiting.store(1);
+    return !has_record();
+}
+
+auto ShmRing::prepare_write_wait(U32 size) -> bool {
+    _header->writerWaiting.store(1);
+    _readPos = _header->readPos.load();
+    return free_space() < record_span(size);
+}
+
+void ShmRing::clear_read_event() { clear_event(_readFd); }
+
+void ShmRing::clear_write_event() { clear_event(_writeFd); }
+
+auto ShmRing::wait_readable(I32 timeoutMs) -> bool {
+    while (!has_record()) {
+        if (prepare_read_wait()) {
+            if (!poll_event(_readFd, timeoutMs)) {
+                return has_record();
+            }
+            clear_read_event();
+        }
+    }
+    return true;
+}
+
+auto ShmRing::wait_writable(U32 size, I32 timeoutMs) -> bool {
+    if (record_span(size) > _capacity) {
+        return false;
+    }
+    while (free_space() < record_span(size)) {
+        if (prepare_write_wait(size)) {
+            if (!poll_event(_writeFd, timeoutMs)) {
+                _readPos = _header->readPos.load();
+                return free_space() >= record_span(size);
+            }
+            clear_write_event();
+        }
+    }
+    return true;
+}
+
+} // namespace nv
+
+#endif
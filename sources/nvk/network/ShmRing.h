@@ -0,0 +1,121 @@
+// file: sources/nvk/network/ShmRing.h
+
+#ifndef NV_SHMRING_H_
+#define NV_SHMRING_H_
+
+#include <nvk_common.h>
+
+#include <span>
+
+namespace nv {
+
+/** Single producer / single consumer ring of variable length records in
+    shared memory (Linux only).
+
+    The producer creates the ring and passes its file descriptors (see
+    get_fds()) to the consumer process, eg. with SCM_RIGHTS over a Unix
+    socket. The data area is mapped twice back to back, so every record is
+    contiguous in memory and can be written and read in place:
+
+        auto buf = ring.reserve(size); // fill buf...
+        ring.commit(size);
+
+        auto rec = ring.peek();        // use rec...
+        ring.release();
+
+    Each side blocks on an eventfd (which can also be added to an epoll
+    set), and the other side only signals it when a waiter has announced
+    itself, so a busy ring runs without syscalls. */
+class ShmRing {
+    NV_DECLARE_NO_COPY(ShmRing)
+    NV_DECLARE_NO_MOVE(ShmRing)
+
+  public:
+    struct Header;
+
+    ShmRing() = default;
+    ~ShmRing();
+
+    /** Create a ring of at least capacity bytes (rounded up to a power of
+     * two, and to at least one page). */
+    auto create(U64 capacity) -> bool;
+
+    /** Map a ring created in another process. Takes ownership of the file
+     * descriptors. */
+    auto attach(int memFd, int readFd, int writeFd) -> bool;
+
+    void close();
+
+    [[nodiscard]] auto is_open() const -> bool { return _header != nullptr; }
+    [[nodiscard]] auto get_capacity() const -> U64 { return _capacity; }
+
+    /** Largest record that fits in the ring. */
+    [[nodiscard]] auto get_max_record_size() const -> U64;
+
+    /** Memory, read event and write event descriptors to send to the
+     * consumer. */
+    [[nodiscard]] auto get_fds() const -> std::array<int, 3> {
+        return {_memFd, _readFd, _writeFd};
+    }
+
+    // Producer side:
+
+    /** Reserve size bytes for a record, or return an empty span if the ring
+     * is currently full. */
+    auto reserve(U32 size) -> std::span<U8>;
+
+    /** Publish the reserved record, with a final size no larger than the
+     * reserved one. */
+    void commit(U32 size);
+
+    /** Wait until a record of size bytes can be reserved (timeoutMs < 0 to
+     * wait forever). */
+    auto wait_writable(U32 size, I32 timeoutMs) -> bool;
+
+    // Consumer side:
+
+    /** Next record, or an empty span if there is none (check has_record()
+     * for empty records). The span stays valid until release(). */
+    auto peek() -> std::span<const U8>;
+    auto has_record() -> bool;
+    void release();
+
+    auto wait_readable(I32 timeoutMs) -> bool;
+
+    // Event loop integration: the read (resp. write) event descriptor
+    // becomes readable when data (resp. space) is available after a call to
+    // prepare_read_wait() (resp. prepare_write_wait()) which returned true.
+    // clear_*_event() must be called once the descriptor has fired.
+
+    [[nodiscard]] auto get_read_fd() const -> int { return _readFd; }
+    [[nodiscard]] auto get_write_fd() const -> int { return _writeFd; }
+
+    auto prepare_read_wait() -> bool;
+    auto prepare_write_wait(U32 size) -> bool;
+    void clear_read_event();
+    void clear_write_event();
+
+  private:
+    auto map(int memFd, U64 capacity) -> bool;
+    [[nodiscard]] auto free_space() -> U64;
+
+    Header* _header{nullptr};
+    U8* _data{nullptr};
+    U64 _capacity{0};
+    U64 _mapSize{0};
+
+    int _memFd{-1};
+    int _readFd{-1};
+    int _writeFd{-1};
+
+    // Local copies of the positions (the own one is authoritative, the
+    // other one is refreshed when needed):
+    U64 _writePos{0};
+    U64 _readPos{0};
+    // Size of the last reserved or peeked record:
+    U32 _recordSize{0};
+};
+
+} // namespace nv
+
+#endif
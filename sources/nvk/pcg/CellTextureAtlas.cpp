@@ -251,9 +251,10 @@ auto CellTextureAtlasLayout::resolve_footprint(const CellTextureEntry& entry,
     const I32 xslots = std::max(1, (pxSize.x() + _slotSize - 1) / _slotSize);
     const I32 yslots = std::max(1, (pxSize.y() + _slotSize - 1) / _slotSize);
 
-    logDEBUG("CellTextureAtlasLayout: '{}' auto-detected {}x{}px -> "
-             "{}x{} slots.",
-             entry.id, pxSize.x(), pxSize.y(), xslots, yslots);
+    logDEBUG_CAT(pcg,
+                 "CellTextureAtlasLayout: '{}' auto-detected {}x{}px -> "
+                 "{}x{} slots.",
+                 entry.id, pxSize.x(), pxSize.y(), xslots, yslots);
 
     return {xslots, yslots};
 }
@@ -312,11 +313,13 @@ void CellTextureAtlasLayout::place_entry(const CellTextureEntry& entry,
 
     desc.uv = compute_uv(desc.originPx, desc.sizePx);
 
-    logDEBUG("CellTextureAtlasLayout: id='{}' -> layer {} slot [{},{}] "
-             "size [{}x{}] content [{}x{}]px at [{},{}] pad {} ({}) uv {}.",
-             entry.id, layer, slot.x(), slot.y(), xsize, ysize, desc.sizePx.x(),
-             desc.sizePx.y(), desc.originPx.x(), desc.originPx.y(), pad,
-             desc.tiling ? "wrap" : "clamp", desc.uv);
+    logDEBUG_CAT(
+        pcg,
+        "CellTextureAtlasLayout: id='{}' -> layer {} slot [{},{}] "
+        "size [{}x{}] content [{}x{}]px at [{},{}] pad {} ({}) uv {}.",
+        entry.id, layer, slot.x(), slot.y(), xsize, ysize, desc.sizePx.x(),
+        desc.sizePx.y(), desc.originPx.x(), desc.originPx.y(), pad,
+        desc.tiling ? "wrap" : "clamp", desc.uv);
 
     auto res = _descById.insert(std::make_pair(entry.id, desc));
     NVCHK(res.second, "Could not insert CellTextureDesc: duplicated id: {}",
@@ -364,9 +367,9 @@ void CellTextureAtlasLayout::generate_style_map() {
             it.first, Vector<String>{it.second.begin(), it.second.end()}));
     }
 
-    logDEBUG("Generated style map:");
+    logDEBUG_CAT(pcg, "Generated style map:");
     for (const auto& it : _stylesMap) {
-        logDEBUG("  - {}: {}", it.first, it.second);
+        logDEBUG_CAT(pcg, "  - {}: {}", it.first, it.second);
     }
 };
 
@@ -416,9 +419,9 @@ void CellTextureAtlasLayout::generate_category_map() {
         }
     }
 
-    logDEBUG("Generated category maps:");
+    logDEBUG_CAT(pcg, "Generated category maps:");
     for (const auto& it : _categoryMap) {
-        logDEBUG("  - {}: {}", it.first, it.second);
+        logDEBUG_CAT(pcg, "  - {}: {}", it.first, it.second);
     }
 };
 
@@ -2,7 +2,73 @@
 #include <nvk/pcg/Point.h>
 #include <nvk/pcg/PointArray.h>
 
+#include <nvk/base/MappedFile.h>
+
+#include <fstream>
+
 namespace nv {
+
+namespace {
+
+// Columnar point file layout (native little-endian values):
+//   PointFileHeader
+//   PointFileColumn[numAttributes]
+//   attribute names (concatenated)
+//   tags: [U32 size][chars] x numTags
+//   columns, each starting on a kColumnAlignment boundary
+constexpr U32 kPointFileMagic = 0x4150564e; // "NVPA"
+constexpr U32 kPointFileVersion = 1;
+constexpr U32 kPointFileByteOrder = 0x01020304;
+constexpr U64 kColumnAlignment = 64;
+constexpr U32 kPointFileClosedLoop = 1;
+
+struct PointFileHeader {
+    U32 magic{kPointFileMagic};
+    U32 version{kPointFileVersion};
+    U32 byteOrder{kPointFileByteOrder};
+    U32 flags{0};
+    U64 numPoints{0};
+    U32 numAttributes{0};
+    U32 numTags{0};
+    U64 fileSize{0};
+};
+
+struct PointFileColumn {
+    U64 typeId{0};
+    U64 count{0};
+    U64 offset{0};
+    U64 byteSize{0};
+    U32 elementSize{0};
+    U32 nameSize{0};
+};
+
+static_assert(sizeof(PointFileHeader) == 40);
+static_assert(sizeof(PointFileColumn) == 40);
+
+template <typename... Ts> struct TypeList {};
+
+// Attribute types stored as raw columns (bool is stored as one byte per
+// value and loaded by copy):
+using ColumnTypes =
+    TypeList<U8, I8, U16, I16, U32, I32, U64, I64, F32, F64, Vec2f, Vec2d,
+             Vec2i, Vec2u, Vec3f, Vec3d, Vec3i, Vec3u, Vec4f, Vec4d, Vec4i,
+             Vec4u, Quatf, Quatd, Mat2f, Mat2d, Mat3f, Mat3d, Mat4f, Mat4d>;
+
+// Call func.template operator()<T>() for the column type with the given id.
+template <typename Func, typename... Ts>
+auto dispatch_column_type(StringID typeId, Func&& func, TypeList<Ts...>)
+    -> bool {
+    return ((typeId == TypeId<Ts>::id
+                 ? (func.template operator()<Ts>(), true)
+                 : false) ||
+            ...);
+}
+
+auto align_offset(U64 offset) -> U64 {
+    return (offset + kColumnAlignment - 1) & ~(kColumnAlignment - 1);
+}
+
+} // namespace
 PointArray::PointArray(Traits traits) : _traits(std::move(traits)) {};
 
 PointArray::~PointArray() = default;
@@ -353,8 +419,195 @@ auto PointArray::compute_area() const -> F64 {
         return 0.0;
     }
 
-    const auto* positions = find<Vec3d>(pt_position_attr);
-    return polygon_signed_area_xy(positions->data(), positions->size());
+    auto positions = find<Vec3d>(pt_position_attr);
+    return polygon_signed_area_xy(positions.data(), positions.size());
 };
 
+void PointArray::save_binary(const String& filename) const {
+    // Sorted attributes, for reproducible files:
+    Vector<const PointAttribute*> attribs;
+    for (const auto& it : _attributes) {
+        attribs.push_back(it.second.get());
+    }
+    std::sort(attribs.begin(), attribs.end(),
+              [](const auto* lhs, const auto* rhs) {
+                  return lhs->name() < rhs->name();
+              });
+
+    PointFileHeader header;
+    header.numPoints = get_num_points();
+    header.numAttributes = (U32)attribs.size();
+    header.numTags = (U32)_tags.size();
+    header.flags = _traits.closedLoop ? kPointFileClosedLoop : 0;
+
+    // Collect the column descriptors and payloads:
+    Vector<PointFileColumn> columns(attribs.size());
+    Vector<std::span<const U8>> payloads(attribs.size());
+    Vector<U8Vector> boolColumns;
+    boolColumns.reserve(attribs.size());
+    U64 offset = sizeof(PointFileHeader) +
+                 sizeof(PointFileColumn) * attribs.size();
+
+    for (size_t i = 0; i < attribs.size(); ++i) {
+        const auto& attr = *attribs[i];
+        auto& col = columns[i];
+        col.typeId = attr.get_type_id();
+        col.count = attr.size();
+        col.nameSize = (U32)attr.name().size();
+        offset += col.nameSize;
+
+        if (attr.is_type<bool>()) {
+            const auto& values = attr.get_values<bool>();
+            auto& bytes =
+                boolColumns.emplace_back(values.begin(), values.end());
+            col.elementSize = 1;
+            payloads[i] = {bytes.data(), bytes.size()};
+            continue;
+        }
+
+        bool found = dispatch_column_type(
+            col.typeId,
+            [&]<typename T>() {
+                auto values = attr.get_span<T>();
+                col.elementSize = sizeof(T);
+                payloads[i] = {(const U8*)values.data(), values.size_bytes()};
+            },
+            ColumnTypes{});
+        NVCHK(found, "PointArray::save_binary: unsupported type for {}",
+              attr.name());
+    }
+
+    for (const auto& tag : _tags) {
+        offset += sizeof(U32) + tag.size();
+    }
+
+    for (size_t i = 0; i < columns.size(); ++i) {
+        offset = align_offset(offset);
+        columns[i].offset = offset;
+        columns[i].byteSize = payloads[i].size();
+        offset += payloads[i].size();
+    }
+    header.fileSize = offset;
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    NVCHK(file.is_open(), "Cannot open file {} for writing", filename);
+
+    U64 pos = 0;
+    auto write = [&](const void* data, size_t size) {
+        file.write((const char*)data, (std::streamsize)size);
+        pos += size;
+    };
+
+    write(&header, sizeof(header));
+    write(columns.data(), sizeof(PointFileColumn) * columns.size());
+    for (const auto* attr : attribs) {
+        write(attr->name().data(), attr->name().size());
+    }
+    for (const auto& tag : _tags) {
+        auto size = (U32)tag.size();
+        write(&size, sizeof(size));
+        write(tag.data(), tag.size());
+    }
+
+    static const std::array<char, kColumnAlignment> padding{};
+    for (size_t i = 0; i < columns.size(); ++i) {
+        write(padding.data(), columns[i].offset - pos);
+        write(payloads[i].data(), payloads[i].size());
+    }
+
+    file.close();
+    NVCHK(!file.fail(), "PointArray::save_binary: failed to write {}",
+          filename);
+}
+
+auto PointArray::load_mapped(const String& filename) -> RefPtr<PointArray> {
+    auto mapping = nv::create<MappedFile>(filename);
+    const U8* base = mapping->data();
+    U64 fileSize = mapping->size();
+
+    PointFileHeader header;
+    NVCHK(fileSize >= sizeof(header), "Invalid point file {}", filename);
+    memcpy(&header, base, sizeof(header));
+    NVCHK(header.magic == kPointFileMagic, "Invalid point file {}", filename);
+    NVCHK(header.version == kPointFileVersion,
+          "Unsupported point file version {} in {}", header.version,
+          filename);
+    NVCHK(header.byteOrder == kPointFileByteOrder,
+          "Point file {} has a different byte order", filename);
+    NVCHK(header.fileSize <= fileSize, "Truncated point file {}", filename);
+    NVCHK(header.numPoints <= (U64)std::numeric_limits<I32>::max(),
+          "Too many points in {}", filename);
+
+    U64 pos = sizeof(header);
+    NVCHK(header.numAttributes <=
+              (fileSize - pos) / sizeof(PointFileColumn),
+          "Invalid point file {}", filename);
+    Vector<PointFileColumn> columns(header.numAttributes);
+    memcpy(columns.data(), base + pos,
+           sizeof(PointFileColumn) * columns.size());
+    pos += sizeof(PointFileColumn) * columns.size();
+
+    auto read_string = [&](U64 size) {
+        NVCHK(size <= fileSize - pos, "Truncated point file {}", filename);
+        String str((const char*)base + pos, size);
+        pos += size;
+        return str;
+    };
+
+    Vector<String> names;
+    for (const auto& col : columns) {
+        names.push_back(read_string(col.nameSize));
+    }
+
+    Set<String> tags;
+    for (U32 i = 0; i < header.numTags; ++i) {
+        NVCHK(sizeof(U32) <= fileSize - pos, "Truncated point file {}",
+              filename);
+        U32 size = 0;
+        memcpy(&size, base + pos, sizeof(size));
+        pos += sizeof(size);
+        tags.insert(read_string(size));
+    }
+
+    Traits traits;
+    traits.closedLoop = (header.flags & kPointFileClosedLoop) != 0;
+    auto arr = create((I32)header.numPoints, traits);
+    arr->add_tags(tags);
+
+    for (size_t i = 0; i < columns.size(); ++i) {
+        const auto& col = columns[i];
+        const auto& name = names[i];
+        NVCHK(col.count == header.numPoints &&
+                  col.offset % kColumnAlignment == 0 &&
+                  col.offset <= fileSize &&
+                  col.byteSize <= fileSize - col.offset &&
+                  col.byteSize == col.count * col.elementSize,
+              "Invalid column {} in point file {}", name, filename);
+        const U8* data = base + col.offset;
+
+        if (col.typeId == TypeId<bool>::id) {
+            NVCHK(col.elementSize == 1, "Invalid column {} in {}", name,
+                  filename);
+            Vector<bool> values(data, data + col.count);
+            arr->add_attribute(
+                PointAttribute::create<bool>(name, std::move(values)));
+            continue;
+        }
+
+        bool found = dispatch_column_type(
+            col.typeId,
+            [&]<typename T>() {
+                NVCHK(col.elementSize == sizeof(T),
+                      "Invalid element size in column {} of {}", name,
+                      filename);
+                arr->add_attribute(PointAttribute::create_mapped<T>(
+                    name, (const T*)data, col.count, mapping));
+            },
+            ColumnTypes{});
+        NVCHK(found, "Unsupported type for column {} in {}", name, filename);
+    }
+
+    return arr;
+}
+
 } // namespace nv
@@ -72,13 +72,17 @@ class PointArray : public RefObject {
     auto get_attribute(const String& name) const -> const PointAttribute&;
     auto get_attribute(const String& name) -> PointAttribute&;
 
+    // Read-only values of an attribute (empty if not found), without
+    // copying mapped values:
     template <typename T>
-    auto find(const String& name) const -> const Vector<T>* {
+    auto find(const String& name) const -> std::span<const T> {
+        static_assert(!std::is_same_v<T, bool>,
+                      "Use get_attribute() for bool values.");
         const auto* attr = find_attribute(name);
         if (attr != nullptr && attr->is_type<T>()) {
-            return &attr->get_values<T>();
+            return attr->get_values<T>();
         }
-        return nullptr;
+        return {};
     };
     template <typename T> auto find(const String& name) -> Vector<T>* {
         auto* attr = find_attribute(name);
@@ -159,6 +163,17 @@ class PointArray : public RefObject {
     /** Compute the polygon area */
     auto compute_area() const -> F64;
 
+    /** Write the points to a columnar binary file: a header listing the
+     * attribute names, type ids and sizes, followed by the raw attribute
+     * values, each column starting on a 64-byte boundary. */
+    void save_binary(const String& filename) const;
+
+    /** Open a file written by save_binary() without reading the values:
+     * the attribute columns are memory mapped read-only, and copied to
+     * memory when they get modified (or accessed as a Vector). Use
+     * PointAttribute::get_span() for read-only access without copy. */
+    static auto load_mapped(const String& filename) -> RefPtr<PointArray>;
+
   protected:
     Traits _traits;
     PointAttributeMap _attributes;
@@ -3,6 +3,8 @@
 
 #include <nvk_common.h>
 
+#include <span>
+
 namespace nv {
 
 class PointAttribute : public RefObject {
@@ -21,6 +23,15 @@ class PointAttribute : public RefObject {
     virtual void randomize() = 0;
     virtual auto clone() const -> RefPtr<PointAttribute> = 0;
 
+    /** True while the values are read from a memory mapped file (see
+     * PointArray::load_mapped()). The values are copied to memory on the
+     * first mutable access (copy-on-write), the const accessors read them
+     * in place. */
+    virtual auto is_mapped() const -> bool = 0;
+
+    /** Copy mapped values to memory (no-op if the values are not mapped). */
+    virtual void detach() = 0;
+
     auto name() const -> const String& { return _name; }
     auto get_type_id() const -> StringID { return _typeId; }
 
@@ -49,10 +60,29 @@ class PointAttribute : public RefObject {
         return static_cast<AttributeHolder<T>*>(this)->retrieve_values();
     }
 
-    template <typename T> auto get_values() const -> const Vector<T>& {
+    // Read-only values: a span, without copying mapped values (bool values
+    // are packed, and never mapped, so they are returned as a Vector):
+    template <typename T>
+    using ConstValues = std::conditional_t<std::is_same_v<T, bool>,
+                                           const Vector<bool>&,
+                                           std::span<const T>>;
+
+    template <typename T> auto get_values() const -> ConstValues<T> {
         NVCHK(_typeId == TypeId<T>::id,
               "PointAttribute::get_values: type mismatch.");
-        return static_cast<const AttributeHolder<T>*>(this)->retrieve_values();
+        const auto* holder = static_cast<const AttributeHolder<T>*>(this);
+        if constexpr (std::is_same_v<T, bool>) {
+            return holder->retrieve_values();
+        } else {
+            return holder->retrieve_span();
+        }
+    }
+
+    // Read-only access to the values, without copying mapped values
+    template <typename T> auto get_span() const -> std::span<const T> {
+        NVCHK(_typeId == TypeId<T>::id,
+              "PointAttribute::get_span: type mismatch.");
+        return static_cast<const AttributeHolder<T>*>(this)->retrieve_span();
     }
 
     // Get single value at index
@@ -96,6 +126,17 @@ class PointAttribute : public RefObject {
             std::move(name), std::move(values), std::move(traits));
     }
 
+    // Create an attribute reading count values from mapped memory, kept
+    // alive by the mapping object.
+    template <typename T>
+    static auto create_mapped(String name, const T* data, U64 count,
+                              RefPtr<RefObject> mapping, Traits traits = {})
+        -> RefPtr<PointAttribute> {
+        return nv::create<AttributeHolder<T>>(std::move(name), data, count,
+                                              std::move(mapping),
+                                              std::move(traits));
+    }
+
   protected:
     Traits _traits;
     String _name;
@@ -198,36 +239,91 @@ class PointAttribute::AttributeHolder : public PointAttribute {
         _typeId = TypeId<T>::id;
     }
 
-    void assign_values(Vector<T>&& values) { _values = std::move(values); }
-    void assign_values(const Vector<T>& values) { _values = values; }
+    AttributeHolder(String name, const T* data, U64 count,
+                    RefPtr<RefObject> mapping, Traits traits)
+        : PointAttribute(std::move(name), std::move(traits)),
+          _mapping(std::move(mapping)), _mappedData(data),
+          _mappedSize(count) {
+        static_assert(!std::is_same_v<T, bool>,
+                      "Cannot map packed bool values.");
+        _typeId = TypeId<T>::id;
+    }
 
-    auto retrieve_values() -> Vector<T>& { return _values; }
-    auto retrieve_values() const -> const Vector<T>& { return _values; }
+    void assign_values(Vector<T>&& values) {
+        release_mapping();
+        _values = std::move(values);
+    }
+    void assign_values(const Vector<T>& values) {
+        release_mapping();
+        _values = values;
+    }
+
+    auto retrieve_values() -> Vector<T>& {
+        detach_values();
+        return _values;
+    }
+    // Values in memory (not valid while mapped):
+    auto retrieve_values() const -> const Vector<T>& {
+        NVCHK(_mapping == nullptr,
+              "PointAttribute::retrieve_values: values are mapped.");
+        return _values;
+    }
+
+    auto retrieve_span() const -> std::span<const T> {
+        if constexpr (std::is_same_v<T, bool>) {
+            THROW_MSG("PointAttribute::get_span: not supported for bool.");
+        } else if (_mapping != nullptr) {
+            return {_mappedData, _mappedSize};
+        } else {
+            return {_values.data(), _values.size()};
+        }
+    }
 
     auto retrieve_value(U64 index) const -> const T& {
-        NVCHK(index < _values.size(),
+        NVCHK(index < size(),
               "PointAttribute::retrieve_value: index {} out of bounds (size: "
               "{})",
-              index, _values.size());
+              index, size());
+        if (_mapping != nullptr) {
+            return _mappedData[index];
+        }
         return _values[index];
     }
 
     void assign_value(U64 index, T&& value) {
+        detach_values();
         NVCHK(index < _values.size(),
               "PointAttribute::assign_value: index {} out of bounds (size: {})",
               index, _values.size());
         _values[index] = std::forward<T>(value);
     }
 
-    void resize(U32 size) override { _values.resize(size); }
-    auto size() const -> U64 override { return _values.size(); }
+    void resize(U32 size) override {
+        detach_values();
+        _values.resize(size);
+    }
+    auto size() const -> U64 override {
+        return _mapping != nullptr ? _mappedSize : _values.size();
+    }
     auto element_size() const -> U32 override { return sizeof(T); }
 
-    // Clone implementation - creates a deep copy
+    // Clone implementation - creates a deep copy (mapped values are shared
+    // until one of the copies is modified)
     auto clone() const -> RefPtr<PointAttribute> override {
-        return nv::create<AttributeHolder<T>>(_name, _values, _traits);
+        if constexpr (!std::is_same_v<T, bool>) {
+            if (_mapping != nullptr) {
+                return nv::create<AttributeHolder<T>>(
+                    _name, _mappedData, _mappedSize, _mapping, _traits);
+            }
+        }
+        return nv::create<AttributeHolder<T>>(_name, retrieve_values(),
+                                              _traits);
     }
 
+    auto is_mapped() const -> bool override { return _mapping != nullptr; }
+
+    void detach() override { detach_values(); }
+
     // Default randomization using traits defaults
     void randomize() override {
         if constexpr (RandomizationTraits<T>::supported) {
@@ -244,6 +340,7 @@ class PointAttribute::AttributeHolder : public PointAttribute {
     // Randomization with custom range
     void randomize_with_range(const T& min, const T& max) {
         if constexpr (RandomizationTraits<T>::supported) {
+            detach_values();
             if (!_values.empty()) {
                 RandomizationTraits<T>::fill(
                     _values.data(), static_cast<U32>(_values.size()), min, max);
@@ -258,6 +355,26 @@ class PointAttribute::AttributeHolder : public PointAttribute {
 
   protected:
     Vector<T> _values;
+
+    // Read-only mapped values, used until the first modification (only
+    // the non-const accessors detach them, so concurrent const readers
+    // don't race):
+    RefPtr<RefObject> _mapping;
+    const T* _mappedData{nullptr};
+    U64 _mappedSize{0};
+
+    void detach_values() {
+        if (_mapping != nullptr) {
+            _values.assign(_mappedData, _mappedData + _mappedSize);
+            release_mapping();
+        }
+    }
+
+    void release_mapping() {
+        _mapping.reset();
+        _mappedData = nullptr;
+        _mappedSize = 0;
+    }
 };
 
 using PointAttributeVector = Vector<RefPtr<PointAttribute>>;
@@ -2,6 +2,7 @@
 #define _OVERTURE_MAPS_H_
 
 #include <nvk/geometry/geometry2d.h>
+#include <nvk/io/MsgpackSchema.h>
 
 namespace nv {
 // land_use_mask — pixel value is the LandUseClass enum cast to U8.
@@ -202,11 +203,14 @@ struct CellVertex {
     F32 u0, v0;
     F32 texIdx;
 };
+NV_MSGPACK_FIELDS(CellVertex, px, py, pz, nx, ny, nz, u0, v0, texIdx)
+NV_MSGPACK_COLUMNAR(CellVertex)
 
 struct TileGeom {
     Vector<CellVertex> verts;
     Vector<U32> indices;
 };
+NV_MSGPACK_FIELDS(TileGeom, verts, indices)
 
 // One road cross-section. left/right are world-XY (cm). z is the shared
 // surface elevation (cm, terrain max under the cross-section, WITHOUT the road
@@ -220,6 +224,7 @@ struct RoadRib {
     F64 z{0.0};
     F64 u{0.0};
 };
+NV_MSGPACK_FIELDS(RoadRib, left, right, z, u)
 
 struct RoadConnectorInfos {
     F64 elev{0.0};
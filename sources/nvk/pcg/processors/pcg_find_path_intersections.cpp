@@ -9,7 +9,7 @@ void pcg_find_path_2d_intersections(PCGContext& ctx) {
     auto& in = ctx.inputs();
 
     auto paths = in.get_raw_slot("In").as_vector<RefPtr<PointArray>>();
-    logDEBUG("Processing {} input paths.", paths.size());
+    logDEBUG_CAT(pcg, "Processing {} input paths.", paths.size());
 
     F64 endPointDist = in.get("EndPointSnapDistance", 0.0);
 
@@ -26,12 +26,13 @@ void pcg_find_path_2d_intersections(PCGContext& ctx) {
 
         // Add all the points from this path:
         if (pos.is_type<Vec3d>()) {
-            const auto& arr = pos.get_values<Vec3d>();
+            auto arr = pos.get_values<Vec3d>();
             for (const auto& p : arr) {
                 line.points.emplace_back(p.x(), p.y());
             }
         } else if (pos.is_type<Vec2d>()) {
-            line.points = pos.get_values<Vec2d>();
+            auto arr = pos.get_values<Vec2d>();
+            line.points.assign(arr.begin(), arr.end());
         }
 
         lines.emplace_back(std::move(line));
@@ -4,11 +4,11 @@
 namespace nv {
 
 ResourceLoader::ResourceLoader() {
-    logTRACE("Creating ResourceLoader object.");
+    logTRACE_CAT(resource, "Creating ResourceLoader object.");
 }
 
 ResourceLoader::~ResourceLoader() {
-    logTRACE("Deleting ResourceLoader object.");
+    logTRACE_CAT(resource, "Deleting ResourceLoader object.");
 }
 
 auto ResourceLoader::find_resource(const char* name, String& fullpath) -> bool {
@@ -38,11 +38,11 @@ auto ResourceLoader::add_path(const char* path) -> bool {
     // We should not add a path multiple times, so we ensure here it is not
     // already in the list:
     if (find(_paths.begin(), _paths.end(), newpath) != _paths.end()) {
-        logTRACE("Resource path {} already registered.", newpath);
+        logTRACE_CAT(resource, "Resource path {} already registered.", newpath);
         return false;
     }
 
-    logTRACE("Adding resource search path: '{}'", newpath);
+    logTRACE_CAT(resource, "Adding resource search path: '{}'", newpath);
     _paths.push_back(newpath);
     return true;
 }
@@ -74,7 +74,7 @@ auto ResourceLoader::get_resource(const char* resName) -> RefPtr<RefObject> {
     }
 
     // We have a fullpath, so we load the corresponding resource:
-    logTRACE("Loading resource from file: {}", fullpath.c_str());
+    logTRACE_CAT(resource, "Loading resource from file: {}", fullpath.c_str());
     RefPtr<RefObject> res = load_resource(fullpath.c_str());
     NVCHK(res != nullptr, "Cannot load resource for {}", resName);
 
@@ -1,5 +1,7 @@
 // Implementation for ResourceManager
 
+#include <nvk/base/MappedFile.h>
+#include <nvk/io/AsyncFileIO.h>
 #include <nvk/resource/ResourceManager.h>
 
 #include <algorithm>
@@ -161,6 +163,24 @@ auto ResourceManager::read_virtual_file(const String& fname,
     return {};
 }
 
+auto ResourceManager::map_virtual_file(const String& fname,
+                                       bool forceAllowSystem)
+    -> RefPtr<MappedFile> {
+    if ((_useSystemFiles || forceAllowSystem)) {
+        if (system_file_exists(fname)) {
+            return nv::create<MappedFile>(fname);
+        }
+
+        String f_path = get_path(get_root_path(), fname);
+        if (system_file_exists(f_path)) {
+            return nv::create<MappedFile>(f_path);
+        }
+    }
+
+    // Files from the resource packs are decompressed in memory anyway:
+    return MappedFile::from_buffer(read_virtual_file(fname, false));
+}
+
 auto ResourceManager::validate_resource_path(StringID category,
                                              const char* filename) -> String {
     String full_path = filename;
@@ -219,9 +239,9 @@ auto ResourceManager::get_file_last_write_time(const String& fname)
 }
 
 void ResourceManager::register_resource_packs(const StringVector& packFiles) {
-    logDEBUG("Loading {} resource packs", packFiles.size());
+    logDEBUG_CAT(resource, "Loading {} resource packs", packFiles.size());
     for (const auto& packFile : packFiles) {
-        logDEBUG("Loading resource pack {}...", packFile);
+        logDEBUG_CAT(resource, "Loading resource pack {}...", packFile);
         add_resource_pack(packFile);
     }
 
@@ -325,16 +345,12 @@ auto ResourceManager::read_virtual_file_async(const String& fname,
     -> Promise<String> {
     if ((_useSystemFiles || forceAllowSystem)) {
         if (system_file_exists(fname)) {
-            return make_promise<String>([fname](Defer d) {
-                d.resolve(read_system_file(fname.c_str()));
-            });
+            return AsyncFileIO::instance().read_file_string(fname);
         }
 
         String f_path = get_path(get_root_path(), fname);
         if (system_file_exists(f_path)) {
-            return make_promise<String>([fname](Defer d) {
-                d.resolve(read_system_file(fname.c_str()));
-            });
+            return AsyncFileIO::instance().read_file_string(f_path);
         }
     }
 
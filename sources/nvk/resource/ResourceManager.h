@@ -52,6 +52,11 @@ class ResourceManager {
     auto read_virtual_file(const String& fname, bool forceAllowSystem = false)
         -> String;
 
+    /** Map a virtual file without copy if it's a system file, or read it
+     * from the resource packs into the returned buffer otherwise. */
+    auto map_virtual_file(const String& fname, bool forceAllowSystem = false)
+        -> RefPtr<MappedFile>;
+
     auto read_virtual_file_async(const String& fname,
                                  bool forceAllowSystem = false)
         -> Promise<String>;
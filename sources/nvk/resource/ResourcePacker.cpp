@@ -1,47 +1,311 @@
+#include <nvk/base/MappedFile.h>
+#include <nvk/io/AsyncFileIO.h>
 #include <nvk/resource/ResourcePacker.h>
 
 #include <openssl/aes.h>
 #include <openssl/evp.h>
+#include <openssl/rand.h>
 #include <zlib.h>
 
 namespace nv {
 
-auto ResourcePacker::compress_data(const U8Vector& input) -> U8Vector {
-    z_stream zs;
-    std::memset(&zs, 0, sizeof(zs));
+// zlib and OpenSSL take 32 bits sizes, larger buffers are processed in
+// pieces of this size:
+static constexpr U64 kMaxStepSize = 1ULL << 30;
+// Source files are read (and the pack entries produced) by chunks of this
+// size:
+static constexpr U64 kReadChunkSize = 4ULL * 1024 * 1024;
+// Max size of the entries produced ahead of the one being written:
+static constexpr U64 kMaxBufferedBytes = 256ULL * 1024 * 1024;
+
+static auto pack_name_hash(std::string_view name) -> U64 {
+    U64 hash = hash_64_fnv1a(name.data(), name.size());
+    return hash != 0 ? hash : 1;
+}
 
-    if (deflateInit(&zs, Z_BEST_COMPRESSION) != Z_OK) {
-        THROW_MSG("zlib initialization failed");
+auto PackIndex::get_name(const PackIndexSlot& slot) const
+    -> std::string_view {
+    if (slot.nameOffset > namesSize ||
+        slot.nameLength > namesSize - slot.nameOffset) {
+        return {};
     }
+    return {names + slot.nameOffset, slot.nameLength};
+}
 
-    zs.next_in = (Bytef*)input.data();
-    zs.avail_in = static_cast<uInt>(input.size());
+auto PackIndex::find(std::string_view name) const -> const PackIndexSlot* {
+    U64 hash = pack_name_hash(name);
+    U64 mask = slotCount - 1;
+    for (U64 i = 0; i < slotCount; ++i) {
+        const auto& slot = slots[(hash + i) & mask];
+        if (slot.hash == 0) {
+            return nullptr;
+        }
+        if (slot.hash == hash && get_name(slot) == name) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
 
-    int ret;
-    char outbuffer[32768];
-    U8Vector compressed;
+auto build_pack_index(const Vector<FileEntry>& entries,
+                      Vector<PackIndexSlot>& slots, String& names) -> U64 {
+    // Keep the table at most half full:
+    U64 slotCount = 1;
+    while (slotCount < 2 * entries.size()) {
+        slotCount *= 2;
+    }
+    slots.assign(slotCount, PackIndexSlot{});
+    names.clear();
+
+    U64 mask = slotCount - 1;
+    U64 count = 0;
+    for (const auto& entry : entries) {
+        NVCHK(entry.name.size() <= 0xFFFFFFFF, "Invalid pack entry name.");
+        U64 hash = pack_name_hash(entry.name);
+        U64 idx = hash & mask;
+        while (slots[idx].hash != 0 &&
+               (slots[idx].hash != hash ||
+                names.compare(slots[idx].nameOffset, slots[idx].nameLength,
+                              entry.name) != 0)) {
+            idx = (idx + 1) & mask;
+        }
 
-    do {
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
+        auto& slot = slots[idx];
+        if (slot.hash == 0) {
+            slot.hash = hash;
+            slot.nameOffset = names.size();
+            slot.nameLength = (U32)entry.name.size();
+            names += entry.name;
+            ++count;
+        }
+        slot.checksum = entry.checksum;
+        slot.offset = entry.offset;
+        slot.originalSize = entry.originalSize;
+        slot.compressedSize = entry.compressedSize;
+        slot.encryptedSize = entry.encryptedSize;
+    }
 
-        ret = deflate(&zs, Z_FINISH);
+    return count;
+}
 
-        if (compressed.size() < zs.total_out) {
-            compressed.insert(compressed.end(), outbuffer,
-                              outbuffer + (zs.total_out - compressed.size()));
+// Same as compute_data_checksum(), over consecutive chunks:
+static auto update_checksum(U32 checksum, std::span<const U8> data) -> U32 {
+    for (auto byte : data) {
+        checksum = (checksum << 1) ^ byte;
+    }
+    return checksum;
+}
+
+// Streaming zlib compression followed by AES-256-CBC encryption, giving the
+// same output as compressing and encrypting the whole data at once:
+class EntryEncoder {
+    NV_DECLARE_NO_COPY(EntryEncoder)
+    NV_DECLARE_NO_MOVE(EntryEncoder)
+
+  public:
+    EntryEncoder(const U8Vector& key, const U8Vector& iv, I32 level)
+        : _key(key), _iv(iv), _buffer(64 * 1024) {
+        NVCHK(key.size() == 32 && iv.size() == 16, "Invalid key size.");
+        if (deflateInit(&_zs, level) != Z_OK) {
+            THROW_MSG("zlib initialization failed");
         }
-    } while (ret == Z_OK);
+        _ctx = EVP_CIPHER_CTX_new();
+        if (_ctx == nullptr ||
+            EVP_EncryptInit_ex(_ctx, EVP_aes_256_cbc(), nullptr, key.data(),
+                               iv.data()) != 1) {
+            deflateEnd(&_zs);
+            EVP_CIPHER_CTX_free(_ctx);
+            THROW_MSG("Failed to initialize encryption");
+        }
+    }
 
-    deflateEnd(&zs);
+    ~EntryEncoder() {
+        deflateEnd(&_zs);
+        EVP_CIPHER_CTX_free(_ctx);
+    }
 
-    if (ret != Z_STREAM_END) {
-        THROW_MSG("Error during compression");
+    // Start a new entry (cheaper than a new encoder):
+    void reset() {
+        if (deflateReset(&_zs) != Z_OK ||
+            EVP_EncryptInit_ex(_ctx, nullptr, nullptr, _key.data(),
+                               _iv.data()) != 1) {
+            THROW_MSG("Failed to reset the entry encoder");
+        }
+        _compressedSize = 0;
+    }
+
+    // Append the output for a chunk of the input data to out:
+    void update(std::span<const U8> data, U8Vector& out) {
+        _zs.next_in = (Bytef*)data.data();
+        _zs.avail_in = (uInt)data.size();
+        while (_zs.avail_in > 0) {
+            deflate_step(Z_NO_FLUSH, out);
+        }
     }
 
-    return compressed;
+    void finish(U8Vector& out) {
+        int ret = Z_OK;
+        do {
+            ret = deflate_step(Z_FINISH, out);
+        } while (ret == Z_OK);
+        if (ret != Z_STREAM_END) {
+            THROW_MSG("Error during compression");
+        }
+
+        size_t pos = out.size();
+        out.resize(pos + AES_BLOCK_SIZE);
+        int len = 0;
+        if (EVP_EncryptFinal_ex(_ctx, out.data() + pos, &len) != 1) {
+            THROW_MSG("Failed to finalize encryption");
+        }
+        out.resize(pos + len);
+    }
+
+    [[nodiscard]] auto get_compressed_size() const -> U64 {
+        return _compressedSize;
+    }
+
+  private:
+    auto deflate_step(int flush, U8Vector& out) -> int {
+        _zs.next_out = _buffer.data();
+        _zs.avail_out = (uInt)_buffer.size();
+        int ret = deflate(&_zs, flush);
+        if (ret == Z_STREAM_ERROR) {
+            THROW_MSG("Error during compression");
+        }
+
+        size_t count = _buffer.size() - _zs.avail_out;
+        _compressedSize += count;
+        if (count > 0) {
+            size_t pos = out.size();
+            out.resize(pos + count + AES_BLOCK_SIZE);
+            int len = 0;
+            if (EVP_EncryptUpdate(_ctx, out.data() + pos, &len,
+                                  _buffer.data(), (int)count) != 1) {
+                THROW_MSG("Failed to encrypt data");
+            }
+            out.resize(pos + len);
+        }
+        return ret;
+    }
+
+    const U8Vector& _key;
+    const U8Vector& _iv;
+    z_stream _zs{};
+    EVP_CIPHER_CTX* _ctx{nullptr};
+    U8Vector _buffer;
+    U64 _compressedSize{0};
+};
+
+// AES-256-CTR cipher of the chunked packs (see apply_pack_cipher()), keeping
+// the key schedule between calls:
+class PackCipher {
+    NV_DECLARE_NO_COPY(PackCipher)
+    NV_DECLARE_NO_MOVE(PackCipher)
+
+  public:
+    PackCipher(const U8Vector& key, std::span<const U8> nonce) {
+        NVCHK(key.size() == 32 && nonce.size() == AES_BLOCK_SIZE,
+              "Invalid key size.");
+        memcpy(_nonce, nonce.data(), AES_BLOCK_SIZE);
+        _ctx = EVP_CIPHER_CTX_new();
+        if (_ctx == nullptr ||
+            EVP_EncryptInit_ex(_ctx, EVP_aes_256_ctr(), nullptr, key.data(),
+                               _nonce) != 1) {
+            EVP_CIPHER_CTX_free(_ctx);
+            THROW_MSG("Failed to initialize encryption");
+        }
+    }
+
+    ~PackCipher() { EVP_CIPHER_CTX_free(_ctx); }
+
+    void apply(U64 position, const U8* input, U8* output, size_t size) {
+        // Counter of the first block, the nonce being a big endian integer:
+        U8 counter[AES_BLOCK_SIZE];
+        memcpy(counter, _nonce, AES_BLOCK_SIZE);
+        U64 carry = position / AES_BLOCK_SIZE;
+        for (int i = AES_BLOCK_SIZE - 1; i >= 0 && carry != 0; --i) {
+            U64 sum = counter[i] + (carry & 0xFF);
+            counter[i] = (U8)sum;
+            carry = (carry >> 8) + (sum >> 8);
+        }
+
+        U8 skipped[AES_BLOCK_SIZE] = {};
+        int len = 0;
+        auto skip = (int)(position % AES_BLOCK_SIZE);
+        if (EVP_EncryptInit_ex(_ctx, nullptr, nullptr, nullptr, counter) !=
+                1 ||
+            EVP_EncryptUpdate(_ctx, skipped, &len, skipped, skip) != 1) {
+            THROW_MSG("Failed to initialize encryption");
+        }
+
+        for (U64 pos = 0; pos < size; pos += kMaxStepSize) {
+            if (EVP_EncryptUpdate(_ctx, output + pos, &len, input + pos,
+                                  (int)minimum(size - pos, kMaxStepSize)) !=
+                1) {
+                THROW_MSG("Failed to encrypt data");
+            }
+        }
+    }
+
+  private:
+    U8 _nonce[AES_BLOCK_SIZE];
+    EVP_CIPHER_CTX* _ctx{nullptr};
+};
+
+void apply_pack_cipher(const U8Vector& key, std::span<const U8> nonce,
+                       U64 position, const U8* input, U8* output,
+                       size_t size) {
+    PackCipher cipher(key, nonce);
+    cipher.apply(position, input, output, size);
 }
 
+// Deflates the blocks of the chunked entries, reusing the zlib state:
+class BlockEncoder {
+    NV_DECLARE_NO_COPY(BlockEncoder)
+    NV_DECLARE_NO_MOVE(BlockEncoder)
+
+  public:
+    explicit BlockEncoder(I32 level) {
+        if (deflateInit(&_zs, level) != Z_OK) {
+            THROW_MSG("zlib initialization failed");
+        }
+    }
+
+    ~BlockEncoder() { deflateEnd(&_zs); }
+
+    // Append a block to out (stored as is if deflating doesn't make it
+    // smaller), returns the size of the block in out:
+    auto append(std::span<const U8> data, U8Vector& out) -> U64 {
+        if (deflateReset(&_zs) != Z_OK) {
+            THROW_MSG("Error during compression");
+        }
+
+        size_t pos = out.size();
+        U64 bound = deflateBound(&_zs, (uLong)data.size());
+        out.resize(pos + bound);
+        _zs.next_in = (Bytef*)data.data();
+        _zs.avail_in = (uInt)data.size();
+        _zs.next_out = out.data() + pos;
+        _zs.avail_out = (uInt)bound;
+        int ret = deflate(&_zs, Z_FINISH);
+        if (ret != Z_STREAM_END) {
+            THROW_MSG("Error during compression");
+        }
+
+        U64 size = bound - _zs.avail_out;
+        if (size >= data.size()) {
+            size = data.size();
+            memcpy(out.data() + pos, data.data(), size);
+        }
+        out.resize(pos + size);
+        return size;
+    }
+
+  private:
+    z_stream _zs{};
+};
+
 auto ResourcePacker::encrypt_data(const U8Vector& input) -> U8Vector {
     EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
     if (!ctx) {
@@ -57,12 +321,17 @@ auto ResourcePacker::encrypt_data(const U8Vector& input) -> U8Vector {
     }
 
     U8Vector encrypted(input.size() + AES_BLOCK_SIZE);
-    int outlen1 = 0;
-
-    if (EVP_EncryptUpdate(ctx, encrypted.data(), &outlen1, input.data(),
-                          input.size()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        THROW_MSG("Failed to encrypt data");
+    U64 outlen1 = 0;
+
+    for (U64 pos = 0; pos < input.size(); pos += kMaxStepSize) {
+        int len = 0;
+        if (EVP_EncryptUpdate(
+                ctx, encrypted.data() + outlen1, &len, input.data() + pos,
+                (int)minimum(input.size() - pos, kMaxStepSize)) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            THROW_MSG("Failed to encrypt data");
+        }
+        outlen1 += len;
     }
 
     int outlen2 = 0;
@@ -78,41 +347,128 @@ auto ResourcePacker::encrypt_data(const U8Vector& input) -> U8Vector {
 }
 
 void ResourcePacker::add_file(const String& filePath, const String& entryName) {
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file) {
+    if (!system_file_exists(filePath.c_str())) {
         std::cerr << "Failed to open file: " << filePath << std::endl;
         return;
     }
 
-    // Read file content
-    U8Vector content((std::istreambuf_iterator<char>(file)),
-                     std::istreambuf_iterator<char>());
-    file.close();
-
-    // Prepare file entry
+    // The sizes, checksum and offset are set during pack()
     FileEntry entry;
-    // entry.name = std::filesystem::path(filePath).filename().string();
     entry.name = entryName;
     entry.sourceFile = filePath;
-    entry.originalSize = content.size();
+    fileEntries.push_back(entry);
+}
+
+// Compress and encrypt a pack entry (reading it in buffer), passing the
+// output to sink by chunks (stops if sink returns false):
+static void encode_entry(FileEntry& entry, EntryEncoder& encoder,
+                         U8Vector& buffer,
+                         const std::function<bool(U8Vector&&)>& sink,
+                         std::atomic<U64>& inputBytes) {
+    std::ifstream file(entry.sourceFile, std::ios::binary);
+    NVCHK(file.is_open(), "Invalid source file for pack entry: {}",
+          entry.sourceFile);
+
+    encoder.reset();
+    U8Vector out;
+    U32 checksum = 0;
+    U64 originalSize = 0;
+    U64 encryptedSize = 0;
+
+    while (file) {
+        file.read(reinterpret_cast<char*>(buffer.data()),
+                  (std::streamsize)buffer.size());
+        auto count = (size_t)file.gcount();
+        if (count == 0) {
+            break;
+        }
+
+        std::span<const U8> chunk(buffer.data(), count);
+        checksum = update_checksum(checksum, chunk);
+        originalSize += count;
+        inputBytes += count;
+        encoder.update(chunk, out);
+
+        if (out.size() >= kReadChunkSize) {
+            encryptedSize += out.size();
+            if (!sink(std::move(out))) {
+                return;
+            }
+            out = {};
+        }
+    }
+    NVCHK(!file.bad(), "Failed to read source file: {}", entry.sourceFile);
 
-    // Compress the data
-    U8Vector compressed = compress_data(content);
-    entry.compressedSize = compressed.size();
+    encoder.finish(out);
+    encryptedSize += out.size();
 
-    // Encrypt the compressed data
-    U8Vector encrypted = encrypt_data(compressed);
-    entry.encryptedSize = encrypted.size();
-    // logDEBUG("Packer: file {}: compressedSize={}, encryptedSize={}",
-    // filePath,
-    //          entry.compressedSize, entry.encryptedSize);
+    entry.originalSize = originalSize;
+    entry.compressedSize = encoder.get_compressed_size();
+    entry.encryptedSize = encryptedSize;
+    entry.checksum = checksum;
+    sink(std::move(out));
+}
 
-    // Calculate checksum (on the original data)
-    entry.checksum = compute_data_checksum(content);
+// Same as encode_entry() for a chunked entry, left unencrypted (the blocks
+// are encrypted by the writer, which knows their position in the pack):
+static void encode_entry_blocks(FileEntry& entry, BlockEncoder& encoder,
+                                U8Vector& buffer, U64 blockSize,
+                                const std::function<bool(U8Vector&&)>& sink,
+                                std::atomic<U64>& inputBytes) {
+    std::ifstream file(entry.sourceFile, std::ios::binary);
+    NVCHK(file.is_open(), "Invalid source file for pack entry: {}",
+          entry.sourceFile);
+
+    U8Vector out;
+    Vector<U64> blockEnds;
+    U32 checksum = 0;
+    U64 originalSize = 0;
+    U64 compressedSize = 0;
+    U64 entrySize = 0;
+
+    while (file) {
+        file.read(reinterpret_cast<char*>(buffer.data()),
+                  (std::streamsize)blockSize);
+        auto count = (size_t)file.gcount();
+        if (count == 0) {
+            break;
+        }
 
-    // Store file info
-    entry.offset = 0; // Will be set during pack()
-    fileEntries.push_back(entry);
+        std::span<const U8> block(buffer.data(), count);
+        checksum = update_checksum(checksum, block);
+        originalSize += count;
+        inputBytes += count;
+        U64 size = encoder.append(block, out);
+        compressedSize += size;
+        blockEnds.push_back(compressedSize);
+
+        if (out.size() >= kReadChunkSize) {
+            entrySize += out.size();
+            if (!sink(std::move(out))) {
+                return;
+            }
+            out = {};
+        }
+    }
+    NVCHK(!file.bad(), "Failed to read source file: {}", entry.sourceFile);
+
+    // Block table:
+    size_t pos = out.size();
+    out.resize(pos + blockEnds.size() * sizeof(U64));
+    memcpy(out.data() + pos, blockEnds.data(), blockEnds.size() * sizeof(U64));
+    entrySize += out.size();
+
+    entry.originalSize = originalSize;
+    entry.compressedSize = compressedSize;
+    entry.encryptedSize = entrySize;
+    entry.checksum = checksum;
+    sink(std::move(out));
+}
+
+void ResourcePacker::set_block_size(U32 size) {
+    NVCHK(size == 0 || (size >= kMinBlockSize && size <= kMaxBlockSize),
+          "Invalid pack block size: {}", size);
+    blockSize = size;
 }
 
 void ResourcePacker::pack() {
@@ -123,90 +479,340 @@ void ResourcePacker::pack() {
         return;
     }
 
-    // Write header: magic number (v2 format with metadata support)
-    const char* magic = "NVPKX";
-    out.write(magic, 5);
-
-    // Write package version
-    out.write(reinterpret_cast<const char*>(&packageVersion),
-              sizeof(packageVersion));
+    auto startTime = std::chrono::steady_clock::now();
+    auto get_elapsed = [startTime] {
+        return std::chrono::duration<F64>(std::chrono::steady_clock::now() -
+                                          startTime)
+            .count();
+    };
+
+    // Header (written again once the offsets are known), then the encrypted
+    // metadata:
+    PackHeaderV3 header{};
+    memcpy(header.magic, "NVPK3", 5);
+    header.packageVersion = packageVersion;
+    header.blockSize = blockSize;
+    if (RAND_bytes(header.nonce, sizeof(header.nonce)) != 1) {
+        THROW_MSG("Failed to generate the pack nonce");
+    }
 
-    // Encrypt and write metadata
     U8Vector metadataBytes(metadata.begin(), metadata.end());
     U8Vector encryptedMetadata = encrypt_data(metadataBytes);
+    header.metadataOffset = sizeof(header);
+    header.metadataSize = encryptedMetadata.size();
 
-    U32 metadataLength = encryptedMetadata.size();
-    out.write(reinterpret_cast<const char*>(&metadataLength),
-              sizeof(metadataLength));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
     out.write(reinterpret_cast<const char*>(encryptedMetadata.data()),
-              metadataLength);
+              (std::streamsize)encryptedMetadata.size());
 
-    // Write file count
-    U32 fileCount = fileEntries.size();
-    out.write(reinterpret_cast<const char*>(&fileCount), sizeof(fileCount));
-
-    // Calculate offset for the first file data block
-    U32 currentOffset = 5 + // magic
-                        sizeof(packageVersion) + sizeof(metadataLength) +
-                        metadataLength + sizeof(fileCount);
+    PackProgress progress;
+    progress.numFiles = fileEntries.size();
+    for (const auto& entry : fileEntries) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(entry.sourceFile, ec);
+        progress.totalInputBytes += ec ? 0 : size;
+    }
 
-    // Compute the total offset for the file table:
-    for (auto& entry : fileEntries) {
-        U32 nameLength = entry.name.length();
-        currentOffset += sizeof(nameLength) + nameLength +
-                         sizeof(entry.offset) + sizeof(entry.originalSize) +
-                         sizeof(entry.compressedSize) +
-                         sizeof(entry.encryptedSize) + sizeof(entry.checksum);
+    // Output of the entries not written yet:
+    struct EncodedEntry {
+        Deque<U8Vector> chunks;
+        bool done{false};
+    };
+    Vector<EncodedEntry> encoded(fileEntries.size());
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t nextEntry = 0;
+    size_t headEntry = 0;
+    U64 bufferedBytes = 0;
+    String error;
+    std::atomic<U64> inputBytes{0};
+
+    U32 threadCount = numThreads;
+    if (threadCount == 0) {
+        threadCount = maximum(std::thread::hardware_concurrency(), 1U);
     }
+    threadCount = (U32)minimum<size_t>(threadCount,
+                                       maximum<size_t>(encoded.size(), 1));
+    size_t maxAhead = 4 * (size_t)threadCount;
+
+    auto worker = [&]() {
+        std::unique_ptr<EntryEncoder> encoder;
+        std::unique_ptr<BlockEncoder> blockEncoder;
+        U8Vector buffer(maximum<U64>(kReadChunkSize, blockSize));
+        while (true) {
+            size_t idx = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] {
+                    return !error.empty() || nextEntry >= encoded.size() ||
+                           nextEntry < headEntry + maxAhead;
+                });
+                if (!error.empty() || nextEntry >= encoded.size()) {
+                    return;
+                }
+                idx = nextEntry++;
+            }
+
+            // The entry being written is streamed to the pack, the next ones
+            // wait if too much data is buffered:
+            auto sink = [&, idx](U8Vector&& chunk) {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] {
+                    return !error.empty() || idx == headEntry ||
+                           bufferedBytes < kMaxBufferedBytes;
+                });
+                if (!error.empty()) {
+                    return false;
+                }
+                bufferedBytes += chunk.size();
+                encoded[idx].chunks.push_back(std::move(chunk));
+                cond.notify_all();
+                return true;
+            };
+
+            try {
+                if (blockSize != 0) {
+                    if (blockEncoder == nullptr) {
+                        blockEncoder =
+                            std::make_unique<BlockEncoder>(compressionLevel);
+                    }
+                    encode_entry_blocks(fileEntries[idx], *blockEncoder,
+                                        buffer, blockSize, sink, inputBytes);
+                } else {
+                    if (encoder == nullptr) {
+                        encoder = std::make_unique<EntryEncoder>(
+                            AES_KEY, AES_IV, compressionLevel);
+                    }
+                    encode_entry(fileEntries[idx], *encoder, buffer, sink,
+                                 inputBytes);
+                }
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error.empty()) {
+                    error = e.what();
+                }
+                cond.notify_all();
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                encoded[idx].done = true;
+            }
+            cond.notify_all();
+        }
+    };
 
-    // Write file table entries (name, offset, sizes, checksum)
-    // Update offsets and write headers
-    for (auto& entry : fileEntries) {
-        U32 nameLength = entry.name.length();
-        out.write(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
-        out.write(entry.name.c_str(), nameLength);
+    Vector<std::thread> threads;
+    for (U32 i = 0; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
 
+    auto report = [&]() {
+        if (progressCallback) {
+            progress.inputBytes = inputBytes;
+            progress.elapsed = get_elapsed();
+            progressCallback(progress);
+        }
+    };
+
+    // Write the entries in order, as their data arrives:
+    PackCipher cipher(AES_KEY, header.nonce);
+    U64 currentOffset = header.metadataOffset + header.metadataSize;
+    F64 lastReport = 0.0;
+    for (size_t i = 0; i < encoded.size(); ++i) {
+        auto& entry = fileEntries[i];
         entry.offset = currentOffset;
-        out.write(reinterpret_cast<char*>(&entry.offset), sizeof(entry.offset));
-        out.write(reinterpret_cast<char*>(&entry.originalSize),
-                  sizeof(entry.originalSize));
-        out.write(reinterpret_cast<char*>(&entry.compressedSize),
-                  sizeof(entry.compressedSize));
-        out.write(reinterpret_cast<char*>(&entry.encryptedSize),
-                  sizeof(entry.encryptedSize));
-        out.write(reinterpret_cast<char*>(&entry.checksum),
-                  sizeof(entry.checksum));
 
-        currentOffset += entry.encryptedSize;
-    }
+        while (true) {
+            U8Vector chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] {
+                    return !error.empty() || !encoded[i].chunks.empty() ||
+                           encoded[i].done;
+                });
+                if (!error.empty() || encoded[i].chunks.empty()) {
+                    break;
+                }
+                chunk = std::move(encoded[i].chunks.front());
+                encoded[i].chunks.pop_front();
+                bufferedBytes -= chunk.size();
+            }
+            cond.notify_all();
+
+            if (blockSize != 0) {
+                cipher.apply(currentOffset, chunk.data(), chunk.data(),
+                             chunk.size());
+            }
+            out.write(reinterpret_cast<const char*>(chunk.data()),
+                      (std::streamsize)chunk.size());
+            currentOffset += chunk.size();
+            progress.outputBytes += chunk.size();
+
+            if (get_elapsed() - lastReport > 0.5) {
+                report();
+                lastReport = get_elapsed();
+            }
+        }
 
-    // Write file data
-    U32 tsize = 0;
-    for (const auto& entry : fileEntries) {
-        // Read original file
-        NVCHK(system_file_exists(entry.sourceFile.c_str()),
-              "Invalid source file for pack entry: {}",
-              entry.sourceFile.c_str());
-        std::ifstream file(entry.sourceFile, std::ios::binary);
-        U8Vector content((std::istreambuf_iterator<char>(file)),
-                         std::istreambuf_iterator<char>());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (error.empty() &&
+                currentOffset - entry.offset != entry.encryptedSize) {
+                error = fmt::format("Invalid data size for pack entry {}",
+                                    entry.name);
+            }
+            if (!error.empty()) {
+                break;
+            }
+            headEntry = i + 1;
+        }
+        cond.notify_all();
 
-        // Compress and encrypt
-        U8Vector compressed = compress_data(content);
-        U8Vector encrypted = encrypt_data(compressed);
+        ++progress.numDone;
+        report();
+    }
 
-        // Write to pack file
-        out.write(reinterpret_cast<const char*>(encrypted.data()),
-                  encrypted.size());
-        tsize += encrypted.size();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error.empty() && out.fail()) {
+            error = "write error";
+        }
+    }
+    cond.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (!error.empty()) {
+        out.close();
+        std::filesystem::remove(outputPath);
+        THROW_MSG("Failed to create resource pack {}: {}", outputPath, error);
     }
 
+    // Write the names and the hashed index:
+    Vector<PackIndexSlot> slots;
+    String names;
+    header.fileCount = build_pack_index(fileEntries, slots, names);
+    header.slotCount = slots.size();
+    header.namesOffset = currentOffset;
+    header.namesSize = names.size();
+    header.indexOffset = (header.namesOffset + header.namesSize + 7) & ~7ULL;
+
+    out.write(names.data(), (std::streamsize)names.size());
+    const char padding[8] = {};
+    out.write(padding, (std::streamsize)(header.indexOffset -
+                                         header.namesOffset -
+                                         header.namesSize));
+    out.write(reinterpret_cast<const char*>(slots.data()),
+              (std::streamsize)(slots.size() * sizeof(PackIndexSlot)));
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
     out.close();
-
-    logDEBUG("Created resource pack: {} with {} files (dataSize={})",
-             outputPath, fileEntries.size(), tsize);
+    NVCHK(!out.fail(), "Failed to write resource pack: {}", outputPath);
+
+    F64 elapsed = get_elapsed();
+    F64 inputMB = (F64)inputBytes / (1024.0 * 1024.0);
+    logINFO_CAT(resource,
+                "Created resource pack {} with {} files: {:.1f} MB -> {:.1f} "
+                "MB in {:.2f}s ({:.1f} MB/s, {} threads)",
+                outputPath, fileEntries.size(), inputMB,
+                (F64)progress.outputBytes / (1024.0 * 1024.0), elapsed,
+                inputMB / maximum(elapsed, 1e-6), threadCount);
 }
 
+// Streaming AES-256-CBC decryption followed by zlib decompression of a
+// single stream entry:
+class EntryDecoder {
+    NV_DECLARE_NO_COPY(EntryDecoder)
+    NV_DECLARE_NO_MOVE(EntryDecoder)
+
+  public:
+    EntryDecoder(const U8Vector& key, const U8Vector& iv,
+                 std::span<const U8> data)
+        : _data(data), _buffer(kDecodeChunkSize + 2 * AES_BLOCK_SIZE) {
+        NVCHK(key.size() == 32 && iv.size() == 16, "Invalid key size.");
+        if (inflateInit(&_zs) != Z_OK) {
+            THROW_MSG("zlib initialization failed");
+        }
+        _ctx = EVP_CIPHER_CTX_new();
+        if (_ctx == nullptr ||
+            EVP_DecryptInit_ex(_ctx, EVP_aes_256_cbc(), nullptr, key.data(),
+                               iv.data()) != 1) {
+            inflateEnd(&_zs);
+            EVP_CIPHER_CTX_free(_ctx);
+            THROW_MSG("Failed to initialize decryption");
+        }
+    }
+
+    ~EntryDecoder() {
+        inflateEnd(&_zs);
+        EVP_CIPHER_CTX_free(_ctx);
+    }
+
+    // Decode up to dest.size() bytes, returns the number of bytes decoded
+    // (less only at the end of the stream):
+    auto read(std::span<U8> dest) -> size_t {
+        if (dest.empty()) {
+            return 0;
+        }
+        _zs.next_out = dest.data();
+        _zs.avail_out = (uInt)minimum<size_t>(dest.size(), kMaxStepSize);
+        size_t size = _zs.avail_out;
+
+        while (_zs.avail_out > 0 && !_ended) {
+            if (_zs.avail_in == 0 && !decrypt_next()) {
+                THROW_MSG("Truncated pack entry data");
+            }
+            int ret = inflate(&_zs, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                _ended = true;
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                THROW_MSG("Error during decompression");
+            }
+        }
+        return size - _zs.avail_out;
+    }
+
+  private:
+    static constexpr size_t kDecodeChunkSize = 64 * 1024;
+
+    // Decrypt the next piece of the input, returns false at the end:
+    auto decrypt_next() -> bool {
+        if (_finished) {
+            return false;
+        }
+        int len = 0;
+        size_t count = minimum(_data.size() - _inputPos, kDecodeChunkSize);
+        if (EVP_DecryptUpdate(_ctx, _buffer.data(), &len,
+                              _data.data() + _inputPos, (int)count) != 1) {
+            THROW_MSG("Failed to decrypt data");
+        }
+        _inputPos += count;
+
+        int finalLen = 0;
+        if (_inputPos == _data.size()) {
+            if (EVP_DecryptFinal_ex(_ctx, _buffer.data() + len, &finalLen) !=
+                1) {
+                THROW_MSG("Failed to finalize decryption");
+            }
+            _finished = true;
+        }
+        _zs.next_in = _buffer.data();
+        _zs.avail_in = (uInt)(len + finalLen);
+        return true;
+    }
+
+    std::span<const U8> _data;
+    size_t _inputPos{0};
+    bool _finished{false};
+    bool _ended{false};
+    z_stream _zs{};
+    EVP_CIPHER_CTX* _ctx{nullptr};
+    U8Vector _buffer;
+};
+
 void ResourceUnpacker::decompress_data(const U8Vector& input, U8* destData,
                                        size_t originalSize) {
     z_stream zs;
@@ -216,13 +822,25 @@ void ResourceUnpacker::decompress_data(const U8Vector& input, U8* destData,
         THROW_MSG("zlib initialization failed");
     }
 
+    // zlib rejects a null output pointer, even for an empty output:
+    U8 empty = 0;
     zs.next_in = (Bytef*)input.data();
-    zs.avail_in = static_cast<uInt>(input.size());
+    zs.next_out = (Bytef*)(destData != nullptr ? destData : &empty);
+    U64 inLeft = input.size();
+    U64 outLeft = originalSize;
 
-    zs.next_out = (Bytef*)destData;
-    zs.avail_out = originalSize;
-
-    int ret = inflate(&zs, Z_FINISH);
+    int ret = Z_OK;
+    do {
+        if (zs.avail_in == 0 && inLeft > 0) {
+            zs.avail_in = (uInt)minimum(inLeft, kMaxStepSize);
+            inLeft -= zs.avail_in;
+        }
+        if (zs.avail_out == 0 && outLeft > 0) {
+            zs.avail_out = (uInt)minimum(outLeft, kMaxStepSize);
+            outLeft -= zs.avail_out;
+        }
+        ret = inflate(&zs, Z_NO_FLUSH);
+    } while (ret == Z_OK);
     inflateEnd(&zs);
 
     if (ret != Z_STREAM_END) {
@@ -230,7 +848,7 @@ void ResourceUnpacker::decompress_data(const U8Vector& input, U8* destData,
     }
 }
 
-auto ResourceUnpacker::decrypt_data(const U8Vector& input) -> U8Vector {
+auto ResourceUnpacker::decrypt_data(std::span<const U8> input) -> U8Vector {
     EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
     if (!ctx) {
         THROW_MSG("Failed to create OpenSSL cipher context");
@@ -244,13 +862,18 @@ auto ResourceUnpacker::decrypt_data(const U8Vector& input) -> U8Vector {
         THROW_MSG("Failed to initialize decryption");
     }
 
-    U8Vector decrypted(input.size());
-    int outlen1 = 0;
+    U8Vector decrypted(input.size() + AES_BLOCK_SIZE);
+    U64 outlen1 = 0;
 
-    if (EVP_DecryptUpdate(ctx, decrypted.data(), &outlen1, input.data(),
-                          input.size()) != 1) {
-        EVP_CIPHER_CTX_free(ctx);
-        THROW_MSG("Failed to decrypt data");
+    for (U64 pos = 0; pos < input.size(); pos += kMaxStepSize) {
+        int len = 0;
+        if (EVP_DecryptUpdate(
+                ctx, decrypted.data() + outlen1, &len, input.data() + pos,
+                (int)minimum(input.size() - pos, kMaxStepSize)) != 1) {
+            EVP_CIPHER_CTX_free(ctx);
+            THROW_MSG("Failed to decrypt data");
+        }
+        outlen1 += len;
     }
 
     int outlen2 = 0;
@@ -269,103 +892,373 @@ ResourceUnpacker::ResourceUnpacker(const String& packFilePath,
                                    const U8Vector& key, const U8Vector& iv)
     : _filename(packFilePath), AES_KEY(key), AES_IV(iv) {}
 
-auto ResourceUnpacker::get_file_table()
-    -> const UnorderedMap<String, FileEntry>& {
-    if (!_initialized) {
-        _packFile.open(_filename, std::ios::binary);
-        NVCHK(_packFile.is_open(), "Failed to open pack file {}", _filename);
+void ResourceUnpacker::load_index() {
+    // The index of the NVPK3 packs is used in place from the mapped pack,
+    // and all the entries are read from it:
+    _packMap = nv::create<MappedFile>(
+        _filename.c_str(), MappedFile::Traits{MAPPED_ACCESS_RANDOM});
+    load_pack_index(_packMap->span());
+}
+
+void ResourceUnpacker::load_pack_index(std::span<const U8> pack) {
+    size_t readPosition = 0;
+    auto read_bytes = [&](void* dest, size_t size) {
+        NVCHK(size <= pack.size() - readPosition, "Truncated pack file {}",
+              _filename);
+        memcpy(dest, pack.data() + readPosition, size);
+        readPosition += size;
+    };
+
+    // Read and verify header
+    char magic[5];
+    read_bytes(magic, 5);
+    String magicStr(magic, 5);
+
+    if (magicStr == "NVPK3") {
+        load_index_v3(pack);
+        return;
+    }
+
+    NVCHK(magicStr == "NVPCK" || magicStr == "NVPKX",
+          "Invalid pack file format: {}", magicStr);
+
+    bool isV2Format = (magicStr == "NVPKX");
+
+    if (isV2Format) {
+        // Read package version
+        read_bytes(&packageVersion, sizeof(packageVersion));
+
+        // Read encrypted metadata
+        U32 encryptedMetadataLength = 0;
+        read_bytes(&encryptedMetadataLength, sizeof(encryptedMetadataLength));
+
+        U8Vector encryptedMetadata(encryptedMetadataLength);
+        read_bytes(encryptedMetadata.data(), encryptedMetadataLength);
+
+        // Decrypt metadata
+        U8Vector decryptedMetadata = decrypt_data(encryptedMetadata);
+        metadata = String(decryptedMetadata.begin(), decryptedMetadata.end());
+
+        logDEBUG_CAT(resource, "Pack version: {}, metadata length: {}",
+                     packageVersion, metadata.length());
+    } else {
+        // Version 1 format - no version/metadata
+        packageVersion = 0;
+        metadata = "";
+        logDEBUG_CAT(resource, "Loading legacy v1 format pack");
+    }
+
+    // Read file count
+    U32 fileCount = 0;
+    read_bytes(&fileCount, sizeof(fileCount));
+
+    logDEBUG_CAT(resource, "Reading file table with {} entries.", fileCount);
+
+    // Read file table (same for both versions, with 32 bits fields)
+    Vector<FileEntry> entries(fileCount);
+    for (auto& entry : entries) {
+        U32 nameLength = 0;
+        read_bytes(&nameLength, sizeof(nameLength));
+        entry.name.resize(nameLength);
+        read_bytes(entry.name.data(), nameLength);
+
+        U32 fields[5];
+        read_bytes(fields, sizeof(fields));
+        entry.offset = fields[0];
+        entry.originalSize = fields[1];
+        entry.compressedSize = fields[2];
+        entry.encryptedSize = fields[3];
+        entry.checksum = fields[4];
+    }
+
+    set_legacy_index(entries);
+}
+
+void ResourceUnpacker::load_index_v3(std::span<const U8> pack) {
+    PackHeaderV3 header{};
+    NVCHK(pack.size() >= sizeof(header), "Truncated pack file {}", _filename);
+    memcpy(&header, pack.data(), sizeof(header));
+
+    auto inPack = [&pack](U64 offset, U64 size) {
+        return offset <= pack.size() && size <= pack.size() - offset;
+    };
+    NVCHK(memcmp(header.magic, "NVPK3", 5) == 0 &&
+              inPack(header.metadataOffset, header.metadataSize) &&
+              inPack(header.namesOffset, header.namesSize) &&
+              header.slotCount > header.fileCount &&
+              (header.slotCount & (header.slotCount - 1)) == 0 &&
+              header.slotCount <= pack.size() / sizeof(PackIndexSlot) &&
+              header.indexOffset % 8 == 0 &&
+              inPack(header.indexOffset,
+                     header.slotCount * sizeof(PackIndexSlot)) &&
+              header.blockSize <= ResourcePacker::kMaxBlockSize,
+          "Invalid pack file {}", _filename);
+
+    packageVersion = header.packageVersion;
+    _blockSize = header.blockSize;
+    memcpy(_nonce.data(), header.nonce, _nonce.size());
+    U8Vector decryptedMetadata = decrypt_data(
+        pack.subspan(header.metadataOffset, header.metadataSize));
+    metadata = String(decryptedMetadata.begin(), decryptedMetadata.end());
+
+    _index.slots = reinterpret_cast<const PackIndexSlot*>(pack.data() +
+                                                          header.indexOffset);
+    _index.slotCount = header.slotCount;
+    _index.names = reinterpret_cast<const char*>(pack.data()) +
+                   header.namesOffset;
+    _index.namesSize = header.namesSize;
+    _index.fileCount = header.fileCount;
+
+    logDEBUG_CAT(resource, "Pack version: {}, {} entries, metadata length: {}",
+                 packageVersion, header.fileCount, metadata.length());
+}
+
+void ResourceUnpacker::set_legacy_index(const Vector<FileEntry>& entries) {
+    _index.fileCount = build_pack_index(entries, _legacySlots, _legacyNames);
+    _index.slots = _legacySlots.data();
+    _index.slotCount = _legacySlots.size();
+    _index.names = _legacyNames.data();
+    _index.namesSize = _legacyNames.size();
+}
 
-        // Read and verify header
-        char magic[5];
-        _packFile.read(magic, 5);
-        String magicStr(magic, 5);
+auto ResourceUnpacker::get_index() -> const PackIndex& {
+    // Retried on the next call if load_index() throws:
+    std::call_once(_indexOnce, [this] { load_index(); });
+    return _index;
+}
 
-        NVCHK(magicStr == "NVPCK" || magicStr == "NVPKX",
-              "Invalid pack file format: {}", magicStr);
+auto ResourceUnpacker::find_entry(std::string_view fileName)
+    -> const PackIndexSlot* {
+    return get_index().find(fileName);
+}
 
-        bool isV2Format = (magicStr == "NVPKX");
+auto ResourceUnpacker::get_entry(const String& fileName)
+    -> const PackIndexSlot& {
+    const auto* slot = find_entry(fileName);
+    NVCHK(slot != nullptr, "File not found in pack: {}", fileName);
+    return *slot;
+}
 
-        if (isV2Format) {
-            // Read package version
-            _packFile.read(reinterpret_cast<char*>(&packageVersion),
-                           sizeof(packageVersion));
+auto ResourceUnpacker::get_pack_data() -> std::span<const U8> {
+    get_index();
+    return _packMap != nullptr ? _packMap->span() : std::span<const U8>{};
+}
 
-            // Read encrypted metadata
-            U32 encryptedMetadataLength;
-            _packFile.read(reinterpret_cast<char*>(&encryptedMetadataLength),
-                           sizeof(encryptedMetadataLength));
+auto ResourceUnpacker::get_entry_data(const PackIndexSlot& slot)
+    -> std::span<const U8> {
+    auto pack = get_pack_data();
+    NVCHK(slot.offset <= pack.size() &&
+              slot.encryptedSize <= pack.size() - slot.offset,
+          "Invalid entry data in pack {}", _filename);
+    return pack.subspan(slot.offset, slot.encryptedSize);
+}
 
-            U8Vector encryptedMetadata(encryptedMetadataLength);
-            _packFile.read(reinterpret_cast<char*>(encryptedMetadata.data()),
-                           encryptedMetadataLength);
+auto ResourceUnpacker::get_block_size() -> U64 {
+    get_index();
+    return _blockSize;
+}
 
-            // Decrypt metadata
-            U8Vector decryptedMetadata = decrypt_data(encryptedMetadata);
-            metadata =
-                String(decryptedMetadata.begin(), decryptedMetadata.end());
+void ResourceUnpacker::read_blocks(const PackIndexSlot& slot,
+                                   std::span<const U8> data, U64 offset,
+                                   std::span<U8> dest) {
+    NVCHK(offset <= slot.originalSize &&
+              dest.size() <= slot.originalSize - offset,
+          "Invalid range in pack entry");
+    if (dest.empty()) {
+        return;
+    }
 
-            logDEBUG("Pack version: {}, metadata length: {}", packageVersion,
-                     metadata.length());
+    U64 numBlocks = (slot.originalSize + _blockSize - 1) / _blockSize;
+    U64 tableSize = numBlocks * sizeof(U64);
+    NVCHK(data.size() == slot.encryptedSize && tableSize <= data.size(),
+          "Invalid block table in pack {}", _filename);
+    U64 tableOffset = data.size() - tableSize;
+
+    PackCipher cipher(AES_KEY, _nonce);
+    auto get_block_end = [&](U64 idx) -> U64 {
+        U64 end = 0;
+        U64 pos = tableOffset + idx * sizeof(U64);
+        cipher.apply(slot.offset + pos, data.data() + pos, (U8*)&end,
+                     sizeof(end));
+        return end;
+    };
+
+    U8Vector packed;
+    U8Vector block;
+    U64 first = offset / _blockSize;
+    U64 last = (offset + dest.size() - 1) / _blockSize;
+    U64 start = first == 0 ? 0 : get_block_end(first - 1);
+    for (U64 idx = first; idx <= last; ++idx) {
+        U64 end = get_block_end(idx);
+        NVCHK(start <= end && end <= tableOffset,
+              "Invalid block table in pack {}", _filename);
+
+        // Part of the block in the range:
+        U64 blockOffset = idx * _blockSize;
+        U64 blockSize = minimum(_blockSize, slot.originalSize - blockOffset);
+        U64 from = maximum(offset, blockOffset) - blockOffset;
+        U64 to = minimum(offset + dest.size(), blockOffset + blockSize) -
+                 blockOffset;
+        U8* target = dest.data() + (blockOffset + from - offset);
+
+        packed.resize(end - start);
+        cipher.apply(slot.offset + start, data.data() + start, packed.data(),
+                     packed.size());
+
+        if (packed.size() == blockSize) {
+            // Stored block:
+            memcpy(target, packed.data() + from, to - from);
         } else {
-            // Version 1 format - no version/metadata
-            packageVersion = 0;
-            metadata = "";
-            logDEBUG("Loading legacy v1 format pack");
+            // Inflate the whole block in place if it is in the range:
+            bool whole = from == 0 && to == blockSize;
+            if (!whole) {
+                block.resize(blockSize);
+            }
+            uLongf size = blockSize;
+            int ret = uncompress(whole ? target : block.data(), &size,
+                                 packed.data(), (uLong)packed.size());
+            NVCHK(ret == Z_OK && size == blockSize,
+                  "Error during decompression of pack {}", _filename);
+            if (!whole) {
+                memcpy(target, block.data() + from, to - from);
+            }
         }
+        start = end;
+    }
+}
 
-        // Read file count
-        U32 fileCount;
-        _packFile.read(reinterpret_cast<char*>(&fileCount), sizeof(fileCount));
+auto ResourceUnpacker::read_range(const String& fileName, U64 offset,
+                                  std::span<U8> dest) -> size_t {
+    const auto& slot = get_entry(fileName);
+    if (offset >= slot.originalSize) {
+        return 0;
+    }
+    size_t size = minimum<U64>(dest.size(), slot.originalSize - offset);
+
+    if (get_block_size() != 0) {
+        read_blocks(slot, get_entry_data(slot), offset, dest.first(size));
+        return size;
+    }
 
-        logDEBUG("Reading file table with {} entries.", fileCount);
+    PackEntryStream stream(this, slot, get_entry_data(slot));
+    stream.seek(offset);
+    size_t count = 0;
+    while (count < size) {
+        size_t num = stream.read(dest.subspan(count, size - count));
+        NVCHK(num > 0, "Truncated pack entry: {}", fileName);
+        count += num;
+    }
+    return count;
+}
 
-        // Read file table (same for both versions)
-        for (U32 i = 0; i < fileCount; i++) {
-            U32 nameLength;
-            _packFile.read(reinterpret_cast<char*>(&nameLength),
-                           sizeof(nameLength));
+auto ResourceUnpacker::read_range(const String& fileName, U64 offset,
+                                  U64 size) -> U8Vector {
+    U64 fileSize = get_entry(fileName).originalSize;
+    U8Vector data(offset < fileSize ? minimum(size, fileSize - offset) : 0);
+    read_range(fileName, offset, data);
+    return data;
+}
 
-            Vector<char> nameBuffer(nameLength);
-            _packFile.read(nameBuffer.data(), nameLength);
-            String name(nameBuffer.data(), nameLength);
+auto ResourceUnpacker::open_stream(const String& fileName)
+    -> std::unique_ptr<PackEntryStream> {
+    const auto& slot = get_entry(fileName);
+    return std::make_unique<PackEntryStream>(this, slot,
+                                             get_entry_data(slot));
+}
 
-            FileEntry entry;
-            entry.name = name;
+PackEntryStream::PackEntryStream(ResourceUnpacker* unpacker,
+                                 const PackIndexSlot& slot,
+                                 std::span<const U8> data)
+    : _unpacker(unpacker), _slot(slot), _data(data) {}
 
-            _packFile.read(reinterpret_cast<char*>(&entry.offset),
-                           sizeof(entry.offset));
-            _packFile.read(reinterpret_cast<char*>(&entry.originalSize),
-                           sizeof(entry.originalSize));
-            _packFile.read(reinterpret_cast<char*>(&entry.compressedSize),
-                           sizeof(entry.compressedSize));
-            _packFile.read(reinterpret_cast<char*>(&entry.encryptedSize),
-                           sizeof(entry.encryptedSize));
-            _packFile.read(reinterpret_cast<char*>(&entry.checksum),
-                           sizeof(entry.checksum));
+PackEntryStream::~PackEntryStream() = default;
 
-            _fileTable[name] = entry;
-        }
+void PackEntryStream::seek(U64 position) {
+    position = minimum(position, _slot.originalSize);
+    if (position != _position) {
+        _sequential = false;
+        _position = position;
+    }
+}
 
-        _initialized = true;
+auto PackEntryStream::read(std::span<U8> buffer) -> size_t {
+    buffer = buffer.first(
+        minimum<U64>(buffer.size(), _slot.originalSize - _position));
+    if (buffer.empty()) {
+        return 0;
     }
 
-    return _fileTable;
+    size_t count = _unpacker->get_block_size() != 0 ? read_block(buffer)
+                                                    : read_stream(buffer);
+    if (_sequential) {
+        _checksum = update_checksum(_checksum, buffer.first(count));
+        NVCHK(_position + count < _slot.originalSize ||
+                  _checksum == _slot.checksum,
+              "Checksum verification failed for pack entry {}",
+              _unpacker->get_index().get_name(_slot));
+    }
+    _position += count;
+    return count;
+}
+
+auto PackEntryStream::read_block(std::span<U8> buffer) -> size_t {
+    U64 blockSize = _unpacker->get_block_size();
+    U64 idx = _position / blockSize;
+    U64 blockOffset = idx * blockSize;
+    if (idx != _blockIndex) {
+        _blockIndex = ~0ULL;
+        _block.resize(minimum(blockSize, _slot.originalSize - blockOffset));
+        _unpacker->read_blocks(_slot, _data, blockOffset, _block);
+        _blockIndex = idx;
+    }
+
+    U64 from = _position - blockOffset;
+    size_t count = minimum<U64>(buffer.size(), _block.size() - from);
+    memcpy(buffer.data(), _block.data() + from, count);
+    return count;
+}
+
+auto PackEntryStream::read_stream(std::span<U8> buffer) -> size_t {
+    if (_decoder == nullptr || _decoderPosition > _position) {
+        _decoder = std::make_unique<EntryDecoder>(
+            _unpacker->AES_KEY, _unpacker->AES_IV, _data);
+        _decoderPosition = 0;
+    }
+
+    // Skip the data before the position:
+    while (_decoderPosition < _position) {
+        size_t skip = minimum<U64>(_position - _decoderPosition,
+                                   buffer.size());
+        size_t num = _decoder->read(buffer.first(skip));
+        NVCHK(num > 0, "Truncated pack entry data");
+        _decoderPosition += num;
+    }
+
+    size_t count = _decoder->read(buffer);
+    NVCHK(count > 0, "Truncated pack entry data");
+    _decoderPosition += count;
+    return count;
 }
 
 auto ResourceUnpacker::get_file_info(const String& fileName) -> FileEntry {
-    const auto& ft = get_file_table();
-    auto it = ft.find(fileName);
-    NVCHK(it != ft.end(), "File not found in pack {}", fileName);
-    return it->second;
+    const auto& slot = get_entry(fileName);
+
+    FileEntry entry;
+    entry.name = fileName;
+    entry.offset = slot.offset;
+    entry.originalSize = slot.originalSize;
+    entry.compressedSize = slot.compressedSize;
+    entry.encryptedSize = slot.encryptedSize;
+    entry.checksum = slot.checksum;
+    return entry;
 }
 
 auto ResourceUnpacker::get_file_size(const String& fileName) -> size_t {
-    return get_file_info(fileName).originalSize;
+    return get_entry(fileName).originalSize;
 }
 
 auto ResourceUnpacker::contains_file(const String& fileName) -> bool {
-    const auto& ft = get_file_table();
-    return ft.find(fileName) != ft.end();
+    return find_entry(fileName) != nullptr;
 }
 
 void ResourceUnpacker::extract_file_to_disk(const String& fileName,
@@ -380,10 +1273,13 @@ void ResourceUnpacker::extract_file_to_disk(const String& fileName,
 }
 
 auto ResourceUnpacker::list_files() -> Vector<String> {
+    const auto& index = get_index();
     Vector<String> files;
-    const auto& ft = get_file_table();
-    for (const auto& entry : ft) {
-        files.push_back(entry.first);
+    files.reserve(index.fileCount);
+    for (U64 i = 0; i < index.slotCount; ++i) {
+        if (index.slots[i].hash != 0) {
+            files.emplace_back(index.get_name(index.slots[i]));
+        }
     }
     return files;
 }
@@ -402,22 +1298,13 @@ auto ResourceUnpacker::get_metadata() const -> const String& {
     return metadata;
 }
 auto ResourceUnpacker::extract_compressed_data(const String& fileName,
-                                               U32& fileSize, U32& checksum)
+                                               U64& fileSize, U32& checksum)
     -> U8Vector {
-    const auto& ft = get_file_table();
-    auto it = ft.find(fileName);
-    NVCHK(it != ft.end(), "File not found in pack: {}", fileName);
-
-    const FileEntry& entry = it->second;
-
-    // Seek to file data
-    _packFile.seekg(entry.offset);
-
-    // Read encrypted data
-    U8Vector encryptedData(entry.encryptedSize);
-    _packFile.read(reinterpret_cast<char*>(encryptedData.data()),
-                   entry.encryptedSize);
+    const auto& entry = get_entry(fileName);
+    NVCHK(_blockSize == 0, "No single compressed stream in chunked pack {}",
+          _filename);
 
+    auto encryptedData = get_entry_data(entry);
     fileSize = entry.originalSize;
     checksum = entry.checksum;
 
@@ -425,124 +1312,65 @@ auto ResourceUnpacker::extract_compressed_data(const String& fileName,
     return decrypt_data(encryptedData);
 };
 
-ResourceUnpacker::~ResourceUnpacker() {
-    if (_packFile.is_open()) {
-        _packFile.close();
-    }
-};
-void ResourceUnpackerMemory::read_from_memory(char* dest, size_t size) {
-    NVCHK(_readPosition + size <= _packData.size(),
-          "Attempted to read beyond buffer bounds");
-    std::memcpy(dest, _packData.data() + _readPosition, size);
-    _readPosition += size;
-}
-void ResourceUnpackerMemory::seek_to(size_t position) {
-    NVCHK(position <= _packData.size(),
-          "Attempted to seek beyond buffer bounds");
-    _readPosition = position;
-}
-auto ResourceUnpackerMemory::extract_compressed_data(const String& fileName,
-                                                     U32& fileSize,
-                                                     U32& checksum)
-    -> U8Vector {
-    const auto& ft = get_file_table();
-    auto it = ft.find(fileName);
-    NVCHK(it != ft.end(), "File not found in pack: {}", fileName);
-
-    const FileEntry& entry = it->second;
-
-    // Seek to file data
-    seek_to(entry.offset);
-
-    // Read encrypted data from memory
-    U8Vector encryptedData(entry.encryptedSize);
-    read_from_memory(reinterpret_cast<char*>(encryptedData.data()),
-                     entry.encryptedSize);
-
-    fileSize = entry.originalSize;
-    checksum = entry.checksum;
-
-    // Decrypt data
-    return decrypt_data(encryptedData);
-}
-auto ResourceUnpackerMemory::get_file_table()
-    -> const UnorderedMap<String, FileEntry>& {
-    if (!_initialized) {
-        // Read and verify header
-        char magic[5];
-        read_from_memory(magic, 5);
-        String magicStr(magic, 5);
-
-        NVCHK(magicStr == "NVPCK" || magicStr == "NVPKX",
-              "Invalid pack file format: {}", magicStr);
-
-        bool isV2Format = (magicStr == "NVPKX");
-
-        if (isV2Format) {
-            // Read package version
-            read_value(packageVersion);
-
-            // Read encrypted metadata
-            U32 encryptedMetadataLength;
-            read_value(encryptedMetadataLength);
-
-            U8Vector encryptedMetadata(encryptedMetadataLength);
-            read_from_memory(reinterpret_cast<char*>(encryptedMetadata.data()),
-                             encryptedMetadataLength);
-
-            // Decrypt metadata
-            U8Vector decryptedMetadata = decrypt_data(encryptedMetadata);
-            metadata =
-                String(decryptedMetadata.begin(), decryptedMetadata.end());
-
-            logDEBUG("Pack version: {}, metadata length: {}", packageVersion,
-                     metadata.length());
-        } else {
-            // Version 1 format - no version/metadata
-            packageVersion = 0;
-            metadata = "";
-            logDEBUG("Loading legacy v1 format pack from memory");
-        }
-
-        // Read file count
-        U32 fileCount = 0;
-        read_value(fileCount);
-
-        logDEBUG("Reading file table with {} entries from memory.", fileCount);
-
-        // Read file table
-        for (U32 i = 0; i < fileCount; i++) {
-            U32 nameLength = 0;
-            read_value(nameLength);
+ResourceUnpacker::~ResourceUnpacker() = default;
 
-            Vector<char> nameBuffer(nameLength);
-            read_from_memory(nameBuffer.data(), nameLength);
-            String name(nameBuffer.data(), nameLength);
+void ResourceUnpackerMemory::load_index() { load_pack_index(_packData); }
 
-            FileEntry entry;
-            entry.name = name;
-
-            read_value(entry.offset);
-            read_value(entry.originalSize);
-            read_value(entry.compressedSize);
-            read_value(entry.encryptedSize);
-            read_value(entry.checksum);
-
-            _fileTable[name] = entry;
-        }
-        _initialized = true;
-    }
-
-    return _fileTable;
-}
 ResourceUnpackerMemory::ResourceUnpackerMemory(U8Vector&& data,
                                                const String& virtualFilename,
                                                const U8Vector& key,
                                                const U8Vector& iv)
     : ResourceUnpacker(virtualFilename, key, iv), _packData(std::move(data)) {}
 
+auto ResourceUnpackerMemory::get_pack_data() -> std::span<const U8> {
+    return _packData;
+}
+
 auto ResourceUnpacker::read_file_async(const String& fileName)
     -> Promise<String> {
+    // Report a missing file through the promise, as the other read errors:
+    FileEntry entry;
+    PackIndexSlot slot{};
+    try {
+        entry = get_file_info(fileName);
+        slot = get_entry(fileName);
+    } catch (...) {
+        return make_rejected_promise<std::exception_ptr, String>(
+            std::current_exception());
+    }
+
+    // Only the encrypted data is read asynchronously, the decryption and
+    // decompression are done in the continuation:
+    return AsyncFileIO::instance()
+        .read_range(_filename, entry.offset, entry.encryptedSize)
+        .then([this, entry, slot](const U8Vector& encryptedData) -> String {
+            NVCHK(encryptedData.size() == entry.encryptedSize,
+                  "Truncated data for file {} in pack {}", entry.name,
+                  _filename);
+            if (_blockSize != 0) {
+                String originalData(entry.originalSize, '\0');
+                read_blocks(slot, encryptedData, 0,
+                            {(U8*)originalData.data(), originalData.size()});
+                NVCHK(compute_data_checksum(originalData) == entry.checksum,
+                      "Checksum verification failed for file: {}",
+                      entry.name);
+                return originalData;
+            }
+
+            U8Vector compressedData = decrypt_data(encryptedData);
+
+            String originalData(entry.originalSize, '\0');
+            decompress_data(compressedData, (U8*)originalData.data(),
+                            entry.originalSize);
+            NVCHK(compute_data_checksum(originalData) == entry.checksum,
+                  "Checksum verification failed for file: {}", entry.name);
+            return originalData;
+        });
+};
+
+auto ResourceUnpackerMemory::read_file_async(const String& fileName)
+    -> Promise<String> {
+    // Already in memory, nothing to wait for:
     return make_promise<String>(
         [this, fileName](Defer d) { d.resolve(read_file(fileName)); });
 };
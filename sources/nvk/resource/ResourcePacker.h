@@ -4,21 +4,124 @@
 
 #include <nvk/resource/ResourceProvider.h>
 #include <nvk_common.h>
+
+#include <span>
+
 namespace nv {
 
+class MappedFile;
+
 // Structure for file entry in the pack
 struct FileEntry {
     String name;
     String sourceFile;
-    U32 offset;
-    U32 originalSize;
-    U32 compressedSize;
-    U32 encryptedSize;
+    U64 offset{0};
+    U64 originalSize{0};
+    U64 compressedSize{0};
+    U64 encryptedSize{0};
+    U32 checksum{0};
+};
+
+// NVPK3 pack layout (little endian):
+//   PackHeaderV3 | encrypted metadata | entry data | names | index
+// The index is an open addressing hash table of PackIndexSlot (linear
+// probing, at most half full) pointing into the names block, so it is used
+// in place from the mapped pack: opening a pack doesn't depend on its
+// number of entries and lookups don't allocate.
+//
+// If blockSize is 0, each entry is a single zlib stream encrypted with
+// AES-256-CBC. Otherwise the entries are chunked:
+//   block 0 | block 1 | ... | block table
+// Each block holds blockSize bytes of the entry (less for the last one),
+// deflated independently (or stored as is if that is not smaller), and the
+// table has the U64 end offset of each block in the entry data. All the
+// entry data is encrypted with AES-256-CTR, the counter being derived from
+// the random nonce of the pack and the position in the pack (see
+// apply_pack_cipher()), so any block can be read and decoded on its own.
+struct PackHeaderV3 {
+    char magic[8]; // "NVPK3"
+    I64 packageVersion;
+    U64 metadataOffset;
+    U64 metadataSize;
+    U64 namesOffset;
+    U64 namesSize;
+    U64 indexOffset; // 8 bytes aligned
+    U64 slotCount;   // power of two
+    U64 fileCount;
+    U64 blockSize; // 0 if the entries are not chunked
+    // Random for each pack, so that packs sharing a key (including the
+    // successive builds of a pack) never share a keystream:
+    U8 nonce[16];
+};
+
+struct PackIndexSlot {
+    // Hash of the name (never 0, which marks an empty slot):
+    U64 hash;
+    U64 nameOffset;
+    U32 nameLength;
     U32 checksum;
+    U64 offset;
+    U64 originalSize;
+    U64 compressedSize;
+    U64 encryptedSize;
+};
+
+static_assert(sizeof(PackHeaderV3) == 96);
+static_assert(sizeof(PackIndexSlot) == 56);
+
+// Hashed index of the entries of a pack:
+struct PackIndex {
+    const PackIndexSlot* slots{nullptr};
+    U64 slotCount{0};
+    const char* names{nullptr};
+    U64 namesSize{0};
+    U64 fileCount{0};
+
+    [[nodiscard]] auto find(std::string_view name) const
+        -> const PackIndexSlot*;
+    [[nodiscard]] auto get_name(const PackIndexSlot& slot) const
+        -> std::string_view;
+};
+
+// Build the hashed index of entries (the last entry wins for duplicated
+// names), returns the number of distinct entries:
+auto build_pack_index(const Vector<FileEntry>& entries,
+                      Vector<PackIndexSlot>& slots, String& names) -> U64;
+
+// Encrypt or decrypt (the same operation with AES-CTR) size bytes found at
+// position in a chunked pack: the counter of the 16 bytes block at position
+// p is the nonce of the pack plus p / 16.
+void apply_pack_cipher(const U8Vector& key, std::span<const U8> nonce,
+                       U64 position, const U8* input, U8* output,
+                       size_t size);
+
+// Progress of ResourcePacker::pack():
+struct PackProgress {
+    U64 numFiles{0};
+    U64 numDone{0};
+    // Source bytes read so far, and in total:
+    U64 inputBytes{0};
+    U64 totalInputBytes{0};
+    // Bytes written to the pack:
+    U64 outputBytes{0};
+    // Seconds since the start:
+    F64 elapsed{0.0};
 };
 
-// Simple implementation of a resource packer
+// Simple implementation of a resource packer.
+// Each entry is read, compressed and encrypted exactly once by a pool of
+// threads, streaming the source file by chunks. The entries are written in
+// the order they were added: an entry is streamed to its offset as soon as
+// all the previous ones are written, and the entries ahead of it are
+// buffered in memory (up to a limit).
 class ResourcePacker : public RefObject {
+  public:
+    using ProgressCallback = std::function<void(const PackProgress&)>;
+
+    static constexpr U32 kDefaultBlockSize = 256 * 1024;
+    static constexpr U32 kMinBlockSize = 4 * 1024;
+    static constexpr U32 kMaxBlockSize = 64 * 1024 * 1024;
+
   private:
     // Encryption key - should be embedded in your game engine
     U8Vector AES_KEY; // Should be 32 bytes
@@ -30,8 +133,11 @@ class ResourcePacker : public RefObject {
     I64 packageVersion{0};
     String metadata;
 
-    // Compress data using zlib
-    auto compress_data(const U8Vector& input) -> U8Vector;
+    U32 numThreads{0};
+    // Z_BEST_COMPRESSION:
+    I32 compressionLevel{9};
+    U32 blockSize{kDefaultBlockSize};
+    ProgressCallback progressCallback;
 
     // Encrypt data using AES-256
     auto encrypt_data(const U8Vector& input) -> U8Vector;
@@ -41,7 +147,7 @@ class ResourcePacker : public RefObject {
                             const U8Vector& iv)
         : AES_KEY(key), AES_IV(iv), outputPath(outPath) {}
 
-    // Add a file to the pack
+    // Add a file to the pack (only read by pack())
     void add_file(const String& filePath, const String& entryName);
 
     // Create the pack file
@@ -49,31 +155,134 @@ class ResourcePacker : public RefObject {
 
     void set_package_version(I64 version);
     void set_metadata(const String& meta);
+
+    // Number of threads used by pack() (0 for the number of cores):
+    void set_num_threads(U32 num) { numThreads = num; }
+
+    // zlib compression level (1 to 9), lower levels pack much faster:
+    void set_compression_level(I32 level) { compressionLevel = level; }
+
+    // Size of the blocks of the chunked entries (between kMinBlockSize and
+    // kMaxBlockSize), or 0 to store each entry as a single stream (which
+    // compresses slightly better but can only be read as a whole):
+    void set_block_size(U32 size);
+
+    // Called from the thread calling pack() as the entries are written:
+    void set_progress_callback(ProgressCallback callback) {
+        progressCallback = std::move(callback);
+    }
+};
+
+class ResourceUnpacker;
+class EntryDecoder;
+
+// Sequential reader of a pack entry, decoding it by pieces (one block of a
+// chunked entry, or a few KB of a single stream entry) so that the memory
+// used doesn't depend on the size of the entry. The whole entry checksum
+// is verified when it is read from the start to the end without seeking.
+// Must not outlive its unpacker.
+class PackEntryStream {
+    NV_DECLARE_NO_COPY(PackEntryStream)
+    NV_DECLARE_NO_MOVE(PackEntryStream)
+
+  public:
+    PackEntryStream(ResourceUnpacker* unpacker, const PackIndexSlot& slot,
+                    std::span<const U8> data);
+    ~PackEntryStream();
+
+    // Read up to buffer.size() bytes, returns the number of bytes read (0
+    // at the end of the entry):
+    auto read(std::span<U8> buffer) -> size_t;
+
+    // Move the read position (cheap for chunked entries, single stream
+    // entries are decoded again from the start to go backward):
+    void seek(U64 position);
+
+    [[nodiscard]] auto tell() const -> U64 { return _position; }
+    [[nodiscard]] auto size() const -> U64 { return _slot.originalSize; }
+
+  private:
+    auto read_block(std::span<U8> buffer) -> size_t;
+    auto read_stream(std::span<U8> buffer) -> size_t;
+
+    ResourceUnpacker* _unpacker;
+    PackIndexSlot _slot;
+    // Encrypted data of the entry:
+    std::span<const U8> _data;
+    U64 _position{0};
+
+    // Chunked entries: last decoded block.
+    U8Vector _block;
+    U64 _blockIndex{~0ULL};
+
+    // Single stream entries: decoder, and its position in the entry.
+    std::unique_ptr<EntryDecoder> _decoder;
+    U64 _decoderPosition{0};
+
+    // Checksum of the data read sequentially from the start:
+    U32 _checksum{0};
+    bool _sequential{true};
 };
 
-// Resource unpacker for the game engine
+// Resource unpacker for the game engine.
+// The pack is memory mapped and each read only uses its own buffers (no
+// shared file cursor), and the index is loaded once on first use, so the
+// files can be read from any number of threads concurrently.
 class ResourceUnpacker : public ResourceProvider {
   private:
     String _filename;
-    std::ifstream _packFile;
 
     U8Vector AES_KEY; // Should be 32 bytes
     U8Vector AES_IV;  // Should be 16 bytes
 
   protected:
+    friend class PackEntryStream;
+
     I64 packageVersion{0};
     String metadata;
-    UnorderedMap<String, FileEntry> _fileTable;
-    bool _initialized{false};
-
-    virtual auto get_file_table() -> const UnorderedMap<String, FileEntry>&;
+    std::once_flag _indexOnce;
+    // Block size and nonce of a chunked pack (0 if not chunked):
+    U64 _blockSize{0};
+    std::array<U8, 16> _nonce{};
+
+    // Index used in place from the mapped NVPK3 pack, or built from the
+    // file table of a legacy pack:
+    PackIndex _index;
+    RefPtr<MappedFile> _packMap;
+    Vector<PackIndexSlot> _legacySlots;
+    String _legacyNames;
+
+    virtual void load_index();
+
+    // Setup the index from a whole pack in memory:
+    void load_pack_index(std::span<const U8> pack);
+    // Setup the index from a whole NVPK3 pack in memory:
+    void load_index_v3(std::span<const U8> pack);
+    // Setup the index from the file table of a legacy pack:
+    void set_legacy_index(const Vector<FileEntry>& entries);
+
+    // Index of the pack, loaded on first use:
+    auto get_index() -> const PackIndex&;
+    // Find an entry without allocating (nullptr if not found):
+    auto find_entry(std::string_view fileName) -> const PackIndexSlot*;
+    auto get_entry(const String& fileName) -> const PackIndexSlot&;
+
+    // Whole content of the pack:
+    virtual auto get_pack_data() -> std::span<const U8>;
+    // Encrypted data of an entry:
+    auto get_entry_data(const PackIndexSlot& slot) -> std::span<const U8>;
+
+    // Decode the bytes at offset of a chunked entry into dest, from the
+    // encrypted entry data:
+    void read_blocks(const PackIndexSlot& slot, std::span<const U8> data,
+                     U64 offset, std::span<U8> dest);
 
     // Decompress data using zlib
     void decompress_data(const U8Vector& input, U8* destData,
                          size_t originalSize);
 
     // Decrypt data using AES-256
-    auto decrypt_data(const U8Vector& input) -> U8Vector;
+    auto decrypt_data(std::span<const U8> input) -> U8Vector;
 
   public:
     explicit ResourceUnpacker(const String& packFilePath, const U8Vector& key,
@@ -90,7 +299,8 @@ class ResourceUnpacker : public ResourceProvider {
     // List all files in the pack
     auto list_files() -> Vector<String> override;
 
-    virtual auto extract_compressed_data(const String& fileName, U32& fileSize,
+    // Decrypted (still compressed) data of a single stream entry:
+    virtual auto extract_compressed_data(const String& fileName, U64& fileSize,
                                          U32& checksum) -> U8Vector;
 
     // Extract a file and write it to disk
@@ -105,9 +315,36 @@ class ResourceUnpacker : public ResourceProvider {
     // Get file metadata
     auto get_file_info(const String& fileName) -> FileEntry;
 
+    // Block size of the entries (0 if they are single streams):
+    auto get_block_size() -> U64;
+
+    // Read up to dest.size() bytes at offset in a file, returns the number
+    // of bytes read. Only the blocks covering the range are decoded in a
+    // chunked pack, a single stream entry is decoded up to the end of the
+    // range (by pieces). Doesn't verify the file checksum.
+    auto read_range(const String& fileName, U64 offset, std::span<U8> dest)
+        -> size_t;
+    auto read_range(const String& fileName, U64 offset, U64 size)
+        -> U8Vector;
+
+    // Open a file for streaming reads:
+    auto open_stream(const String& fileName)
+        -> std::unique_ptr<PackEntryStream>;
+
     template <typename T = U8Vector>
     auto extract_file(const String& fileName) -> T {
-        U32 originalSize = 0;
+        // Chunked packs: decode the blocks directly in the output.
+        if (get_block_size() != 0) {
+            const auto& entry = get_entry(fileName);
+            T originalData(entry.originalSize, typename T::value_type{});
+            read_blocks(entry, get_entry_data(entry), 0,
+                        {(U8*)originalData.data(), originalData.size()});
+            NVCHK(compute_data_checksum(originalData) == entry.checksum,
+                  "Checksum verification failed for file: {}", fileName);
+            return originalData;
+        }
+
+        U64 originalSize = 0;
         U32 entryChecksum = 0;
         auto compressedData =
             extract_compressed_data(fileName, originalSize, entryChecksum);
@@ -142,28 +379,18 @@ class ResourceUnpacker : public ResourceProvider {
 class ResourceUnpackerMemory : public ResourceUnpacker {
   private:
     U8Vector _packData;
-    size_t _readPosition{0};
-
-    // Memory-based reading helpers
-    void read_from_memory(char* dest, size_t size);
-
-    template <typename T> void read_value(T& value) {
-        read_from_memory(reinterpret_cast<char*>(&value), sizeof(T));
-    }
-
-    void seek_to(size_t position);
 
   protected:
-    // Override extraction to use memory instead of file
-    auto extract_compressed_data(const String& fileName, U32& fileSize,
-                                 U32& checksum) -> U8Vector override;
+    void load_index() override;
 
-    auto get_file_table() -> const UnorderedMap<String, FileEntry>& override;
+    auto get_pack_data() -> std::span<const U8> override;
 
   public:
     // Constructor takes memory buffer and virtual filename
     ResourceUnpackerMemory(U8Vector&& data, const String& virtualFilename,
                            const U8Vector& key, const U8Vector& iv);
+
+    auto read_file_async(const String& fileName) -> Promise<String> override;
 };
 
 } // namespace nv
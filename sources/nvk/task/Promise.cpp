@@ -15,6 +15,12 @@ void Defer::resolve(const Any& value) const {
     }
 }
 
+void Defer::resolve(Any&& value) const {
+    if (_promise) {
+        _promise->resolve_internal(std::move(value));
+    }
+}
+
 void Defer::reject() const {
     if (_promise) {
         _promise->reject_internal();
@@ -47,6 +53,15 @@ void PromiseBase::resolve_internal(const Any& value) {
     }
 }
 
+void PromiseBase::resolve_internal(Any&& value) {
+    PromiseState expected = PromiseState::PENDING;
+    if (_state.compare_exchange_strong(expected, PromiseState::RESOLVED,
+                                       std::memory_order_acq_rel)) {
+        _value = std::move(value);
+        execute_continuations();
+    }
+}
+
 void PromiseBase::reject_internal() {
     PromiseState expected = PromiseState::PENDING;
     if (_state.compare_exchange_strong(expected, PromiseState::REJECTED,
@@ -118,6 +118,7 @@ class Defer {
 
     void resolve() const;
     void resolve(const Any& value) const;
+    void resolve(Any&& value) const;
     void reject() const;
     void reject(const Any& error) const;
 
@@ -165,6 +166,7 @@ class PromiseBase : public WeakRefObject {
 
     void resolve_internal();
     void resolve_internal(const Any& value);
+    void resolve_internal(Any&& value);
     void reject_internal();
     void reject_internal(const Any& error);
 
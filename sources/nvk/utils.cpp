@@ -1,4 +1,5 @@
 
+#include <nvk/base/MappedFile.h>
 #include <nvk/resource/ResourceManager.h>
 #include <nvk/utils.h>
 
@@ -262,6 +263,12 @@ auto read_virtual_file(const String& fname, bool forceAllowSystem) -> String {
                                                          forceAllowSystem);
 }
 
+auto map_virtual_file(const String& fname, bool forceAllowSystem)
+    -> RefPtr<MappedFile> {
+    return ResourceManager::instance().map_virtual_file(fname,
+                                                        forceAllowSystem);
+}
+
 auto read_virtual_file_async(const String& fname, bool forceAllowSystem)
     -> Promise<String> {
     return ResourceManager::instance().read_virtual_file_async(
@@ -282,6 +289,11 @@ void write_file(const char* fname, const String& content, bool createFolders) {
 
 void write_binary_file(const char* fname, const U8Vector& content,
                        bool createFolders) {
+    write_binary_file(fname, std::span<const U8>(content), createFolders);
+}
+
+void write_binary_file(const char* fname, std::span<const U8> content,
+                       bool createFolders) {
     if (createFolders) {
         auto folder = get_parent_folder(fname);
         NVCHK(create_folders(folder), "Could not create folder {}", folder);
@@ -289,7 +301,8 @@ void write_binary_file(const char* fname, const U8Vector& content,
     std::ofstream t(fname, std::ios::out | std::ios::binary);
     NVCHK(t.is_open(), "Cannot write file {}", fname);
 
-    t.write(reinterpret_cast<const char*>(content.data()), content.size());
+    t.write(reinterpret_cast<const char*>(content.data()),
+            (std::streamsize)content.size());
     t.close();
 }
 
@@ -352,6 +365,23 @@ auto read_system_binary_file(const char* fname) -> U8Vector {
     return res;
 }
 
+auto read_system_binary_file(const char* fname, std::span<U8> out,
+                             U64 offset) -> U64 {
+    std::ifstream t(fname, std::ios::in | std::ios::binary);
+    NVCHK(t.is_open(), "File {} doesn't exist.", fname);
+
+    t.seekg((std::streamoff)offset, std::ios::beg);
+    if (!t) {
+        return 0;
+    }
+    t.read(reinterpret_cast<char*>(out.data()), (std::streamsize)out.size());
+    return (U64)t.gcount();
+}
+
+auto map_system_file(const char* fname) -> RefPtr<MappedFile> {
+    return nv::create<MappedFile>(fname);
+}
+
 // Expand brace patterns like {yml,json} into multiple patterns
 static auto expand_braces(const String& pattern) -> Vector<String> {
     Vector<String> results;
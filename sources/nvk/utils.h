@@ -7,9 +7,12 @@
 #include <nvk/base/RefPtr.h>
 #include <nvk/base/std_containers.h>
 
+#include <span>
+
 namespace nv {
 
 template <typename T> class Promise;
+class MappedFile;
 
 // Returns current physical RAM usage in bytes, or 0 on failure.
 auto get_current_rss() -> U64;
@@ -100,9 +103,22 @@ auto get_absolute_path(const String& path) -> String;
 auto read_system_file(const char* fname) -> String;
 auto read_system_binary_file(const char* fname) -> U8Vector;
 
+/** Read up to out.size() bytes starting at offset into a caller provided
+ * buffer. Returns the number of bytes read. */
+auto read_system_binary_file(const char* fname, std::span<U8> out,
+                             U64 offset = 0) -> U64;
+
+/** Map a file read-only instead of reading it (see MappedFile). */
+auto map_system_file(const char* fname) -> RefPtr<MappedFile>;
+
 auto read_virtual_file(const String& fname, bool forceAllowSystem = false)
     -> String;
 
+/** Map a virtual file: system files are memory mapped, files from the
+ * resource packs are read into the returned buffer. */
+auto map_virtual_file(const String& fname, bool forceAllowSystem = false)
+    -> RefPtr<MappedFile>;
+
 auto read_virtual_file_async(const String& fname, bool forceAllowSystem = false)
     -> Promise<String>;
 
@@ -115,6 +131,9 @@ void write_file(const char* fname, const String& content,
 void write_binary_file(const char* fname, const U8Vector& content,
                        bool createFolders = true);
 
+void write_binary_file(const char* fname, std::span<const U8> content,
+                       bool createFolders = true);
+
 void remove_file(const char* fname);
 void remove_file(const String& fname);
 auto remove_file_if_exists(const String& fname) -> bool;
@@ -5,15 +5,38 @@
 
 #define NV_MAX_NUM_THREADS 16
 
-#ifdef __EMSCRIPTEN__
+// Note: NV_USE_LOG_THREAD can be overridden from the build configuration.
+#ifndef NV_USE_LOG_THREAD
 #define NV_USE_LOG_THREAD 1
+#endif
+
+#ifdef __EMSCRIPTEN__
 // This  doesn't seem to work correctly on emscripten (?)
 #define NV_CHECK_MEMORY_LEAKS 0
 #else
-#define NV_USE_LOG_THREAD 1
 #define NV_CHECK_MEMORY_LEAKS 1
 #endif
 
+// Numeric log levels, matching nv::LogManager::Level (usable in #if):
+#define NV_LOG_LEVEL_FATAL 0
+#define NV_LOG_LEVEL_ERROR 1
+#define NV_LOG_LEVEL_WARN 2
+#define NV_LOG_LEVEL_NOTE 3
+#define NV_LOG_LEVEL_INFO 4
+#define NV_LOG_LEVEL_DEBUG 5
+#define NV_LOG_LEVEL_TRACE 6
+
+// Most verbose log level compiled in: the log macros above that level are
+// removed by the preprocessor, together with the evaluation of their
+// arguments. By default TRACE messages are stripped from release builds.
+#ifndef NV_LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define NV_LOG_COMPILE_LEVEL NV_LOG_LEVEL_DEBUG
+#else
+#define NV_LOG_COMPILE_LEVEL NV_LOG_LEVEL_TRACE
+#endif
+#endif
+
 // Note: it seems that the emscripten compiler doesn't like my custom memory
 // manager layer very much.
 #define NV_USE_STD_MEMORY 1
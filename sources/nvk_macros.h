@@ -10,9 +10,14 @@ class LogManager;
 
 #ifndef NV_NO_LOG_MACROS
 #ifndef logTRACE
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_TRACE
 #define logTRACE nv::LogManager::trace
+#else
+#define logTRACE(...) ((void)0)
+#endif
 #endif
 
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_DEBUG
 #ifndef logDEBUG
 #define logDEBUG nv::LogManager::debug
 #endif
@@ -21,8 +26,25 @@ class LogManager;
 #define logDEBUGif nv::LogManager::debug_if
 #endif
 
+// Note: the logId is not needed anymore since each call site has its own
+// limiter (cf. logDEBUG_every()), LogManager::debug_1s() still uses it.
+#ifndef logDEBUG_1S
+#define logDEBUG_1S(logId, ...)                                                \
+    NV_LOG_EVERY(nv::LogManager::L_DEBUG, std::chrono::seconds(1), 1,          \
+                 __VA_ARGS__)
+#endif
+#else
+#ifndef logDEBUG
+#define logDEBUG(...) ((void)0)
+#endif
+
+#ifndef logDEBUGif
+#define logDEBUGif(...) ((void)0)
+#endif
+
 #ifndef logDEBUG_1S
-#define logDEBUG_1S nv::LogManager::debug_1s
+#define logDEBUG_1S(...) ((void)0)
+#endif
 #endif
 
 #ifndef logINFO
@@ -45,6 +67,134 @@ class LogManager;
 #define logFATAL nv::LogManager::fatal
 #endif
 
+// Category log macros, eg. logDEBUG_CAT(pcg, "Processing {} points", n): the
+// message is only formatted (and its arguments only evaluated) if the level
+// is enabled for that category (cf. nv::LogCat and
+// LogManager::set_category_level()).
+#define NV_LOG_CAT(lvl, cat, ...)                                              \
+    do {                                                                       \
+        auto& lman__ = nv::LogManager::instance();                             \
+        if (lman__.is_enabled(lvl, nv::LogCat::cat)) {                         \
+            lman__.log_cat(lvl, nv::LogCat::cat, __VA_ARGS__);                 \
+        }                                                                      \
+    } while (0)
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_TRACE
+#define logTRACE_CAT(cat, ...)                                                 \
+    NV_LOG_CAT(nv::LogManager::L_TRACE, cat, __VA_ARGS__)
+#else
+#define logTRACE_CAT(cat, ...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_DEBUG
+#define logDEBUG_CAT(cat, ...)                                                 \
+    NV_LOG_CAT(nv::LogManager::L_DEBUG, cat, __VA_ARGS__)
+#else
+#define logDEBUG_CAT(cat, ...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_INFO
+#define logINFO_CAT(cat, ...)                                                  \
+    NV_LOG_CAT(nv::LogManager::L_INFO, cat, __VA_ARGS__)
+#else
+#define logINFO_CAT(cat, ...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_NOTE
+#define logNOTE_CAT(cat, ...)                                                  \
+    NV_LOG_CAT(nv::LogManager::L_NOTE, cat, __VA_ARGS__)
+#else
+#define logNOTE_CAT(cat, ...) ((void)0)
+#endif
+
+#define logWARN_CAT(cat, ...)                                                  \
+    NV_LOG_CAT(nv::LogManager::L_WARN, cat, __VA_ARGS__)
+#define logERROR_CAT(cat, ...)                                                 \
+    NV_LOG_CAT(nv::LogManager::L_ERROR, cat, __VA_ARGS__)
+
+// Rate limited log macros, eg. logWARN_every(std::chrono::seconds(5), ...):
+// each call site has its own lock-free limiter emitting up to 'burst'
+// messages at once and then one per period. Emitted lines report how many
+// messages were suppressed in between (cf. nv::LogRateLimiter).
+#define NV_LOG_EVERY(lvl, period, burst, ...)                                  \
+    do {                                                                       \
+        static nv::LogRateLimiter limiter__(period, burst);                    \
+        nv::LogManager::instance().log_limited(limiter__, lvl, __VA_ARGS__);   \
+    } while (0)
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_TRACE
+#define logTRACE_every(period, ...)                                            \
+    NV_LOG_EVERY(nv::LogManager::L_TRACE, period, 1, __VA_ARGS__)
+#else
+#define logTRACE_every(period, ...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_DEBUG
+#define logDEBUG_every(period, ...)                                            \
+    NV_LOG_EVERY(nv::LogManager::L_DEBUG, period, 1, __VA_ARGS__)
+#else
+#define logDEBUG_every(period, ...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_INFO
+#define logINFO_every(period, ...)                                             \
+    NV_LOG_EVERY(nv::LogManager::L_INFO, period, 1, __VA_ARGS__)
+#else
+#define logINFO_every(period, ...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_NOTE
+#define logNOTE_every(period, ...)                                             \
+    NV_LOG_EVERY(nv::LogManager::L_NOTE, period, 1, __VA_ARGS__)
+#else
+#define logNOTE_every(period, ...) ((void)0)
+#endif
+
+#define logWARN_every(period, ...)                                             \
+    NV_LOG_EVERY(nv::LogManager::L_WARN, period, 1, __VA_ARGS__)
+#define logERROR_every(period, ...)                                            \
+    NV_LOG_EVERY(nv::LogManager::L_ERROR, period, 1, __VA_ARGS__)
+#define logFATAL_every(period, ...)                                            \
+    NV_LOG_EVERY(nv::LogManager::L_FATAL, period, 1, __VA_ARGS__)
+
+// Structured log macros, eg. logINFO_KV("tile loaded", "tile", id, "ms", t):
+// the fields keep their types for the structured sinks (cf. JsonLinesLogger)
+// and are rendered as " key=value" for the text sinks.
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_TRACE
+#define logTRACE_KV(...)                                                       \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_TRACE, __VA_ARGS__)
+#else
+#define logTRACE_KV(...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_DEBUG
+#define logDEBUG_KV(...)                                                       \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_DEBUG, __VA_ARGS__)
+#else
+#define logDEBUG_KV(...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_INFO
+#define logINFO_KV(...)                                                        \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_INFO, __VA_ARGS__)
+#else
+#define logINFO_KV(...) ((void)0)
+#endif
+
+#if NV_LOG_COMPILE_LEVEL >= NV_LOG_LEVEL_NOTE
+#define logNOTE_KV(...)                                                        \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_NOTE, __VA_ARGS__)
+#else
+#define logNOTE_KV(...) ((void)0)
+#endif
+
+#define logWARN_KV(...)                                                        \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_WARN, __VA_ARGS__)
+#define logERROR_KV(...)                                                       \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_ERROR, __VA_ARGS__)
+#define logFATAL_KV(...)                                                       \
+    nv::LogManager::instance().log_kv(nv::LogManager::L_FATAL, __VA_ARGS__)
+
 #ifndef CHECK_NO_THROW
 #define CHECK_NO_THROW nv::check_no_throw
 #endif